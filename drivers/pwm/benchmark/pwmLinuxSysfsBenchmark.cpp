@@ -0,0 +1,195 @@
+/// @brief  Syscall benchmark of the Linux sysfs backend of the PWM driver,
+///         executed on the host against a fake sysfs PWM chip. Counts the
+///         syscalls, and measures the time, of a duty change and of an
+///         on/off cycle, for the backend and for a baseline which opens,
+///         writes and closes each attribute on each call. Results are
+///         printed as JSON, and the test fails (failing the build) if the
+///         backend exceeds its configured syscall thresholds.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#include "pwmLinuxSysfs.h"
+#include "sysfs/cmsFakeSysfsPwmChip.hpp"
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// the cpputest headers must always be last
+#include "CppUTest/TestHarness.h"
+
+// Regression thresholds, in syscalls per operation. Configured by the
+// build, see PWM_SYSFS_BENCH_MAX_SYSCALLS_* in CMakeLists.txt.
+#ifndef PWM_SYSFS_BENCH_MAX_SYSCALLS_PER_DUTY
+#define PWM_SYSFS_BENCH_MAX_SYSCALLS_PER_DUTY 1
+#endif
+#ifndef PWM_SYSFS_BENCH_MAX_SYSCALLS_PER_ON_OFF
+#define PWM_SYSFS_BENCH_MAX_SYSCALLS_PER_ON_OFF 3
+#endif
+
+using cms::test::FakeSysfsPwmChip;
+using Clock = std::chrono::steady_clock;
+
+static constexpr int ITERATIONS = 2000;
+static constexpr uint32_t PERIOD_NS = 1000000U;
+static constexpr uint8_t CHANNEL = 0;
+
+namespace {
+
+struct Result
+{
+    std::string name;
+    double syscallsPerOp;
+    double nsPerOp;
+    double thresholdSyscalls; //0 when not checked
+};
+
+// The baseline: each attribute is opened, written with stdio
+// formatting, and closed, on each call.
+class ReopeningPwm
+{
+public:
+    explicit ReopeningPwm(const std::string& chip) : mChannel(chip + "/pwm0/") {}
+
+    void on(uint16_t duty)
+    {
+        write("period", PERIOD_NS);
+        write("duty_cycle", static_cast<uint32_t>((uint64_t(duty) * PERIOD_NS) / PWM_DUTY_FULL_SCALE));
+        write("enable", 1);
+    }
+
+    void off() { write("enable", 0); }
+
+    uint32_t syscalls() const { return mSyscalls; }
+
+private:
+    std::string mChannel;
+    uint32_t mSyscalls = 0;
+
+    void write(const char* attribute, uint32_t value)
+    {
+        char text[16];
+        const int length = snprintf(text, sizeof(text), "%u\n", static_cast<unsigned>(value));
+        const int fd = open((mChannel + attribute).c_str(), O_WRONLY);
+        ++mSyscalls;
+        if (fd >= 0) {
+            (void)!::write(fd, text, static_cast<size_t>(length));
+            (void)close(fd);
+            mSyscalls += 2;
+        }
+    }
+};
+
+uint32_t BackendSyscalls()
+{
+    PwmSysfsSyscallStats stats;
+    PwmSysfsGetSyscallStats(&stats);
+    return stats.opens + stats.closes + stats.reads + stats.writes;
+}
+
+uint16_t DutyOf(int iteration)
+{
+    //a different duty cycle each iteration, never the cached one
+    return static_cast<uint16_t>(0x1000 + (iteration % 2) * 0x1000);
+}
+
+double NsPerOp(Clock::duration elapsed)
+{
+    return std::chrono::duration<double, std::nano>(elapsed).count() / ITERATIONS;
+}
+
+} // namespace
+
+TEST_GROUP(PwmLinuxSysfsBenchmark)
+{
+    FakeSysfsPwmChip mChip {1, 1};
+    std::vector<Result> mResults;
+
+    void setup() final
+    {
+        CHECK_TRUE(mChip.isValid());
+        CHECK_TRUE(PwmSysfsConfigure(mChip.path().c_str(), PERIOD_NS));
+        CHECK_TRUE(PwmInit());
+    }
+
+    void teardown() final
+    {
+        PwmSysfsClose();
+    }
+
+    template <typename Operation>
+    void measureBackend(const char* name, double thresholdSyscalls, Operation operation)
+    {
+        PwmSysfsResetSyscallStats();
+        const auto start = Clock::now();
+        for (int i = 0; i < ITERATIONS; ++i) {
+            operation(i);
+        }
+        const auto elapsed = Clock::now() - start;
+        mResults.push_back({name, double(BackendSyscalls()) / ITERATIONS, NsPerOp(elapsed), thresholdSyscalls});
+    }
+
+    template <typename Operation>
+    void measureBaseline(const char* name, Operation operation)
+    {
+        ReopeningPwm baseline(mChip.path());
+        const auto start = Clock::now();
+        for (int i = 0; i < ITERATIONS; ++i) {
+            operation(baseline, i);
+        }
+        const auto elapsed = Clock::now() - start;
+        mResults.push_back({name, double(baseline.syscalls()) / ITERATIONS, NsPerOp(elapsed), 0});
+    }
+
+    void reportAndCheck() const
+    {
+        printf("\n{\"benchmark\": \"PwmLinuxSysfs\", \"iterations\": %d, \"results\": [\n", ITERATIONS);
+        for (size_t i = 0; i < mResults.size(); ++i) {
+            const Result& result = mResults[i];
+            const bool checked = result.thresholdSyscalls > 0;
+            printf("  {\"name\": \"%s\", \"syscalls_per_op\": %.2f, \"ns_per_op\": %.1f, "
+                   "\"threshold_syscalls\": %.0f, \"pass\": %s}%s\n",
+                   result.name.c_str(), result.syscallsPerOp, result.nsPerOp, result.thresholdSyscalls,
+                   (!checked || (result.syscallsPerOp <= result.thresholdSyscalls)) ? "true" : "false",
+                   (i + 1 < mResults.size()) ? "," : "");
+        }
+        printf("]}\n");
+
+        for (const Result& result : mResults) {
+            if (result.thresholdSyscalls > 0) {
+                CHECK_TRUE(result.syscallsPerOp <= result.thresholdSyscalls);
+            }
+        }
+    }
+};
+
+TEST(PwmLinuxSysfsBenchmark, syscalls_per_duty_change_and_on_off_cycle)
+{
+    CHECK_TRUE(PwmOnDuty(CHANNEL, DutyOf(1)));
+    measureBackend("cached_duty_change", PWM_SYSFS_BENCH_MAX_SYSCALLS_PER_DUTY,
+                   [](int i) { (void)PwmOnDuty(CHANNEL, DutyOf(i)); });
+    measureBackend("cached_on_off", PWM_SYSFS_BENCH_MAX_SYSCALLS_PER_ON_OFF, [](int i) {
+        (void)PwmOnDuty(CHANNEL, DutyOf(i));
+        (void)PwmOff(CHANNEL);
+    });
+
+    measureBaseline("reopen_duty_change", [](ReopeningPwm& pwm, int i) { pwm.on(DutyOf(i)); });
+    measureBaseline("reopen_on_off", [](ReopeningPwm& pwm, int i) {
+        pwm.on(DutyOf(i));
+        pwm.off();
+    });
+
+    reportAndCheck();
+}
@@ -24,7 +24,9 @@ SOFTWARE.
 
 /**
  * @brief public header for the PWM driver.
- *        The driver API is fully synchronous.
+ *        The driver API is synchronous, except for the *Async()
+ *        variants, which start an operation and report its
+ *        completion through a callback.
  */
 #ifndef PWM_H
 #define PWM_H
@@ -36,6 +38,81 @@ SOFTWARE.
 extern "C" {
 #endif
 
+/**
+ * @brief The number of PWM outputs (channels) supported by the driver.
+ *        May be overridden by the build.
+ */
+#ifndef PWM_MAX_CHANNELS
+#define PWM_MAX_CHANNELS 64
+#endif
+
+/**
+ * @brief Full scale (100%) value of an integer duty cycle.
+ */
+#define PWM_DUTY_FULL_SCALE 0xFFFFU
+
+/**
+ * @brief Convert a percentage to an integer duty cycle, as PwmOn() does.
+ *        The percentage is clamped to [0.0 .. 1.0] (NaN to 0.0), and
+ *        rounded to the nearest duty cycle.
+ * @arg percent: percentage
+ * @return [0 .. PWM_DUTY_FULL_SCALE]
+ */
+static inline uint16_t PwmPercentToDuty(float percent)
+{
+    if (!(percent > 0.0f)) {
+        return 0U;
+    }
+    if (percent >= 1.0f) {
+        return PWM_DUTY_FULL_SCALE;
+    }
+    return (uint16_t)(percent * (float)PWM_DUTY_FULL_SCALE + 0.5f);
+}
+
+/**
+ * @brief Counters of the driver's shadow register write cache.
+ *        The driver keeps a shadow copy of the last programmed
+ *        duty cycle and enable state of every channel, and skips
+ *        hardware writes which would not change anything.
+ */
+typedef struct {
+    uint32_t hits;   // writes skipped, the hardware already held the value
+    uint32_t misses; // writes issued to the hardware
+} PwmWriteCacheStats;
+
+/**
+ * @brief The number of steps of a factory self test run with
+ *        PwmFactoryTestStep().
+ */
+#define PWM_FACTORY_TEST_STEPS 4U
+
+/**
+ * @brief State of a factory self test run in steps. Owned by the
+ *        caller, managed by PwmFactoryTestBegin() and PwmFactoryTestStep().
+ */
+typedef struct {
+    uint8_t step;       // next step to execute
+    uint16_t device_id; // valid once the test is complete
+} PwmFactoryTestRun;
+
+/**
+ * @brief Completion callback of an asynchronous PWM operation.
+ *        May be called from any context (including interrupts), and
+ *        from within the *Async() call itself when the operation
+ *        completes immediately.
+ * @arg context: as given when the operation was started.
+ * @arg ok: true - completed successfully, false - some error.
+ */
+typedef void (*PwmCompletionCallback)(void* context, bool ok);
+
+/**
+ * @brief Completion callback of an asynchronous factory test.
+ *        Called in the same contexts as PwmCompletionCallback.
+ * @arg context: as given when the factory test was started.
+ * @arg device_id: as returned by PwmFactoryTest().
+ */
+typedef void (*PwmFactoryTestCallback)(void* context, uint16_t device_id);
+
 /**
  * @brief initializes the driver.
  * @return true - initialization completed successfully.
@@ -44,27 +121,118 @@ extern "C" {
 bool PwmInit();
 
 /**
- * @brief  Turn off the PWM.
+ * @brief  Turn off a PWM channel.
+ * @arg channel: [0 .. PWM_MAX_CHANNELS-1]
  * @return true -  completed successfully
  *         false - some error.
  */
-bool PwmOff();
+bool PwmOff(uint8_t channel);
 
 /**
- * @brief  Turn on the PWM.
+ * @brief  Turn on a PWM channel.
+ * @arg channel: [0 .. PWM_MAX_CHANNELS-1]
  * @arg percent: [0.0 .. 1.0], percentage
  * @return true - completed successfully
  *         false - some error.
  */
-bool PwmOn(float percent);
+bool PwmOn(uint8_t channel, float percent);
+
+/**
+ * @brief  Turn on a PWM channel. Integer duty cycle variant of PwmOn(),
+ *         free of floating point math for parts without an FPU.
+ * @arg channel: [0 .. PWM_MAX_CHANNELS-1]
+ * @arg duty: [0 .. PWM_DUTY_FULL_SCALE]
+ * @return true - completed successfully
+ *         false - some error.
+ */
+bool PwmOnDuty(uint8_t channel, uint16_t duty);
+
+/**
+ * @brief  Start turning off a PWM channel, without blocking.
+ * @arg channel: [0 .. PWM_MAX_CHANNELS-1]
+ * @arg done: called exactly once when the operation completes.
+ * @arg context: passed to done.
+ * @return true - the operation was started.
+ *         false - some error, done will not be called.
+ */
+bool PwmOffAsync(uint8_t channel, PwmCompletionCallback done, void* context);
+
+/**
+ * @brief  Start turning on a PWM channel, without blocking.
+ *         Asynchronous variant of PwmOnDuty().
+ * @arg channel: [0 .. PWM_MAX_CHANNELS-1]
+ * @arg duty: [0 .. PWM_DUTY_FULL_SCALE]
+ * @arg done: called exactly once when the operation completes.
+ * @arg context: passed to done.
+ * @return true - the operation was started.
+ *         false - some error, done will not be called.
+ */
+bool PwmOnDutyAsync(uint8_t channel, uint16_t duty, PwmCompletionCallback done, void* context);
+
+/**
+ * @brief  Read back the state of a PWM channel from the hardware
+ *         (not the driver's shadow registers), to detect drift.
+ * @arg channel: [0 .. PWM_MAX_CHANNELS-1]
+ * @arg enabled: destination, true if the channel is on.
+ * @arg duty: destination, [0 .. PWM_DUTY_FULL_SCALE]
+ * @return true - completed successfully
+ *         false - some error.
+ */
+bool PwmReadback(uint8_t channel, bool* enabled, uint16_t* duty);
+
+/**
+ * @brief  Force the next PwmOn() or PwmOff() of a channel to be written
+ *         to the hardware, even when the shadow register already
+ *         holds the requested value.
+ * @arg channel: [0 .. PWM_MAX_CHANNELS-1]
+ */
+void PwmForceRefresh(uint8_t channel);
 
 /**
- * @brief PwmFactoryTest executes a self test. Will fail if PWM is on.
+ * @brief  Read the shadow register write cache counters.
+ * @arg stats: destination of the counters.
+ */
+void PwmGetWriteCacheStats(PwmWriteCacheStats* stats);
+
+/**
+ * @brief  Reset the shadow register write cache counters to zero.
+ */
+void PwmResetWriteCacheStats();
+
+/**
+ * @brief PwmFactoryTest executes a self test. Will fail if any PWM channel is on.
  * @return The device ID read during the factory test.
  *         Return value is 0xFFFF if test failed.
  */
 uint16_t PwmFactoryTest();
 
+/**
+ * @brief Begin a factory self test, to be run one bounded step at a
+ *        time with PwmFactoryTestStep(), so that a caller may handle
+ *        other work between the steps. Will fail if any PWM channel is on.
+ * @arg run: the test state, initialized by this call.
+ */
+void PwmFactoryTestBegin(PwmFactoryTestRun* run);
+
+/**
+ * @brief Execute the next step of a factory self test.
+ * @arg run: as initialized by PwmFactoryTestBegin().
+ * @return true - the test is complete, run->device_id holds the device ID
+ *                (0xFFFF if the test failed), as returned by PwmFactoryTest().
+ *         false - more steps remain.
+ */
+bool PwmFactoryTestStep(PwmFactoryTestRun* run);
+
+/**
+ * @brief Start the factory self test, without blocking.
+ *        Asynchronous variant of PwmFactoryTest().
+ * @arg done: called exactly once with the device ID when the test completes.
+ * @arg context: passed to done.
+ * @return true - the test was started.
+ *         false - some error, done will not be called.
+ */
+bool PwmFactoryTestAsync(PwmFactoryTestCallback done, void* context);
+
 #ifdef __cplusplus
 }
 #endif
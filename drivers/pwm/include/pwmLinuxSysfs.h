@@ -0,0 +1,94 @@
+/*
+MIT License
+
+Copyright (c) <2019-2024> <Matthew Eshleman - https://covemountainsoftware.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @brief Configuration of the Linux sysfs (/sys/class/pwm) backend of
+ *        the PWM driver (pwm.h). Each channel is a PWM of one chip.
+ *        The period, duty_cycle and enable files of a channel are opened
+ *        on its first use (exporting the channel when needed), and kept
+ *        open: each write is a single pwrite() of a formatted integer,
+ *        and each read back a pread(). The period is only written when
+ *        it changes. The factory test reports the chip's number of
+ *        PWMs (npwm) as the device ID. The backend is not thread safe.
+ */
+#ifndef PWM_LINUX_SYSFS_H
+#define PWM_LINUX_SYSFS_H
+
+#include "pwm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief The PWM chip driven by default.
+ */
+#define PWM_SYSFS_DEFAULT_CHIP "/sys/class/pwm/pwmchip0"
+
+/**
+ * @brief The PWM period used by default, in nanoseconds (1 kHz).
+ */
+#define PWM_SYSFS_DEFAULT_PERIOD_NS 1000000U
+
+/**
+ * @brief The syscalls issued by the backend, for benchmarks and tests.
+ */
+typedef struct {
+    uint32_t opens;
+    uint32_t closes;
+    uint32_t reads;
+    uint32_t writes;
+} PwmSysfsSyscallStats;
+
+/**
+ * @brief  Select the chip and the period, before PwmInit(). Closes
+ *         every file of the previous configuration.
+ * @arg chip_path: the chip's directory, e.g. PWM_SYSFS_DEFAULT_CHIP.
+ *                 The string must outlive the configuration.
+ * @arg period_ns: the period of every channel, (0 .. UINT32_MAX].
+ * @return true - configured. false - some error.
+ */
+bool PwmSysfsConfigure(const char* chip_path, uint32_t period_ns);
+
+/**
+ * @brief  Close every open file. Channels are left as they are.
+ */
+void PwmSysfsClose();
+
+/**
+ * @brief  Read the syscall counters.
+ * @arg stats: destination of the counters.
+ */
+void PwmSysfsGetSyscallStats(PwmSysfsSyscallStats* stats);
+
+/**
+ * @brief  Reset the syscall counters to zero.
+ */
+void PwmSysfsResetSyscallStats();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //PWM_LINUX_SYSFS_H
@@ -0,0 +1,174 @@
+/*
+MIT License
+
+Copyright (c) <2019-2024> <Matthew Eshleman - https://covemountainsoftware.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @brief Deferred binary logging of the PWM driver. A log statement
+ *        only writes a record (a format ID and its raw arguments) into
+ *        a lock-free ring, formatting nothing. A reader (a background
+ *        thread, or a dump for an offline tool) takes the records out
+ *        of the ring later, and formats them with PwmLogFormatRecord(),
+ *        or with PwmLogDrain(). The ring has a single writer, the
+ *        driver, and a single reader. A record written to a full ring
+ *        is dropped, and counted, so the application must drain the
+ *        ring periodically.
+ *
+ *        Statements above PWM_LOG_LEVEL are compiled out.
+ */
+#ifndef PWM_LOG_H
+#define PWM_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PWM_LOG_LEVEL_NONE  0
+#define PWM_LOG_LEVEL_ERROR 1
+#define PWM_LOG_LEVEL_INFO  2
+#define PWM_LOG_LEVEL_DEBUG 3
+
+/**
+ * @brief The most verbose level logged. May be overridden by the build.
+ *        Errors only by default, as debug logs every hardware access.
+ */
+#ifndef PWM_LOG_LEVEL
+#define PWM_LOG_LEVEL PWM_LOG_LEVEL_ERROR
+#endif
+
+/**
+ * @brief The records held by the ring, a power of two.
+ *        May be overridden by the build.
+ */
+#ifndef PWM_LOG_CAPACITY
+#define PWM_LOG_CAPACITY 256U
+#endif
+
+/**
+ * @brief The format of a record, see PwmLogFormat().
+ */
+typedef enum {
+    PWM_LOG_INIT,              // no arguments
+    PWM_LOG_OFF,               // channel
+    PWM_LOG_ON_DUTY,           // channel, duty
+    PWM_LOG_READBACK,          // channel
+    PWM_LOG_FACTORY_TEST_STEP, // step
+    PWM_LOG_BAD_CHANNEL,       // channel
+    PWM_LOG_ID_COUNT
+} PwmLogId;
+
+#define PWM_LOG_ARG_COUNT 3
+
+/**
+ * @brief The longest line formatted by PwmLogDrain(), with its null.
+ */
+#define PWM_LOG_LINE_LENGTH 64
+
+typedef struct {
+    uint16_t id; // a PwmLogId
+    uint16_t args[PWM_LOG_ARG_COUNT];
+} PwmLogRecord;
+
+/**
+ * @brief  Write a record to the ring. Use the PWM_LOG_* macros instead,
+ *         so the statement is compiled out above PWM_LOG_LEVEL.
+ * @return true - written. false - the ring is full, the record is dropped.
+ */
+bool PwmLogWrite(uint16_t id, uint16_t arg0, uint16_t arg1, uint16_t arg2);
+
+/**
+ * @brief  Take the oldest record out of the ring.
+ * @arg record: destination of the record.
+ * @return true - a record was read. false - the ring is empty.
+ */
+bool PwmLogRead(PwmLogRecord* record);
+
+/**
+ * @brief  The records dropped, the ring being full, since PwmLogReset().
+ */
+uint32_t PwmLogDropped();
+
+/**
+ * @brief  Empty the ring and reset the dropped count. Neither the
+ *         writer nor the reader may be using the ring.
+ */
+void PwmLogReset();
+
+/**
+ * @brief  The printf() format of a record, for an offline tool.
+ * @return the format, or NULL for an unknown ID.
+ */
+const char* PwmLogFormat(uint16_t id);
+
+/**
+ * @brief  Format a record as text, without a newline.
+ * @return as snprintf(), a negative value for an unknown ID.
+ */
+int PwmLogFormatRecord(const PwmLogRecord* record, char* text, size_t size);
+
+/**
+ * @brief  Receives each line formatted by PwmLogDrain().
+ */
+typedef void (*PwmLogSink)(const char* line, void* context);
+
+/**
+ * @brief  The reader side of the log: take every record out of the
+ *         ring, oldest first, and pass each formatted line to sink,
+ *         followed by a count of the records dropped since the last
+ *         drain, if any. Call it periodically from the single reader,
+ *         e.g. an idle loop or a background thread.
+ * @arg sink: receives each line, without a newline.
+ * @arg context: passed to sink.
+ * @return the records taken out of the ring.
+ */
+size_t PwmLogDrain(PwmLogSink sink, void* context);
+
+#define PWM_LOG_RECORD_(id, a0, a1, a2) \
+    ((void)PwmLogWrite((uint16_t)(id), (uint16_t)(a0), (uint16_t)(a1), (uint16_t)(a2)))
+
+#if PWM_LOG_LEVEL >= PWM_LOG_LEVEL_ERROR
+#define PWM_LOG_ERROR(id, a0, a1, a2) PWM_LOG_RECORD_(id, a0, a1, a2)
+#else
+#define PWM_LOG_ERROR(id, a0, a1, a2) ((void)0)
+#endif
+
+#if PWM_LOG_LEVEL >= PWM_LOG_LEVEL_INFO
+#define PWM_LOG_INFO(id, a0, a1, a2) PWM_LOG_RECORD_(id, a0, a1, a2)
+#else
+#define PWM_LOG_INFO(id, a0, a1, a2) ((void)0)
+#endif
+
+#if PWM_LOG_LEVEL >= PWM_LOG_LEVEL_DEBUG
+#define PWM_LOG_DEBUG(id, a0, a1, a2) PWM_LOG_RECORD_(id, a0, a1, a2)
+#else
+#define PWM_LOG_DEBUG(id, a0, a1, a2) ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //PWM_LOG_H
@@ -2,31 +2,179 @@
  *   This concrete implementation of the PWM
  *   is for demo purposes only. The focus of this project
  *   is how to test state machines and active objects, hence
- *   this fake hardware driver module.
+ *   this fake hardware driver module. Each hardware access is
+ *   logged with the deferred binary log (pwmLog.h), so the
+ *   driver's calls never format text.
  */
 #include "pwm.h"
-#include <stdio.h>
+#include "pwmLog.h"
+
+/*
+ *   Shadow of the last value written to each channel's
+ *   hardware registers. A write matching a valid shadow
+ *   is skipped, saving a (slow) bus transaction.
+ */
+typedef struct {
+    uint16_t duty[PWM_MAX_CHANNELS];
+    bool enabled[PWM_MAX_CHANNELS];
+    bool valid[PWM_MAX_CHANNELS];
+} PwmShadowRegisters;
+
+static PwmShadowRegisters m_shadow;
+static PwmWriteCacheStats m_stats;
+
+static void invalidateShadow()
+{
+    for (uint8_t channel = 0; channel < PWM_MAX_CHANNELS; ++channel) {
+        m_shadow.valid[channel] = false;
+    }
+}
 
 bool PwmInit()
 {
-    printf("%s() executed\n", __FUNCTION__);
+    PWM_LOG_INFO(PWM_LOG_INIT, 0, 0, 0);
+
+    //hardware state is unknown after init
+    invalidateShadow();
+    return true;
+}
+
+bool PwmOff(uint8_t channel)
+{
+    if (channel >= PWM_MAX_CHANNELS) {
+        PWM_LOG_ERROR(PWM_LOG_BAD_CHANNEL, channel, 0, 0);
+        return false;
+    }
+
+    if (m_shadow.valid[channel] && !m_shadow.enabled[channel]) {
+        ++m_stats.hits;
+        return true;
+    }
+
+    ++m_stats.misses;
+    PWM_LOG_DEBUG(PWM_LOG_OFF, channel, 0, 0);
+
+    m_shadow.enabled[channel] = false;
+    m_shadow.valid[channel] = true;
     return true;
 }
 
-bool PwmOff()
+bool PwmOn(uint8_t channel, float percent)
+{
+    return PwmOnDuty(channel, PwmPercentToDuty(percent));
+}
+
+bool PwmOnDuty(uint8_t channel, uint16_t duty)
 {
-    printf("%s() executed\n", __FUNCTION__);
+    if (channel >= PWM_MAX_CHANNELS) {
+        PWM_LOG_ERROR(PWM_LOG_BAD_CHANNEL, channel, 0, 0);
+        return false;
+    }
+
+    if (m_shadow.valid[channel] && m_shadow.enabled[channel] &&
+        (m_shadow.duty[channel] == duty)) {
+        ++m_stats.hits;
+        return true;
+    }
+
+    ++m_stats.misses;
+    PWM_LOG_DEBUG(PWM_LOG_ON_DUTY, channel, duty, 0);
+
+    m_shadow.duty[channel] = duty;
+    m_shadow.enabled[channel] = true;
+    m_shadow.valid[channel] = true;
     return true;
 }
 
-bool PwmOn(float percent)
+/*
+ *   The demo hardware is not behind a slow bus, so the
+ *   asynchronous operations complete immediately, calling
+ *   back from within the call.
+ */
+bool PwmOffAsync(uint8_t channel, PwmCompletionCallback done, void* context)
 {
-    printf("%s(%f) executed\n", __FUNCTION__, percent);
+    if (channel >= PWM_MAX_CHANNELS) {
+        PWM_LOG_ERROR(PWM_LOG_BAD_CHANNEL, channel, 0, 0);
+        return false;
+    }
+
+    done(context, PwmOff(channel));
     return true;
 }
 
+bool PwmOnDutyAsync(uint8_t channel, uint16_t duty, PwmCompletionCallback done, void* context)
+{
+    if (channel >= PWM_MAX_CHANNELS) {
+        PWM_LOG_ERROR(PWM_LOG_BAD_CHANNEL, channel, 0, 0);
+        return false;
+    }
+
+    done(context, PwmOnDuty(channel, duty));
+    return true;
+}
+
+bool PwmReadback(uint8_t channel, bool* enabled, uint16_t* duty)
+{
+    if (channel >= PWM_MAX_CHANNELS) {
+        PWM_LOG_ERROR(PWM_LOG_BAD_CHANNEL, channel, 0, 0);
+        return false;
+    }
+
+    //this fake hardware never drifts, the last written values
+    //are what the hardware holds.
+    PWM_LOG_DEBUG(PWM_LOG_READBACK, channel, 0, 0);
+    *enabled = m_shadow.valid[channel] && m_shadow.enabled[channel];
+    *duty = m_shadow.duty[channel];
+    return true;
+}
+
+void PwmForceRefresh(uint8_t channel)
+{
+    if (channel < PWM_MAX_CHANNELS) {
+        m_shadow.valid[channel] = false;
+    }
+}
+
+void PwmGetWriteCacheStats(PwmWriteCacheStats* stats)
+{
+    *stats = m_stats;
+}
+
+void PwmResetWriteCacheStats()
+{
+    m_stats.hits = 0;
+    m_stats.misses = 0;
+}
+
 uint16_t PwmFactoryTest()
 {
-    printf("%s() executed\n", __FUNCTION__);
-    return 1;
+    PwmFactoryTestRun run;
+    PwmFactoryTestBegin(&run);
+    while (!PwmFactoryTestStep(&run)) {
+    }
+    return run.device_id;
+}
+
+void PwmFactoryTestBegin(PwmFactoryTestRun* run)
+{
+    run->step = 0;
+    run->device_id = 0xFFFF;
+}
+
+bool PwmFactoryTestStep(PwmFactoryTestRun* run)
+{
+    PWM_LOG_INFO(PWM_LOG_FACTORY_TEST_STEP, run->step, 0, 0);
+
+    //the last step reads the device ID
+    if (++run->step < PWM_FACTORY_TEST_STEPS) {
+        return false;
+    }
+    run->device_id = 1;
+    return true;
+}
+
+bool PwmFactoryTestAsync(PwmFactoryTestCallback done, void* context)
+{
+    done(context, PwmFactoryTest());
+    return true;
 }
@@ -0,0 +1,516 @@
+/*
+ *   Linux sysfs (/sys/class/pwm) implementation of the PWM driver.
+ *   See pwmLinuxSysfs.h for its configuration.
+ *
+ *   A channel's sysfs files are opened once and kept open, so that
+ *   turning a channel on or off is one pwrite() per changed attribute,
+ *   instead of an open(), write() and close() of each attribute. Values
+ *   are written as decimal integers followed by a newline, formatted
+ *   without stdio. The period never changes once written, and is
+ *   formatted once, when configured. After PwmForceRefresh() the period
+ *   and enable are read back, and only rewritten if they drifted, so a
+ *   drift correction leaves the output running.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "pwmLinuxSysfs.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+enum SysfsFile {
+    FILE_PERIOD,
+    FILE_DUTY_CYCLE,
+    FILE_ENABLE,
+    FILE_COUNT
+};
+
+static const char* const FILE_NAMES[FILE_COUNT] = {"period", "duty_cycle", "enable"};
+
+#define PATH_LENGTH 256
+#define VALUE_LENGTH 12 //a 32 bit decimal integer and a newline
+
+/*
+ *   Shadow of the last value written to each channel, as in the demo
+ *   driver (pwm.c). A write matching a valid shadow is skipped.
+ */
+typedef struct {
+    uint16_t duty[PWM_MAX_CHANNELS];
+    bool enabled[PWM_MAX_CHANNELS];
+    bool valid[PWM_MAX_CHANNELS];
+} PwmShadowRegisters;
+
+typedef struct {
+    int fd[FILE_COUNT];
+    bool open;
+    bool period_written; //the configured period, since opened
+    bool verify; //read back period and enable, see PwmForceRefresh()
+} SysfsChannel;
+
+typedef struct {
+    bool configured;
+    const char* chip;
+    uint32_t period_ns;
+    char period_text[VALUE_LENGTH];
+    size_t period_length;
+    uint32_t channel_count; //as read by PwmInit()
+    SysfsChannel channels[PWM_MAX_CHANNELS];
+} SysfsChip;
+
+static PwmShadowRegisters m_shadow;
+static PwmWriteCacheStats m_stats;
+static PwmSysfsSyscallStats m_syscalls;
+static SysfsChip m_chip;
+
+static const char OFF_TEXT[] = "0\n";
+static const char ON_TEXT[] = "1\n";
+
+static void invalidateShadow()
+{
+    for (uint8_t channel = 0; channel < PWM_MAX_CHANNELS; ++channel) {
+        m_shadow.valid[channel] = false;
+    }
+}
+
+static size_t formatValue(char* text, uint32_t value)
+{
+    char digits[VALUE_LENGTH];
+    size_t count = 0;
+    do {
+        digits[count++] = (char)('0' + (value % 10U));
+        value /= 10U;
+    } while (value != 0U);
+
+    size_t length = 0;
+    while (count > 0U) {
+        text[length++] = digits[--count];
+    }
+    text[length++] = '\n';
+    return length;
+}
+
+static bool parseValue(const char* text, size_t length, uint32_t* value)
+{
+    uint64_t result = 0;
+    size_t digits = 0;
+    while ((digits < length) && (text[digits] >= '0') && (text[digits] <= '9')) {
+        result = (result * 10U) + (uint64_t)(text[digits] - '0');
+        if (result > UINT32_MAX) {
+            return false;
+        }
+        ++digits;
+    }
+    *value = (uint32_t)result;
+    return digits > 0U;
+}
+
+static int countedOpen(const char* path, int flags)
+{
+    ++m_syscalls.opens;
+    return open(path, flags | O_CLOEXEC);
+}
+
+static void countedClose(int fd)
+{
+    ++m_syscalls.closes;
+    (void)close(fd);
+}
+
+static bool writeValue(int fd, const char* text, size_t length)
+{
+    ++m_syscalls.writes;
+    return pwrite(fd, text, length, 0) == (ssize_t)length;
+}
+
+static bool readValue(int fd, uint32_t* value)
+{
+    char text[VALUE_LENGTH];
+    ++m_syscalls.reads;
+    ssize_t const length = pread(fd, text, sizeof(text), 0);
+    return (length > 0) && parseValue(text, (size_t)length, value);
+}
+
+// Read a chip attribute, which is not kept open.
+static bool readChipFile(const char* name, uint32_t* value)
+{
+    char path[PATH_LENGTH];
+    if (snprintf(path, sizeof(path), "%s/%s", m_chip.chip, name) >= (int)sizeof(path)) {
+        return false;
+    }
+    int const fd = countedOpen(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool const ok = readValue(fd, value);
+    countedClose(fd);
+    return ok;
+}
+
+static bool exportChannel(uint8_t channel)
+{
+    char path[PATH_LENGTH];
+    if (snprintf(path, sizeof(path), "%s/export", m_chip.chip) >= (int)sizeof(path)) {
+        return false;
+    }
+    int const fd = countedOpen(path, O_WRONLY);
+    if (fd < 0) {
+        return false;
+    }
+    char text[VALUE_LENGTH];
+    bool const ok = writeValue(fd, text, formatValue(text, channel));
+    countedClose(fd);
+    return ok;
+}
+
+static void closeChannel(SysfsChannel* sysfs)
+{
+    for (int file = 0; file < FILE_COUNT; ++file) {
+        if (sysfs->fd[file] >= 0) {
+            countedClose(sysfs->fd[file]);
+            sysfs->fd[file] = -1;
+        }
+    }
+    sysfs->open = false;
+}
+
+static bool openChannelFiles(uint8_t channel, SysfsChannel* sysfs)
+{
+    for (int file = 0; file < FILE_COUNT; ++file) {
+        char path[PATH_LENGTH];
+        if (snprintf(path, sizeof(path), "%s/pwm%u/%s", m_chip.chip, channel, FILE_NAMES[file]) >=
+            (int)sizeof(path)) {
+            return false;
+        }
+        sysfs->fd[file] = countedOpen(path, O_RDWR);
+        if (sysfs->fd[file] < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Open the files of a channel, on its first use.
+static SysfsChannel* openChannel(uint8_t channel)
+{
+    SysfsChannel* const sysfs = &m_chip.channels[channel];
+    if (sysfs->open) {
+        return sysfs;
+    }
+
+    bool opened = openChannelFiles(channel, sysfs);
+    if (!opened && (errno == ENOENT)) {
+        closeChannel(sysfs);
+        opened = exportChannel(channel) && openChannelFiles(channel, sysfs);
+    }
+    if (!opened) {
+        closeChannel(sysfs);
+        return NULL;
+    }
+
+    sysfs->open = true;
+    sysfs->period_written = false;
+    sysfs->verify = false;
+    return sysfs;
+}
+
+// The kernel rejects a period shorter than the duty cycle, so the duty
+// cycle is cleared first, but only when it is longer than the period.
+static bool writePeriod(SysfsChannel* sysfs)
+{
+    uint32_t duty_ns = 0;
+    bool ok = true;
+    if (!readValue(sysfs->fd[FILE_DUTY_CYCLE], &duty_ns) || (duty_ns > m_chip.period_ns)) {
+        ok = writeValue(sysfs->fd[FILE_DUTY_CYCLE], OFF_TEXT, sizeof(OFF_TEXT) - 1U);
+    }
+    return ok && writeValue(sysfs->fd[FILE_PERIOD], m_chip.period_text, m_chip.period_length);
+}
+
+// Once forced to refresh, the channel's period and enable are read
+// back rather than trusted. Anything unreadable is rewritten.
+static void verifyChannel(SysfsChannel* sysfs, bool* enabled)
+{
+    uint32_t value = 0;
+    if (!readValue(sysfs->fd[FILE_PERIOD], &value) || (value != m_chip.period_ns)) {
+        sysfs->period_written = false;
+    }
+    *enabled = readValue(sysfs->fd[FILE_ENABLE], &value) && (value != 0U);
+    sysfs->verify = false;
+}
+
+static uint32_t dutyToNs(uint16_t duty)
+{
+    return (uint32_t)(((uint64_t)duty * m_chip.period_ns) / PWM_DUTY_FULL_SCALE);
+}
+
+static uint16_t nsToDuty(uint32_t ns)
+{
+    if (ns >= m_chip.period_ns) {
+        return PWM_DUTY_FULL_SCALE;
+    }
+    return (uint16_t)((((uint64_t)ns * PWM_DUTY_FULL_SCALE) + (m_chip.period_ns / 2U)) / m_chip.period_ns);
+}
+
+static void applyDefaultConfiguration()
+{
+    if (!m_chip.configured) {
+        (void)PwmSysfsConfigure(PWM_SYSFS_DEFAULT_CHIP, PWM_SYSFS_DEFAULT_PERIOD_NS);
+    }
+}
+
+bool PwmSysfsConfigure(const char* chip_path, uint32_t period_ns)
+{
+    if ((chip_path == NULL) || (period_ns == 0U)) {
+        return false;
+    }
+
+    if (m_chip.configured) {
+        PwmSysfsClose();
+    }
+    else {
+        for (uint8_t channel = 0; channel < PWM_MAX_CHANNELS; ++channel) {
+            for (int file = 0; file < FILE_COUNT; ++file) {
+                m_chip.channels[channel].fd[file] = -1;
+            }
+            m_chip.channels[channel].open = false;
+        }
+    }
+
+    m_chip.chip = chip_path;
+    m_chip.period_ns = period_ns;
+    m_chip.period_length = formatValue(m_chip.period_text, period_ns);
+    m_chip.channel_count = 0;
+    m_chip.configured = true;
+    invalidateShadow();
+    return true;
+}
+
+void PwmSysfsClose()
+{
+    if (!m_chip.configured) {
+        return;
+    }
+    for (uint8_t channel = 0; channel < PWM_MAX_CHANNELS; ++channel) {
+        closeChannel(&m_chip.channels[channel]);
+    }
+}
+
+void PwmSysfsGetSyscallStats(PwmSysfsSyscallStats* stats)
+{
+    *stats = m_syscalls;
+}
+
+void PwmSysfsResetSyscallStats()
+{
+    m_syscalls.opens = 0;
+    m_syscalls.closes = 0;
+    m_syscalls.reads = 0;
+    m_syscalls.writes = 0;
+}
+
+bool PwmInit()
+{
+    applyDefaultConfiguration();
+    PwmSysfsClose();
+
+    //hardware state is unknown after init
+    invalidateShadow();
+
+    uint32_t npwm = 0;
+    m_chip.channel_count = 0;
+    if (!readChipFile("npwm", &npwm) || (npwm == 0U)) {
+        return false;
+    }
+    m_chip.channel_count = (npwm < PWM_MAX_CHANNELS) ? npwm : PWM_MAX_CHANNELS;
+    return true;
+}
+
+bool PwmOff(uint8_t channel)
+{
+    if (channel >= m_chip.channel_count) {
+        return false;
+    }
+
+    if (m_shadow.valid[channel] && !m_shadow.enabled[channel]) {
+        ++m_stats.hits;
+        return true;
+    }
+
+    SysfsChannel* const sysfs = openChannel(channel);
+    if ((sysfs == NULL) || !writeValue(sysfs->fd[FILE_ENABLE], OFF_TEXT, sizeof(OFF_TEXT) - 1U)) {
+        m_shadow.valid[channel] = false;
+        return false;
+    }
+
+    ++m_stats.misses;
+    m_shadow.enabled[channel] = false;
+    m_shadow.valid[channel] = true;
+    return true;
+}
+
+bool PwmOn(uint8_t channel, float percent)
+{
+    return PwmOnDuty(channel, PwmPercentToDuty(percent));
+}
+
+bool PwmOnDuty(uint8_t channel, uint16_t duty)
+{
+    if (channel >= m_chip.channel_count) {
+        return false;
+    }
+
+    bool enabled = m_shadow.valid[channel] && m_shadow.enabled[channel];
+    if (enabled && (m_shadow.duty[channel] == duty)) {
+        ++m_stats.hits;
+        return true;
+    }
+
+    SysfsChannel* const sysfs = openChannel(channel);
+    if (sysfs == NULL) {
+        m_shadow.valid[channel] = false;
+        return false;
+    }
+
+    if (sysfs->verify) {
+        verifyChannel(sysfs, &enabled);
+    }
+
+    bool ok = true;
+    if (!sysfs->period_written) {
+        ok = writePeriod(sysfs);
+        sysfs->period_written = ok;
+    }
+
+    char text[VALUE_LENGTH];
+    ok = ok && writeValue(sysfs->fd[FILE_DUTY_CYCLE], text, formatValue(text, dutyToNs(duty)));
+    if (ok && !enabled) {
+        ok = writeValue(sysfs->fd[FILE_ENABLE], ON_TEXT, sizeof(ON_TEXT) - 1U);
+    }
+    if (!ok) {
+        m_shadow.valid[channel] = false;
+        return false;
+    }
+
+    ++m_stats.misses;
+    m_shadow.duty[channel] = duty;
+    m_shadow.enabled[channel] = true;
+    m_shadow.valid[channel] = true;
+    return true;
+}
+
+/*
+ *   sysfs writes complete on return, so the asynchronous
+ *   operations complete immediately, calling back from
+ *   within the call.
+ */
+bool PwmOffAsync(uint8_t channel, PwmCompletionCallback done, void* context)
+{
+    if (channel >= m_chip.channel_count) {
+        return false;
+    }
+
+    done(context, PwmOff(channel));
+    return true;
+}
+
+bool PwmOnDutyAsync(uint8_t channel, uint16_t duty, PwmCompletionCallback done, void* context)
+{
+    if (channel >= m_chip.channel_count) {
+        return false;
+    }
+
+    done(context, PwmOnDuty(channel, duty));
+    return true;
+}
+
+bool PwmReadback(uint8_t channel, bool* enabled, uint16_t* duty)
+{
+    if (channel >= m_chip.channel_count) {
+        return false;
+    }
+
+    SysfsChannel* const sysfs = openChannel(channel);
+    uint32_t enable = 0;
+    uint32_t duty_ns = 0;
+    if ((sysfs == NULL) || !readValue(sysfs->fd[FILE_ENABLE], &enable) ||
+        !readValue(sysfs->fd[FILE_DUTY_CYCLE], &duty_ns)) {
+        return false;
+    }
+
+    *enabled = (enable != 0U);
+
+    //the nanoseconds written for the shadow's duty cycle read back
+    //as that duty cycle, whatever the rounding of the conversion.
+    if (m_shadow.valid[channel] && (duty_ns == dutyToNs(m_shadow.duty[channel]))) {
+        *duty = m_shadow.duty[channel];
+    }
+    else {
+        *duty = nsToDuty(duty_ns);
+    }
+    return true;
+}
+
+void PwmForceRefresh(uint8_t channel)
+{
+    if (channel < PWM_MAX_CHANNELS) {
+        m_shadow.valid[channel] = false;
+
+        //the drift may be of the period or enable too
+        m_chip.channels[channel].verify = true;
+    }
+}
+
+void PwmGetWriteCacheStats(PwmWriteCacheStats* stats)
+{
+    *stats = m_stats;
+}
+
+void PwmResetWriteCacheStats()
+{
+    m_stats.hits = 0;
+    m_stats.misses = 0;
+}
+
+uint16_t PwmFactoryTest()
+{
+    PwmFactoryTestRun run;
+    PwmFactoryTestBegin(&run);
+    while (!PwmFactoryTestStep(&run)) {
+    }
+    return run.device_id;
+}
+
+void PwmFactoryTestBegin(PwmFactoryTestRun* run)
+{
+    run->step = 0;
+    run->device_id = 0xFFFF;
+}
+
+/*
+ *   sysfs has no device ID: the test checks that no channel was left
+ *   on, then reports the chip's number of PWMs (npwm) as its ID.
+ */
+bool PwmFactoryTestStep(PwmFactoryTestRun* run)
+{
+    if (++run->step < PWM_FACTORY_TEST_STEPS) {
+        return false;
+    }
+
+    for (uint8_t channel = 0; channel < m_chip.channel_count; ++channel) {
+        if (m_shadow.valid[channel] && m_shadow.enabled[channel]) {
+            return true;
+        }
+    }
+
+    uint32_t npwm = 0;
+    if (m_chip.configured && readChipFile("npwm", &npwm) && (npwm < 0xFFFFU)) {
+        run->device_id = (uint16_t)npwm;
+    }
+    return true;
+}
+
+bool PwmFactoryTestAsync(PwmFactoryTestCallback done, void* context)
+{
+    done(context, PwmFactoryTest());
+    return true;
+}
@@ -0,0 +1,118 @@
+/*
+ *   Deferred binary logging of the PWM driver, see pwmLog.h.
+ *
+ *   The ring is lock-free for its single writer and single reader:
+ *   each owns one index, the writer publishing a record by releasing
+ *   its index after filling the slot, the reader freeing a slot by
+ *   releasing its own index after copying it out.
+ */
+#include "pwmLog.h"
+#include <stdatomic.h>
+#include <stdio.h>
+
+_Static_assert((PWM_LOG_CAPACITY & (PWM_LOG_CAPACITY - 1U)) == 0U,
+               "the PWM log capacity must be a power of two");
+
+#define SLOT_MASK (PWM_LOG_CAPACITY - 1U)
+
+typedef struct {
+    PwmLogRecord records[PWM_LOG_CAPACITY];
+    atomic_uint_fast32_t written; //by the writer
+    atomic_uint_fast32_t read;    //by the reader
+    atomic_uint_fast32_t dropped;
+    uint32_t dropped_drained; //by the reader, see PwmLogDrain()
+} PwmLogRing;
+
+static PwmLogRing m_ring;
+
+static const char* const FORMATS[PWM_LOG_ID_COUNT] = {
+    [PWM_LOG_INIT] = "PwmInit() executed",
+    [PWM_LOG_OFF] = "PwmOff(%u) executed",
+    [PWM_LOG_ON_DUTY] = "PwmOnDuty(%u, %u) executed",
+    [PWM_LOG_READBACK] = "PwmReadback(%u) executed",
+    [PWM_LOG_FACTORY_TEST_STEP] = "PwmFactoryTestStep(%u) executed",
+    [PWM_LOG_BAD_CHANNEL] = "channel %u rejected, beyond PWM_MAX_CHANNELS",
+};
+
+bool PwmLogWrite(uint16_t id, uint16_t arg0, uint16_t arg1, uint16_t arg2)
+{
+    uint_fast32_t const written = atomic_load_explicit(&m_ring.written, memory_order_relaxed);
+    uint_fast32_t const read = atomic_load_explicit(&m_ring.read, memory_order_acquire);
+    if ((uint32_t)(written - read) >= PWM_LOG_CAPACITY) {
+        atomic_fetch_add_explicit(&m_ring.dropped, 1U, memory_order_relaxed);
+        return false;
+    }
+
+    PwmLogRecord* const record = &m_ring.records[written & SLOT_MASK];
+    record->id = id;
+    record->args[0] = arg0;
+    record->args[1] = arg1;
+    record->args[2] = arg2;
+    atomic_store_explicit(&m_ring.written, (uint32_t)(written + 1U), memory_order_release);
+    return true;
+}
+
+bool PwmLogRead(PwmLogRecord* record)
+{
+    uint_fast32_t const read = atomic_load_explicit(&m_ring.read, memory_order_relaxed);
+    uint_fast32_t const written = atomic_load_explicit(&m_ring.written, memory_order_acquire);
+    if (read == written) {
+        return false;
+    }
+
+    *record = m_ring.records[read & SLOT_MASK];
+    atomic_store_explicit(&m_ring.read, (uint32_t)(read + 1U), memory_order_release);
+    return true;
+}
+
+uint32_t PwmLogDropped()
+{
+    return (uint32_t)atomic_load_explicit(&m_ring.dropped, memory_order_relaxed);
+}
+
+void PwmLogReset()
+{
+    atomic_store(&m_ring.written, 0U);
+    atomic_store(&m_ring.read, 0U);
+    atomic_store(&m_ring.dropped, 0U);
+    m_ring.dropped_drained = 0U;
+}
+
+const char* PwmLogFormat(uint16_t id)
+{
+    return (id < PWM_LOG_ID_COUNT) ? FORMATS[id] : NULL;
+}
+
+int PwmLogFormatRecord(const PwmLogRecord* record, char* text, size_t size)
+{
+    const char* const format = PwmLogFormat(record->id);
+    if (format == NULL) {
+        return -1;
+    }
+
+    //a format uses the leading arguments it needs, the rest are ignored
+    return snprintf(text, size, format, record->args[0], record->args[1], record->args[2]);
+}
+
+size_t PwmLogDrain(PwmLogSink sink, void* context)
+{
+    char text[PWM_LOG_LINE_LENGTH];
+    size_t count = 0;
+    PwmLogRecord record;
+    while (PwmLogRead(&record)) {
+        if (PwmLogFormatRecord(&record, text, sizeof(text)) >= 0) {
+            sink(text, context);
+        }
+        ++count;
+    }
+
+    //the drops happened once the ring was full, after the records read
+    uint32_t const dropped = PwmLogDropped();
+    if (dropped != m_ring.dropped_drained) {
+        (void)snprintf(text, sizeof(text), "%lu records dropped",
+                       (unsigned long)(uint32_t)(dropped - m_ring.dropped_drained));
+        m_ring.dropped_drained = dropped;
+        sink(text, context);
+    }
+    return count;
+}
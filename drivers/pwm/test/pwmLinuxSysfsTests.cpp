@@ -0,0 +1,271 @@
+/// @brief  Tests of the Linux sysfs backend of the PWM driver, against a
+///         fake sysfs PWM chip in a temporary directory. Besides what is
+///         written, the tests check the syscalls each call costs.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+/// Copyright (C) 2024 Matthew Eshleman. All rights reserved.
+///
+/// This program is open source software: you can redistribute it and/or
+/// modify it under the terms of the GNU General Public License as published
+/// by the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// Alternatively, upon written permission from Matthew Eshleman, this program
+/// may be distributed and modified under the terms of a Commercial
+/// License. For further details, see the Contact Information below.
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#include "pwmLinuxSysfs.h"
+#include "sysfs/cmsFakeSysfsPwmChip.hpp"
+#include <memory>
+#include <string>
+
+// the cpputest headers must always be last
+#include "CppUTest/TestHarness.h"
+
+using cms::test::FakeSysfsPwmChip;
+
+static constexpr uint32_t PERIOD_NS = 1000000U;
+static constexpr unsigned NPWM = 4;
+
+TEST_GROUP(PwmLinuxSysfsTests)
+{
+    std::unique_ptr<FakeSysfsPwmChip> mChip;
+
+    void setup() final
+    {
+        mChip.reset(new FakeSysfsPwmChip(NPWM, NPWM));
+        CHECK_TRUE(mChip->isValid());
+        CHECK_TRUE(PwmSysfsConfigure(mChip->path().c_str(), PERIOD_NS));
+        CHECK_TRUE(PwmInit());
+        PwmSysfsResetSyscallStats();
+    }
+
+    void teardown() final
+    {
+        PwmSysfsClose();
+        mChip.reset();
+    }
+
+    static PwmSysfsSyscallStats syscalls()
+    {
+        PwmSysfsSyscallStats stats;
+        PwmSysfsGetSyscallStats(&stats);
+        PwmSysfsResetSyscallStats();
+        return stats;
+    }
+
+    static std::string ns(uint16_t duty)
+    {
+        return std::to_string((uint64_t(duty) * PERIOD_NS) / PWM_DUTY_FULL_SCALE);
+    }
+};
+
+TEST(PwmLinuxSysfsTests, given_a_missing_chip_when_initialized_then_it_fails_and_no_channel_is_usable)
+{
+    CHECK_TRUE(PwmSysfsConfigure("/nonexistent/pwmchip0", PERIOD_NS));
+    CHECK_FALSE(PwmInit());
+    CHECK_FALSE(PwmOnDuty(0, 0x8000));
+    CHECK_FALSE(PwmOff(0));
+}
+
+TEST(PwmLinuxSysfsTests, given_init_when_a_channel_beyond_the_chips_npwm_is_used_then_it_fails)
+{
+    CHECK_FALSE(PwmOnDuty(NPWM, 0x8000));
+    CHECK_FALSE(PwmOff(NPWM));
+    LONGS_EQUAL(0, syscalls().opens);
+}
+
+TEST(PwmLinuxSysfsTests, given_init_when_first_turned_on_then_period_duty_and_enable_are_written)
+{
+    CHECK_TRUE(PwmOnDuty(1, 0x8000));
+
+    STRCMP_EQUAL(std::to_string(PERIOD_NS).c_str(), mChip->value(1, "period").c_str());
+    STRCMP_EQUAL(ns(0x8000).c_str(), mChip->value(1, "duty_cycle").c_str());
+    STRCMP_EQUAL("1", mChip->value(1, "enable").c_str());
+    STRCMP_EQUAL("0", mChip->value(0, "enable").c_str());
+
+    const auto stats = syscalls();
+    LONGS_EQUAL(3, stats.opens);
+    LONGS_EQUAL(0, stats.closes);
+    LONGS_EQUAL(1, stats.reads);  //duty, not longer than the period
+    LONGS_EQUAL(3, stats.writes); //period, duty, enable
+}
+
+TEST(PwmLinuxSysfsTests, given_a_duty_longer_than_the_period_when_first_turned_on_then_the_duty_is_cleared_first)
+{
+    mChip->set(1, "duty_cycle", std::to_string(2 * PERIOD_NS));
+
+    CHECK_TRUE(PwmOnDuty(1, 0x8000));
+    STRCMP_EQUAL(std::to_string(PERIOD_NS).c_str(), mChip->value(1, "period").c_str());
+    STRCMP_EQUAL(ns(0x8000).c_str(), mChip->value(1, "duty_cycle").c_str());
+    LONGS_EQUAL(4, syscalls().writes); //duty cleared, period, duty, enable
+}
+
+TEST(PwmLinuxSysfsTests, given_on_when_the_duty_changes_then_only_the_duty_is_written_once)
+{
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    syscalls();
+
+    CHECK_TRUE(PwmOnDuty(0, 0x4000));
+    STRCMP_EQUAL(ns(0x4000).c_str(), mChip->value(0, "duty_cycle").c_str());
+
+    const auto stats = syscalls();
+    LONGS_EQUAL(0, stats.opens);
+    LONGS_EQUAL(0, stats.closes);
+    LONGS_EQUAL(0, stats.reads);
+    LONGS_EQUAL(1, stats.writes);
+}
+
+TEST(PwmLinuxSysfsTests, given_on_when_the_same_duty_is_requested_then_no_syscall_is_made)
+{
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    syscalls();
+
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    const auto stats = syscalls();
+    LONGS_EQUAL(0, stats.opens + stats.closes + stats.reads + stats.writes);
+}
+
+TEST(PwmLinuxSysfsTests, given_on_when_turned_off_then_only_enable_is_written_and_again_nothing)
+{
+    CHECK_TRUE(PwmOnDuty(2, 0x8000));
+    syscalls();
+
+    CHECK_TRUE(PwmOff(2));
+    STRCMP_EQUAL("0", mChip->value(2, "enable").c_str());
+    LONGS_EQUAL(1, syscalls().writes);
+
+    CHECK_TRUE(PwmOff(2));
+    LONGS_EQUAL(0, syscalls().writes);
+}
+
+TEST(PwmLinuxSysfsTests, given_off_when_turned_on_again_then_the_period_is_not_rewritten)
+{
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    CHECK_TRUE(PwmOff(0));
+    syscalls();
+
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    STRCMP_EQUAL("1", mChip->value(0, "enable").c_str());
+    LONGS_EQUAL(2, syscalls().writes); //duty, enable
+}
+
+TEST(PwmLinuxSysfsTests, given_on_when_read_back_then_the_written_duty_is_reported)
+{
+    CHECK_TRUE(PwmOnDuty(0, 0x8001));
+    syscalls();
+
+    bool enabled = false;
+    uint16_t duty = 0;
+    CHECK_TRUE(PwmReadback(0, &enabled, &duty));
+    CHECK_TRUE(enabled);
+    LONGS_EQUAL(0x8001, duty);
+    LONGS_EQUAL(2, syscalls().reads);
+}
+
+TEST(PwmLinuxSysfsTests, given_a_drifted_channel_when_read_back_then_the_drift_is_reported)
+{
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    mChip->set(0, "duty_cycle", "250000");
+    mChip->set(0, "enable", "0");
+
+    bool enabled = true;
+    uint16_t duty = 0;
+    CHECK_TRUE(PwmReadback(0, &enabled, &duty));
+    CHECK_FALSE(enabled);
+    LONGS_EQUAL(16384, duty); //a quarter of the period, rounded
+}
+
+TEST(PwmLinuxSysfsTests, given_a_forced_refresh_when_turned_on_then_the_period_is_rewritten)
+{
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    mChip->set(0, "period", "5");
+    PwmForceRefresh(0);
+    syscalls();
+
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    STRCMP_EQUAL(std::to_string(PERIOD_NS).c_str(), mChip->value(0, "period").c_str());
+
+    const auto stats = syscalls();
+    LONGS_EQUAL(0, stats.opens);
+    LONGS_EQUAL(3, stats.reads);  //period, enable, duty
+    LONGS_EQUAL(2, stats.writes); //period, duty, the channel is still enabled
+}
+
+TEST(PwmLinuxSysfsTests, given_a_drifted_duty_when_refreshed_then_only_the_duty_is_written)
+{
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    mChip->set(0, "duty_cycle", "250000");
+    PwmForceRefresh(0);
+    syscalls();
+
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    STRCMP_EQUAL(ns(0x8000).c_str(), mChip->value(0, "duty_cycle").c_str());
+    STRCMP_EQUAL(std::to_string(PERIOD_NS).c_str(), mChip->value(0, "period").c_str());
+    STRCMP_EQUAL("1", mChip->value(0, "enable").c_str());
+
+    const auto stats = syscalls();
+    LONGS_EQUAL(0, stats.opens);
+    LONGS_EQUAL(2, stats.reads);  //period, enable
+    LONGS_EQUAL(1, stats.writes); //duty
+}
+
+TEST(PwmLinuxSysfsTests, given_a_disabled_channel_when_refreshed_then_the_duty_and_enable_are_written)
+{
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    mChip->set(0, "enable", "0");
+    PwmForceRefresh(0);
+    syscalls();
+
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    STRCMP_EQUAL("1", mChip->value(0, "enable").c_str());
+    LONGS_EQUAL(2, syscalls().writes); //duty, enable
+}
+
+TEST(PwmLinuxSysfsTests, given_an_unexported_channel_when_turned_on_then_it_is_exported)
+{
+    FakeSysfsPwmChip chip(NPWM, 1);
+    CHECK_TRUE(PwmSysfsConfigure(chip.path().c_str(), PERIOD_NS));
+    CHECK_TRUE(PwmInit());
+
+    //the fake does not create the exported channel, as the kernel would
+    CHECK_FALSE(PwmOnDuty(3, 0x8000));
+    STRCMP_EQUAL("3", chip.exported().c_str());
+
+    chip.exportChannel(3);
+    CHECK_TRUE(PwmOnDuty(3, 0x8000));
+    STRCMP_EQUAL("1", chip.value(3, "enable").c_str());
+
+    PwmSysfsClose();
+}
+
+TEST(PwmLinuxSysfsTests, given_open_channels_when_closed_then_every_opened_file_is_closed)
+{
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    CHECK_TRUE(PwmOnDuty(1, 0x8000));
+    PwmSysfsClose();
+
+    const auto stats = syscalls();
+    LONGS_EQUAL(6, stats.opens);
+    LONGS_EQUAL(6, stats.closes);
+}
+
+TEST(PwmLinuxSysfsTests, given_all_channels_off_when_factory_tested_then_npwm_is_the_device_id)
+{
+    LONGS_EQUAL(NPWM, PwmFactoryTest());
+}
+
+TEST(PwmLinuxSysfsTests, given_a_channel_on_when_factory_tested_then_it_fails)
+{
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    LONGS_EQUAL(0xFFFF, PwmFactoryTest());
+}
@@ -0,0 +1,194 @@
+/// @brief  Tests of the PWM driver's deferred binary log: its ring, the
+///         formatting of its records, and the records of the driver.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+/// Copyright (C) 2024 Matthew Eshleman. All rights reserved.
+///
+/// This program is open source software: you can redistribute it and/or
+/// modify it under the terms of the GNU General Public License as published
+/// by the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// Alternatively, upon written permission from Matthew Eshleman, this program
+/// may be distributed and modified under the terms of a Commercial
+/// License. For further details, see the Contact Information below.
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#include "pwm.h"
+#include "pwmLog.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// the cpputest headers must always be last
+#include "CppUTest/TestHarness.h"
+
+TEST_GROUP(PwmLogTests)
+{
+    void setup() final
+    {
+        PwmLogReset();
+    }
+
+    void teardown() final
+    {
+        PwmLogReset();
+    }
+
+    // the formatted records in the ring, emptying it
+    static std::vector<std::string> drain()
+    {
+        std::vector<std::string> lines;
+        PwmLogDrain(
+          [](const char* line, void* context) {
+              static_cast<std::vector<std::string>*>(context)->emplace_back(line);
+          },
+          &lines);
+        return lines;
+    }
+};
+
+TEST(PwmLogTests, given_empty_when_read_then_there_is_no_record)
+{
+    PwmLogRecord record;
+    CHECK_FALSE(PwmLogRead(&record));
+}
+
+TEST(PwmLogTests, given_driver_writes_when_drained_then_each_hardware_access_is_formatted_in_order)
+{
+    CHECK_TRUE(PwmInit());
+    CHECK_TRUE(PwmOnDuty(3, 0x8000));
+    CHECK_TRUE(PwmOff(3));
+
+    const auto lines = drain();
+    LONGS_EQUAL(3, lines.size());
+    STRCMP_EQUAL("PwmInit() executed", lines[0].c_str());
+    STRCMP_EQUAL("PwmOnDuty(3, 32768) executed", lines[1].c_str());
+    STRCMP_EQUAL("PwmOff(3) executed", lines[2].c_str());
+}
+
+TEST(PwmLogTests, given_a_bad_channel_when_driven_then_each_rejection_is_logged_as_an_error)
+{
+    CHECK_FALSE(PwmOff(PWM_MAX_CHANNELS));
+    CHECK_FALSE(PwmOnDuty(PWM_MAX_CHANNELS, 0x8000));
+
+    const auto rejected = "channel " + std::to_string(PWM_MAX_CHANNELS) + " rejected, beyond PWM_MAX_CHANNELS";
+    const auto lines = drain();
+    LONGS_EQUAL(2, lines.size());
+    STRCMP_EQUAL(rejected.c_str(), lines[0].c_str());
+    STRCMP_EQUAL(rejected.c_str(), lines[1].c_str());
+}
+
+TEST(PwmLogTests, given_a_cached_driver_write_when_drained_then_it_is_not_logged)
+{
+    CHECK_TRUE(PwmInit());
+    CHECK_TRUE(PwmOnDuty(1, 0x1000));
+    drain();
+
+    CHECK_TRUE(PwmOnDuty(1, 0x1000));
+    CHECK_TRUE(drain().empty());
+}
+
+TEST(PwmLogTests, given_a_full_ring_when_written_then_the_record_is_dropped_and_counted)
+{
+    for (uint16_t i = 0; i < PWM_LOG_CAPACITY; ++i) {
+        CHECK_TRUE(PwmLogWrite(PWM_LOG_OFF, i, 0, 0));
+    }
+    CHECK_FALSE(PwmLogWrite(PWM_LOG_OFF, 0xFFFF, 0, 0));
+    LONGS_EQUAL(1, PwmLogDropped());
+
+    PwmLogRecord record;
+    CHECK_TRUE(PwmLogRead(&record));
+    LONGS_EQUAL(0, record.args[0]);
+    CHECK_TRUE(PwmLogWrite(PWM_LOG_OFF, 0xFFFF, 0, 0));
+    LONGS_EQUAL(1, PwmLogDropped());
+}
+
+TEST(PwmLogTests, given_dropped_records_when_drained_then_the_drops_are_reported_once_after_the_records)
+{
+    for (uint16_t i = 0; i < PWM_LOG_CAPACITY + 2; ++i) {
+        PwmLogWrite(PWM_LOG_OFF, i, 0, 0);
+    }
+
+    auto lines = drain();
+    LONGS_EQUAL(PWM_LOG_CAPACITY + 1, lines.size());
+    STRCMP_EQUAL("PwmOff(0) executed", lines.front().c_str());
+    STRCMP_EQUAL("2 records dropped", lines.back().c_str());
+
+    CHECK_TRUE(PwmLogWrite(PWM_LOG_OFF, 7, 0, 0));
+    lines = drain();
+    LONGS_EQUAL(1, lines.size());
+    STRCMP_EQUAL("PwmOff(7) executed", lines[0].c_str());
+}
+
+TEST(PwmLogTests, given_the_ring_wraps_when_read_then_records_keep_their_order)
+{
+    PwmLogRecord record;
+    uint16_t next = 0;
+    uint16_t written = 0;
+    while (written < PWM_LOG_CAPACITY - 1) {
+        CHECK_TRUE(PwmLogWrite(PWM_LOG_ON_DUTY, 0, written++, 0));
+    }
+    while (written < 3 * PWM_LOG_CAPACITY) {
+        CHECK_TRUE(PwmLogWrite(PWM_LOG_ON_DUTY, 0, written++, 0));
+        CHECK_TRUE(PwmLogRead(&record));
+        LONGS_EQUAL(next++, record.args[1]);
+    }
+    while (PwmLogRead(&record)) {
+        LONGS_EQUAL(next++, record.args[1]);
+    }
+    LONGS_EQUAL(3 * PWM_LOG_CAPACITY, next);
+    LONGS_EQUAL(0, PwmLogDropped());
+}
+
+TEST(PwmLogTests, given_an_unknown_id_when_formatted_then_it_fails)
+{
+    const PwmLogRecord record = {PWM_LOG_ID_COUNT, {0, 0, 0}};
+    char text[16];
+    CHECK_TRUE(PwmLogFormat(PWM_LOG_ID_COUNT) == nullptr);
+    CHECK_TRUE(PwmLogFormatRecord(&record, text, sizeof(text)) < 0);
+}
+
+TEST(PwmLogTests, given_a_reader_thread_when_written_concurrently_then_every_record_is_read_in_order_or_dropped)
+{
+    constexpr uint32_t RECORDS = 50000;
+    uint32_t read = 0;
+    bool ordered = true;
+    std::atomic<bool> done {false};
+
+    std::thread reader([&] {
+        PwmLogRecord record;
+        uint32_t next = 0;
+        for (;;) {
+            //the writer is done before a last drain of the ring
+            const bool last = done.load();
+            while (PwmLogRead(&record)) {
+                const uint32_t sequence = (uint32_t(record.args[0]) << 16) | record.args[1];
+                ordered = ordered && (sequence >= next);
+                next = sequence + 1;
+                ++read;
+            }
+            if (last) {
+                break;
+            }
+        }
+    });
+
+    for (uint32_t i = 0; i < RECORDS; ++i) {
+        (void)PwmLogWrite(PWM_LOG_ON_DUTY, uint16_t(i >> 16), uint16_t(i), 0);
+    }
+    done = true;
+    reader.join();
+
+    CHECK_TRUE(ordered);
+    LONGS_EQUAL(RECORDS, read + PwmLogDropped());
+}
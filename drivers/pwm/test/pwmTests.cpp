@@ -0,0 +1,146 @@
+/// @brief  Tests of the demo PWM driver's shadow register write cache:
+///         which calls reach the hardware (misses), which are skipped
+///         (hits), and what invalidates the shadow.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+/// Copyright (C) 2024 Matthew Eshleman. All rights reserved.
+///
+/// This program is open source software: you can redistribute it and/or
+/// modify it under the terms of the GNU General Public License as published
+/// by the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// Alternatively, upon written permission from Matthew Eshleman, this program
+/// may be distributed and modified under the terms of a Commercial
+/// License. For further details, see the Contact Information below.
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#include "pwm.h"
+
+// the cpputest headers must always be last
+#include "CppUTest/TestHarness.h"
+
+TEST_GROUP(PwmTests)
+{
+    void setup() final
+    {
+        CHECK_TRUE(PwmInit());
+        PwmResetWriteCacheStats();
+    }
+
+    // the counters since the last call, resetting them
+    static PwmWriteCacheStats stats()
+    {
+        PwmWriteCacheStats stats;
+        PwmGetWriteCacheStats(&stats);
+        PwmResetWriteCacheStats();
+        return stats;
+    }
+
+    static void checkStats(uint32_t hits, uint32_t misses)
+    {
+        const PwmWriteCacheStats counted = stats();
+        LONGS_EQUAL(hits, counted.hits);
+        LONGS_EQUAL(misses, counted.misses);
+    }
+};
+
+TEST(PwmTests, given_init_when_a_channel_is_first_written_then_it_is_a_miss)
+{
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    CHECK_TRUE(PwmOff(1));
+    checkStats(0, 2);
+}
+
+TEST(PwmTests, given_on_when_the_same_duty_is_written_then_it_is_a_hit)
+{
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    stats();
+
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    checkStats(1, 0);
+}
+
+TEST(PwmTests, given_on_when_a_changed_duty_is_written_then_it_is_a_miss)
+{
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    stats();
+
+    CHECK_TRUE(PwmOnDuty(0, 0x8001));
+    checkStats(0, 1);
+
+    bool enabled = false;
+    uint16_t duty = 0;
+    CHECK_TRUE(PwmReadback(0, &enabled, &duty));
+    CHECK_TRUE(enabled);
+    LONGS_EQUAL(0x8001, duty);
+}
+
+TEST(PwmTests, given_off_when_turned_off_again_then_it_is_a_hit_and_on_is_a_miss)
+{
+    CHECK_TRUE(PwmOff(0));
+    stats();
+
+    CHECK_TRUE(PwmOff(0));
+    checkStats(1, 0);
+
+    CHECK_TRUE(PwmOnDuty(0, 0));
+    checkStats(0, 1);
+}
+
+TEST(PwmTests, given_a_forced_refresh_when_the_same_duty_is_written_then_it_is_a_miss)
+{
+    CHECK_TRUE(PwmOnDuty(2, 0x1234));
+    CHECK_TRUE(PwmOff(3));
+    PwmForceRefresh(2);
+    PwmForceRefresh(3);
+    stats();
+
+    CHECK_TRUE(PwmOnDuty(2, 0x1234));
+    CHECK_TRUE(PwmOff(3));
+    checkStats(0, 2);
+
+    //only the next write is forced
+    CHECK_TRUE(PwmOnDuty(2, 0x1234));
+    checkStats(1, 0);
+}
+
+TEST(PwmTests, given_a_forced_refresh_of_an_invalid_channel_then_it_is_ignored)
+{
+    PwmForceRefresh(PWM_MAX_CHANNELS);
+    CHECK_FALSE(PwmOnDuty(PWM_MAX_CHANNELS, 0x1234));
+    CHECK_FALSE(PwmOff(PWM_MAX_CHANNELS));
+    checkStats(0, 0);
+}
+
+TEST(PwmTests, given_cached_channels_when_initialized_again_then_every_write_is_a_miss)
+{
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    CHECK_TRUE(PwmOff(1));
+    CHECK_TRUE(PwmInit());
+    stats();
+
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    CHECK_TRUE(PwmOff(1));
+    checkStats(0, 2);
+}
+
+TEST(PwmTests, given_counted_writes_when_the_stats_are_reset_then_they_are_zero)
+{
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+    CHECK_TRUE(PwmOnDuty(0, 0x8000));
+
+    PwmResetWriteCacheStats();
+    PwmWriteCacheStats counted = {1, 1};
+    PwmGetWriteCacheStats(&counted);
+    LONGS_EQUAL(0, counted.hits);
+    LONGS_EQUAL(0, counted.misses);
+}
@@ -0,0 +1,198 @@
+/// @brief  Compile time layout of the QF event pools for a set of event
+///         types. The block size of each event is its size rounded up to
+///         the pool granule, and one pool is laid out per distinct block
+///         size, in the increasing order QF requires. So every event is
+///         allocated from a block less than one granule larger than the
+///         event, with the fewest pools that allows.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#ifndef EVENT_POOL_LAYOUT_HPP
+#define EVENT_POOL_LAYOUT_HPP
+
+#include "qpc.h"
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <type_traits>
+#include <vector>
+
+/// The granule of the QF event pool block sizes. QF rounds each block
+/// up to the size of its free block link (up to two pointers, unless QP
+/// is built with Q_UNSAFE), so the layout's block sizes are multiples
+/// of it. Otherwise two pools could round to the same block size,
+/// which QF_poolInit() rejects.
+#ifndef EVENT_POOL_GRANULE
+#define EVENT_POOL_GRANULE (2U * sizeof(void*))
+#endif
+
+namespace cms {
+
+namespace detail {
+
+constexpr size_t RoundUp(size_t size, size_t granule)
+{
+    return ((size + granule - 1U) / granule) * granule;
+}
+
+template <size_t N>
+struct BlockSizes
+{
+    size_t value[N];
+    size_t count;
+};
+
+// the distinct sizes, in increasing order
+template <size_t N>
+constexpr BlockSizes<N> DistinctSorted(BlockSizes<N> sizes)
+{
+    BlockSizes<N> result{};
+    for (size_t i = 0; i < sizes.count; ++i) {
+        size_t at = 0;
+        while ((at < result.count) && (result.value[at] < sizes.value[i])) {
+            ++at;
+        }
+        if ((at < result.count) && (result.value[at] == sizes.value[i])) {
+            continue;
+        }
+        for (size_t j = result.count; j > at; --j) {
+            result.value[j] = result.value[j - 1U];
+        }
+        result.value[at] = sizes.value[i];
+        ++result.count;
+    }
+    return result;
+}
+
+// the block sizes of the events' pools
+template <typename... Events>
+constexpr BlockSizes<sizeof...(Events)> LayoutOf()
+{
+    return DistinctSorted(BlockSizes<sizeof...(Events)>{
+      {RoundUp(sizeof(Events), EVENT_POOL_GRANULE)...}, sizeof...(Events)});
+}
+
+// like QF, the first pool with blocks large enough
+template <size_t N>
+constexpr size_t PoolFor(BlockSizes<N> layout, size_t size)
+{
+    size_t pool = 0;
+    while ((pool < layout.count) && (layout.value[pool] < size)) {
+        ++pool;
+    }
+    return pool;
+}
+
+template <size_t N>
+constexpr size_t BlockFor(BlockSizes<N> layout, size_t size)
+{
+    return layout.value[PoolFor(layout, size)];
+}
+
+constexpr bool AllOf(std::initializer_list<bool> conditions)
+{
+    for (bool condition : conditions) {
+        if (!condition) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace detail
+
+template <typename... Events>
+class EventPoolLayout
+{
+public:
+    static constexpr size_t GRANULE = EVENT_POOL_GRANULE;
+
+    /// The number of pools, initialize exactly this many.
+    static constexpr size_t poolCount() { return detail::LayoutOf<Events...>().count; }
+
+    /// The block size of pool [0 .. poolCount()-1], increasing.
+    static constexpr size_t blockSize(size_t pool) { return detail::LayoutOf<Events...>().value[pool]; }
+
+    /// The pool an event of type E is allocated from: like QF, the
+    /// first pool with blocks large enough.
+    template <typename E>
+    static constexpr size_t poolOf() { return detail::PoolFor(detail::LayoutOf<Events...>(), sizeof(E)); }
+
+    /// The bytes of the block unused by an event of type E.
+    template <typename E>
+    static constexpr size_t wasteOf() { return blockSize(poolOf<E>()) - sizeof(E); }
+
+    /// The storage for eventsPerPool events in every pool.
+    static constexpr size_t storageSize(size_t eventsPerPool)
+    {
+        size_t bytes = 0;
+        for (size_t pool = 0; pool < poolCount(); ++pool) {
+            bytes += blockSize(pool) * eventsPerPool;
+        }
+        return bytes;
+    }
+
+    /// The block sizes, e.g. for a test's pool configuration.
+    static std::vector<size_t> blockSizes()
+    {
+        std::vector<size_t> sizes;
+        for (size_t pool = 0; pool < poolCount(); ++pool) {
+            sizes.push_back(blockSize(pool));
+        }
+        return sizes;
+    }
+
+private:
+    static_assert(sizeof...(Events) > 0U, "an event pool layout needs at least one event type");
+    static_assert((GRANULE % alignof(void*)) == 0U, "the granule must keep blocks pointer aligned");
+    static_assert(detail::AllOf({std::is_standard_layout<Events>::value...}),
+                  "events must be C style structs, QF casts them to QEvt");
+    static_assert(detail::AllOf({(sizeof(Events) >= sizeof(QEvt))...}),
+                  "every event must begin with (inherit) QEvt");
+    static_assert(detail::AllOf({(alignof(Events) <= alignof(void*))...}),
+                  "pool blocks are only pointer aligned");
+    static_assert(detail::AllOf({(detail::BlockFor(detail::LayoutOf<Events...>(), sizeof(Events)) -
+                                  sizeof(Events) < GRANULE)...}),
+                  "every event must be allocated from a block less than a granule larger");
+    static_assert(detail::LayoutOf<Events...>().value[detail::LayoutOf<Events...>().count - 1U] <= 0xFFFFU,
+                  "QF event sizes are 16 bit");
+#ifdef QF_MAX_EPOOL
+    static_assert(detail::LayoutOf<Events...>().count <= QF_MAX_EPOOL, "more pools than QF_MAX_EPOOL");
+#endif
+};
+
+/// Storage for, and initialization of, the pools of a layout.
+template <typename Layout, size_t EVENTS_PER_POOL>
+class EventPoolStorage
+{
+public:
+    /// Initialize every pool of the layout with QF_poolInit(),
+    /// after QF_init(), and before any other pool.
+    void init()
+    {
+        size_t offset = 0;
+        for (size_t pool = 0; pool < Layout::poolCount(); ++pool) {
+            const size_t bytes = Layout::blockSize(pool) * EVENTS_PER_POOL;
+            QF_poolInit(&mStorage[offset], static_cast<uint_fast32_t>(bytes),
+                        static_cast<uint_fast16_t>(Layout::blockSize(pool)));
+            offset += bytes;
+        }
+    }
+
+private:
+    alignas(void*) uint8_t mStorage[Layout::storageSize(EVENTS_PER_POOL)];
+};
+
+} // namespace cms
+
+#endif // EVENT_POOL_LAYOUT_HPP
@@ -13,15 +13,22 @@
 extern "C" {
 #endif
 
-/// The publish/subscribe signals allocated for this project
+/// The publish/subscribe signals allocated for this project, as an
+/// X-macro list, so that tables indexed by signal (e.g. dispatch or
+/// signal name tables) are generated from this single list.
+#define PUB_SUB_SIGNALS(X)   \
+    X(PWM_REQUEST_ON_SIG)    \
+    X(PWM_REQUEST_OFF_SIG)   \
+    X(PWM_REQUEST_RAMP_SIG)  \
+    X(PWM_IS_OFF_SIG)        \
+    X(PWM_IS_ON_SIG)
+
+#define PUB_SUB_SIGNAL_ENUM(sig_) sig_,
+
 enum PubSubSignals {
     STARTING_PUB_SUB_SIG = Q_USER_SIG,
 
-    PWM_REQUEST_ON_SIG,
-    PWM_REQUEST_OFF_SIG,
-
-    PWM_IS_OFF_SIG,
-    PWM_IS_ON_SIG,
+    PUB_SUB_SIGNALS(PUB_SUB_SIGNAL_ENUM)
 
     // The last published signal enum value. Note:
     // active objects should start their internal
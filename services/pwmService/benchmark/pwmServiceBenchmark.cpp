@@ -0,0 +1,325 @@
+/// @brief  Dispatch micro-benchmark of the PwmService, executed on the
+///         host with the cpputest-for-qpc environment and a no-op PWM
+///         driver. Measures the cost of each request through the
+///         service's event queue, the amortized cost of its refresh
+///         while on, and the publish fan-out cost as the
+///         number of status subscribers grows. Results are printed as
+///         JSON, and the test fails (failing the build) if any result
+///         exceeds its configured regression threshold. Built once per
+///         state dispatch form (switch, and table), for comparison.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#include "qpc.h"
+#include "pwmService.h"
+#include "cms_cpputest_qf_ctrl.hpp"
+#include "bspTicks.h"
+#include "pub_sub_signals.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// the cpputest headers must always be last
+#include "CppUTest/TestHarness.h"
+
+// Regression thresholds, in nanoseconds. Configured by the build,
+// see PWM_SERVICE_BENCH_MAX_NS_* in CMakeLists.txt.
+#ifndef PWM_SERVICE_BENCH_MAX_NS_ON_REQUEST
+#define PWM_SERVICE_BENCH_MAX_NS_ON_REQUEST 20000
+#endif
+#ifndef PWM_SERVICE_BENCH_MAX_NS_OFF_REQUEST
+#define PWM_SERVICE_BENCH_MAX_NS_OFF_REQUEST 20000
+#endif
+#ifndef PWM_SERVICE_BENCH_MAX_NS_REFRESH_AMORTIZED
+#define PWM_SERVICE_BENCH_MAX_NS_REFRESH_AMORTIZED 20000
+#endif
+#ifndef PWM_SERVICE_BENCH_MAX_NS_FACTORY_TEST
+#define PWM_SERVICE_BENCH_MAX_NS_FACTORY_TEST 20000
+#endif
+#ifndef PWM_SERVICE_BENCH_MAX_NS_PER_SUBSCRIBER
+#define PWM_SERVICE_BENCH_MAX_NS_PER_SUBSCRIBER 5000
+#endif
+#ifndef PWM_SERVICE_BENCH_MAX_NS_UNHANDLED
+#define PWM_SERVICE_BENCH_MAX_NS_UNHANDLED 5000
+#endif
+
+// The service's state dispatch form, see PWM_SERVICE_TABLE_DISPATCH.
+#ifdef PWM_SERVICE_TABLE_DISPATCH
+static constexpr const char* DISPATCH_FORM = "table";
+#else
+static constexpr const char* DISPATCH_FORM = "switch";
+#endif
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+static constexpr int ITERATIONS  = 2000;
+static constexpr int REPETITIONS = 5;
+
+namespace {
+
+// A minimal active object which consumes, and ignores, every event.
+// Used to measure publish fan-out.
+struct Subscriber
+{
+    QActive super;
+    std::array<const QEvt*, 4> queueStorage;
+
+    static QState initial(Subscriber* const me, void const* const par)
+    {
+        Q_UNUSED_PAR(par);
+        QActive_subscribe(&me->super, PWM_IS_ON_SIG);
+        QActive_subscribe(&me->super, PWM_IS_OFF_SIG);
+        return Q_TRAN(&active);
+    }
+
+    static QState active(Subscriber* const me, QEvt const* const e)
+    {
+        if ((e->sig == Q_ENTRY_SIG) || (e->sig == Q_EXIT_SIG) || (e->sig >= Q_USER_SIG)) {
+            return Q_HANDLED();
+        }
+        return Q_SUPER(&QHsm_top);
+    }
+};
+
+struct Result
+{
+    std::string name;
+    double nsPerEvent;
+    double thresholdNs;
+};
+
+double NsPerIteration(Clock::duration elapsed)
+{
+    return std::chrono::duration<double, std::nano>(elapsed).count() / ITERATIONS;
+}
+
+} // namespace
+
+TEST_GROUP(PwmServiceBenchmark)
+{
+    std::array<const QEvt*, 10> underTestEventQueueStorage;
+    std::vector<Subscriber> mSubscribers;
+    std::vector<Result> mResults;
+
+    void startEnvironment(size_t subscriberCount)
+    {
+        using namespace cms::test;
+
+        qf_ctrl::Setup(MAX_PUB_SUB_SIG, BSP_TICKS_PER_SECOND);
+
+        PwmService_ctor();
+        underTestEventQueueStorage.fill(nullptr);
+        QACTIVE_START(g_thePwmService, qf_ctrl::UNIT_UNDER_TEST_PRIORITY,
+                      underTestEventQueueStorage.data(), underTestEventQueueStorage.size(),
+                      nullptr, 0, nullptr);
+
+        mSubscribers.clear();
+        mSubscribers.resize(subscriberCount);
+        uint_fast8_t prio = qf_ctrl::RECORDER_PRIORITY + 1;
+        for (auto& subscriber : mSubscribers) {
+            subscriber.queueStorage.fill(nullptr);
+            QActive_ctor(&subscriber.super, Q_STATE_CAST(&Subscriber::initial));
+            QACTIVE_START(&subscriber.super, prio++,
+                          subscriber.queueStorage.data(), subscriber.queueStorage.size(),
+                          nullptr, 0, nullptr);
+        }
+
+        qf_ctrl::ProcessEvents();
+    }
+
+    void stopEnvironment()
+    {
+        PwmService_dtor();
+        cms::test::qf_ctrl::Teardown();
+        mSubscribers.clear();
+    }
+
+    static void publishOn()
+    {
+        auto e = Q_NEW(PwmServiceOnRequestEvent, PWM_REQUEST_ON_SIG);
+        e->channel = 0;
+        e->percent = static_cast<PwmServiceDuty>(1);
+        QF_PUBLISH(&e->super, nullptr);
+        cms::test::qf_ctrl::ProcessEvents();
+    }
+
+    static void publishOff()
+    {
+        auto e = Q_NEW(PwmServiceOffRequestEvent, PWM_REQUEST_OFF_SIG);
+        e->channel = 0;
+        QF_PUBLISH(&e->super, nullptr);
+        cms::test::qf_ctrl::ProcessEvents();
+    }
+
+    // on and off requests, each measured separately, best of the repetitions
+    void measureOnOff(const std::string& suffix, double onThreshold, double offThreshold)
+    {
+        double bestOn  = 1e300;
+        double bestOff = 1e300;
+        for (int rep = 0; rep < REPETITIONS; ++rep) {
+            Clock::duration onTime{};
+            Clock::duration offTime{};
+            for (int i = 0; i < ITERATIONS; ++i) {
+                auto t0 = Clock::now();
+                publishOn();
+                auto t1 = Clock::now();
+                publishOff();
+                auto t2 = Clock::now();
+                onTime += t1 - t0;
+                offTime += t2 - t1;
+            }
+            bestOn  = std::min(bestOn, NsPerIteration(onTime));
+            bestOff = std::min(bestOff, NsPerIteration(offTime));
+        }
+        mResults.push_back(Result{"on_request" + suffix, bestOn, onThreshold});
+        mResults.push_back(Result{"off_request" + suffix, bestOff, offThreshold});
+    }
+
+    // A refresh is timer driven, and its verify interval backs off, so this
+    // is not the cost of one refresh: it is the refresh cost amortized over
+    // a 250 ms period of ticks while on, less the same ticks while off.
+    void measureRefreshAmortized()
+    {
+        using namespace cms::test;
+        constexpr auto REFRESH_PERIOD = 250ms;
+        constexpr int REFRESH_ITERATIONS = ITERATIONS / 10;
+
+        double bestOff = 1e300;
+        double bestOn  = 1e300;
+        for (int rep = 0; rep < REPETITIONS; ++rep) {
+            auto t0 = Clock::now();
+            for (int i = 0; i < REFRESH_ITERATIONS; ++i) {
+                qf_ctrl::MoveTimeForward(REFRESH_PERIOD);
+            }
+            auto t1 = Clock::now();
+            bestOff = std::min(bestOff, std::chrono::duration<double, std::nano>(t1 - t0).count());
+        }
+
+        // let the verify interval back off to its steady state, so the
+        // result is the amortized cost of refresh per 250 ms while on.
+        publishOn();
+        qf_ctrl::MoveTimeForward(10s);
+        for (int rep = 0; rep < REPETITIONS; ++rep) {
+            auto t0 = Clock::now();
+            for (int i = 0; i < REFRESH_ITERATIONS; ++i) {
+                qf_ctrl::MoveTimeForward(REFRESH_PERIOD);
+            }
+            auto t1 = Clock::now();
+            bestOn = std::min(bestOn, std::chrono::duration<double, std::nano>(t1 - t0).count());
+        }
+        publishOff();
+
+        double refreshNs = std::max(0.0, (bestOn - bestOff) / REFRESH_ITERATIONS);
+        mResults.push_back(Result{"refresh_amortized_per_250ms", refreshNs,
+                                  PWM_SERVICE_BENCH_MAX_NS_REFRESH_AMORTIZED});
+    }
+
+    // An event the service does not handle, so the result is dominated
+    // by the on state's signal dispatch before it defers to the top state.
+    void measureUnhandled()
+    {
+        static const QEvt unhandled = QEVT_INITIALIZER(PWM_IS_OFF_SIG);
+
+        publishOn();
+        double best = 1e300;
+        for (int rep = 0; rep < REPETITIONS; ++rep) {
+            Clock::duration elapsed{};
+            for (int i = 0; i < ITERATIONS; ++i) {
+                auto t0 = Clock::now();
+                QACTIVE_POST(g_thePwmService, &unhandled, nullptr);
+                cms::test::qf_ctrl::ProcessEvents();
+                elapsed += Clock::now() - t0;
+            }
+            best = std::min(best, NsPerIteration(elapsed));
+        }
+        publishOff();
+        mResults.push_back(Result{"unhandled_signal", best, PWM_SERVICE_BENCH_MAX_NS_UNHANDLED});
+    }
+
+    void measureFactoryTest()
+    {
+        static PwmServiceFactoryTestResponseEvent response;
+        static Subscriber requester;
+
+        requester.queueStorage.fill(nullptr);
+        QActive_ctor(&requester.super, Q_STATE_CAST(&Subscriber::initial));
+        QACTIVE_START(&requester.super, cms::test::qf_ctrl::RECORDER_PRIORITY + 1,
+                      requester.queueStorage.data(), requester.queueStorage.size(),
+                      nullptr, 0, nullptr);
+        cms::test::qf_ctrl::ProcessEvents();
+
+        double best = 1e300;
+        for (int rep = 0; rep < REPETITIONS; ++rep) {
+            Clock::duration elapsed{};
+            for (int i = 0; i < ITERATIONS; ++i) {
+                auto t0 = Clock::now();
+                auto e = Q_NEW(PwmServiceFactoryTestRequestEvent, PWM_REQUEST_FACTORY_TEST_SIG);
+                e->requester = &requester.super;
+                e->response_sig = MAX_PUB_SUB_SIG + 1000;
+                e->response = &response;
+                e->progress_sig = 0;
+                QACTIVE_POST(g_thePwmService, &e->super, nullptr);
+                cms::test::qf_ctrl::ProcessEvents();
+                elapsed += Clock::now() - t0;
+            }
+            best = std::min(best, NsPerIteration(elapsed));
+        }
+        mResults.push_back(Result{"factory_test", best, PWM_SERVICE_BENCH_MAX_NS_FACTORY_TEST});
+    }
+
+    void printAndCheck()
+    {
+        printf("\n{\"pwm_service_benchmark\":[\n");
+        for (size_t i = 0; i < mResults.size(); ++i) {
+            const auto& r = mResults[i];
+            printf("%s{\"name\":\"%s\",\"ns_per_event\":%.1f,\"threshold_ns\":%.1f,\"pass\":%s}",
+                   (i == 0) ? "" : ",\n", r.name.c_str(), r.nsPerEvent, r.thresholdNs,
+                   (r.nsPerEvent <= r.thresholdNs) ? "true" : "false");
+        }
+        printf("],\n\"dispatch\":\"%s\"}\n", DISPATCH_FORM);
+
+        for (const auto& r : mResults) {
+            CHECK_TRUE(r.nsPerEvent <= r.thresholdNs);
+        }
+    }
+};
+
+TEST(PwmServiceBenchmark, dispatch_cost_per_signal_and_publish_fan_out)
+{
+    startEnvironment(0);
+    measureOnOff("", PWM_SERVICE_BENCH_MAX_NS_ON_REQUEST, PWM_SERVICE_BENCH_MAX_NS_OFF_REQUEST);
+    measureRefreshAmortized();
+    measureUnhandled();
+    measureFactoryTest();
+    stopEnvironment();
+
+    // publish fan-out, status events are published to each subscriber.
+    // Subscribers use the priorities between the recorder and the service.
+    const size_t maxSubscribers = cms::test::qf_ctrl::UNIT_UNDER_TEST_PRIORITY -
+                                  cms::test::qf_ctrl::RECORDER_PRIORITY - 1;
+    for (size_t count = 1; count <= maxSubscribers; count *= 2) {
+        startEnvironment(count);
+        const double threshold = PWM_SERVICE_BENCH_MAX_NS_ON_REQUEST +
+                                 static_cast<double>(count) * PWM_SERVICE_BENCH_MAX_NS_PER_SUBSCRIBER;
+        measureOnOff("_subscribers_" + std::to_string(count), threshold,
+                     PWM_SERVICE_BENCH_MAX_NS_OFF_REQUEST +
+                     static_cast<double>(count) * PWM_SERVICE_BENCH_MAX_NS_PER_SUBSCRIBER);
+        stopEnvironment();
+    }
+
+    printAndCheck();
+}
@@ -0,0 +1,79 @@
+/// @brief  Footprint image of the PwmService: the service, the PWM driver
+///         and the RAM an application dedicates to them (the service's
+///         queue, the subscriber lists and the event pools), linked with
+///         QP/C into a minimal application. The image is never executed,
+///         its link map is the input of the footprint report (see
+///         cmsFootprintReport.cpp), so every object lives at file scope,
+///         where the map names it.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#include "qpc.h"
+#include "pwmService.h"
+#include "pwmServicePools.hpp"
+#include "bspTicks.h"
+#include "pub_sub_signals.h"
+#include <cstdlib>
+
+// Configured by the build, see PWM_SERVICE_FOOTPRINT_* in CMakeLists.txt.
+#ifndef PWM_SERVICE_FOOTPRINT_QUEUE_LENGTH
+#define PWM_SERVICE_FOOTPRINT_QUEUE_LENGTH 10
+#endif
+#ifndef PWM_SERVICE_FOOTPRINT_EVENTS_PER_POOL
+#define PWM_SERVICE_FOOTPRINT_EVENTS_PER_POOL 20
+#endif
+
+static constexpr uint_fast8_t SERVICE_PRIORITY = 1U;
+
+static QSubscrList l_subscrSto[MAX_PUB_SUB_SIG];
+static QEvt const* l_serviceQueueSto[PWM_SERVICE_FOOTPRINT_QUEUE_LENGTH];
+static cms::EventPoolStorage<PwmServiceEventPools, PWM_SERVICE_FOOTPRINT_EVENTS_PER_POOL> l_poolSto;
+
+int main()
+{
+    QF_init();
+    QActive_psInit(l_subscrSto, Q_DIM(l_subscrSto));
+    l_poolSto.init();
+
+    PwmService_ctor();
+    QACTIVE_START(g_thePwmService, SERVICE_PRIORITY,
+                  l_serviceQueueSto, Q_DIM(l_serviceQueueSto),
+                  nullptr, 0, nullptr);
+
+    return QF_run();
+}
+
+extern "C" {
+
+void QF_onStartup(void)
+{
+    QF_setTickRate(BSP_TICKS_PER_SECOND, 30);
+}
+
+void QF_onCleanup(void)
+{
+}
+
+void QF_onClockTick(void)
+{
+    QTIMEEVT_TICK_X(0U, nullptr);
+}
+
+void Q_onError(char const* const module, int_t const id)
+{
+    Q_UNUSED_PAR(module);
+    Q_UNUSED_PAR(id);
+    abort();
+}
+
+} // extern "C"
@@ -0,0 +1,324 @@
+/// @brief  Fuzz target of the PwmService, executed on the host with the
+///         cpputest-for-qpc environment and the recording fake of the PWM
+///         driver. Each input is a sequence of operations (requests,
+///         coalesced requests, factory tests, drift and the passing of
+///         time) decoded from arbitrary bytes. Between inputs the service
+///         is reset in place (PwmService_reset()), instead of a full
+///         qf_ctrl::Teardown()/Setup() and a new service, so that many
+///         thousands of inputs are executed per second. An assertion
+///         fails the run, and the input is kept in PwmServiceFuzz.crash.
+///         Inputs are generated by a seeded random loop, or one input is
+///         replayed from the file named by PWM_SERVICE_FUZZ_INPUT.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#include "qpc.h"
+#include "pwmService.h"
+#include "pwm.h"
+#include "cms_cpputest_qf_ctrl.hpp"
+#include "bspTicks.h"
+#include "pub_sub_signals.h"
+#include "pwmRecordingFake.hpp"
+#include "pwmServicePools.hpp"
+#include "cmsPwmServiceHarness.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+// the cpputest headers must always be last
+#include "CppUTest/TestHarness.h"
+
+// Configured by the build, see PWM_SERVICE_FUZZ_* in CMakeLists.txt.
+#ifndef PWM_SERVICE_FUZZ_ITERATIONS
+#define PWM_SERVICE_FUZZ_ITERATIONS 1000
+#endif
+#ifndef PWM_SERVICE_FUZZ_SEED
+#define PWM_SERVICE_FUZZ_SEED 1
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr size_t MAX_INPUT_LENGTH = 64;
+static const char* const CRASH_FILE = "PwmServiceFuzz.crash";
+
+namespace {
+
+// An input is read one operation at a time. Operands past
+// the end of the input read as zero.
+class InputReader
+{
+public:
+    InputReader(const uint8_t* data, size_t size) : mData(data), mSize(size) {}
+
+    bool done() const { return mPos >= mSize; }
+    uint8_t next() { return (mPos < mSize) ? mData[mPos++] : 0U; }
+    uint8_t channel() { return next() % PWM_SERVICE_CHANNEL_COUNT; }
+    uint8_t profile() { return next() % PWM_SERVICE_RAMP_PROFILE_COUNT; }
+
+    PwmServiceDuty duty()
+    {
+        const float percent = static_cast<float>(next()) / 255.0f;
+#ifdef PWM_SERVICE_FIXED_POINT_DUTY
+        return PwmPercentToDuty(percent);
+#else
+        return percent;
+#endif
+    }
+
+private:
+    const uint8_t* mData;
+    size_t mSize;
+    size_t mPos = 0;
+};
+
+enum Operation : uint8_t {
+    OP_PUBLISH_ON,
+    OP_PUBLISH_OFF,
+    OP_PUBLISH_RAMP,
+    OP_REQUEST_ON,
+    OP_REQUEST_OFF,
+    OP_REQUEST_RAMP,
+    OP_FACTORY_TEST,
+    OP_DRIFT,
+    OP_TIME,
+    OP_COUNT
+};
+
+} // namespace
+
+TEST_GROUP(PwmServiceFuzz)
+{
+    std::array<const QEvt*, 10> underTestEventQueueStorage;
+    cms::test::FactoryTestClient mClient;
+    std::vector<size_t> mPoolCapacity;
+
+    // the requester's view of each channel
+    std::array<bool, PWM_SERVICE_CHANNEL_COUNT> mOn;
+    uint64_t mFactoryTests = 0;
+
+    // the input being executed, kept when it fails
+    std::vector<uint8_t> mInput;
+
+    void setup() final
+    {
+        using namespace cms::test;
+
+        qf_ctrl::Setup(MAX_PUB_SUB_SIG, BSP_TICKS_PER_SECOND, PwmServiceTestPools());
+        PwmRecordingFake::Instance().reset();
+
+        mClient.start(qf_ctrl::RECORDER_PRIORITY + 1, false);
+
+        PwmService_ctor();
+        underTestEventQueueStorage.fill(nullptr);
+        QACTIVE_START(g_thePwmService, qf_ctrl::UNIT_UNDER_TEST_PRIORITY,
+                      underTestEventQueueStorage.data(), underTestEventQueueStorage.size(),
+                      nullptr, 0, nullptr);
+        qf_ctrl::ProcessEvents();
+
+        mPoolCapacity.clear();
+        for (auto blockSize : PwmServiceEventPools::blockSizes()) {
+            mPoolCapacity.push_back(CountFreeEvents(blockSize));
+        }
+        mOn.fill(false);
+    }
+
+    void teardown() final
+    {
+        if (UtestShell::getCurrent()->hasFailed() && !mInput.empty()) {
+            keepFailedInput();
+        }
+
+        PwmService_dtor();
+
+        // fails the test if any event is still allocated
+        cms::test::qf_ctrl::Teardown();
+    }
+
+    void keepFailedInput() const
+    {
+        std::ofstream crash(CRASH_FILE, std::ios::binary);
+        crash.write(reinterpret_cast<const char*>(mInput.data()),
+                    static_cast<std::streamsize>(mInput.size()));
+
+        printf("\nfailed input (%zu bytes, kept in %s):", mInput.size(), CRASH_FILE);
+        for (auto byte : mInput) {
+            printf(" %02x", byte);
+        }
+        printf("\n");
+    }
+
+    // The cheap alternative to a new environment and service for each
+    // input: QF, its pools and queues and the active objects are kept.
+    void resetInPlace()
+    {
+        using namespace cms::test;
+
+        qf_ctrl::ProcessEvents();
+        PwmService_reset();
+        qf_ctrl::ProcessEvents();
+
+        // every event of the input has been recycled
+        for (size_t pool = 0; pool < PwmServiceEventPools::poolCount(); ++pool) {
+            LONGS_EQUAL(mPoolCapacity[pool], CountFreeEvents(PwmServiceEventPools::blockSize(pool)));
+        }
+
+        PwmRecordingFake::Instance().reset();
+        mClient.resetCounts();
+        mOn.fill(false);
+        mFactoryTests = 0;
+    }
+
+    void publish(QEvt* e)
+    {
+        QF_PUBLISH(e, nullptr);
+        cms::test::qf_ctrl::ProcessEvents();
+    }
+
+    void execute(const std::vector<uint8_t>& input)
+    {
+        using namespace cms::test;
+
+        mInput = input;
+        InputReader in(input.data(), input.size());
+        while (!in.done()) {
+            switch (in.next() % OP_COUNT) {
+                case OP_PUBLISH_ON: {
+                    const uint8_t channel = in.channel();
+                    auto e = PwmService_newOnRequest(QF_NO_MARGIN, channel, in.duty());
+                    mOn[e->channel] = true;
+                    publish(&e->super);
+                    break;
+                }
+                case OP_PUBLISH_OFF: {
+                    auto e = PwmService_newOffRequest(QF_NO_MARGIN, in.channel());
+                    mOn[e->channel] = false;
+                    publish(&e->super);
+                    break;
+                }
+                case OP_PUBLISH_RAMP: {
+                    const uint8_t channel = in.channel();
+                    const PwmServiceDuty percent = in.duty();
+                    auto e = PwmService_newRampRequest(QF_NO_MARGIN, channel, percent, in.profile());
+                    mOn[e->channel] = true;
+                    publish(&e->super);
+                    break;
+                }
+                // coalesced requests are left to be applied by a later operation
+                case OP_REQUEST_ON: {
+                    const uint8_t channel = in.channel();
+                    PwmService_requestOn(channel, in.duty());
+                    mOn[channel] = true;
+                    break;
+                }
+                case OP_REQUEST_OFF: {
+                    const uint8_t channel = in.channel();
+                    PwmService_requestOff(channel);
+                    mOn[channel] = false;
+                    break;
+                }
+                case OP_REQUEST_RAMP: {
+                    const uint8_t channel = in.channel();
+                    const PwmServiceDuty percent = in.duty();
+                    PwmService_requestRamp(channel, percent, in.profile());
+                    mOn[channel] = true;
+                    break;
+                }
+                // a well behaved requester only asks for the factory test
+                // once it has requested every channel off. An assertion
+                // here is a finding, not the documented on-state assertion.
+                case OP_FACTORY_TEST: {
+                    if (std::any_of(mOn.begin(), mOn.end(), [](bool on) { return on; })) {
+                        break;
+                    }
+                    auto e = mClient.newRequest((in.next() & 1U) != 0U);
+                    QACTIVE_POST(g_thePwmService, &e->super, nullptr);
+                    qf_ctrl::ProcessEvents();
+                    ++mFactoryTests;
+                    break;
+                }
+                case OP_DRIFT: {
+                    auto& fake = PwmRecordingFake::Instance();
+                    const uint8_t channel = in.channel();
+                    bool enabled = false;
+                    uint16_t duty = 0;
+                    CHECK_TRUE(fake.readback(channel, &enabled, &duty));
+                    fake.injectDrift(channel, enabled, duty ^ (1U + in.next()));
+                    break;
+                }
+                case OP_TIME:
+                    qf_ctrl::MoveTimeForward(std::chrono::milliseconds(10 * (1 + in.next() % 32)));
+                    break;
+                default:
+                    break;
+            }
+        }
+        qf_ctrl::ProcessEvents();
+
+        // every factory test was answered
+        LONGS_EQUAL(mFactoryTests, mClient.factoryResponses);
+        CHECK_TRUE(mClient.factoryProgress <= mFactoryTests * PWM_FACTORY_TEST_STEPS);
+
+        resetInPlace();
+    }
+};
+
+TEST(PwmServiceFuzz, arbitrary_operation_sequences_do_not_assert_or_leak)
+{
+    // replay a single input, e.g. a kept PwmServiceFuzz.crash
+    const char* const replay = std::getenv("PWM_SERVICE_FUZZ_INPUT");
+    if (replay != nullptr) {
+        std::ifstream file(replay, std::ios::binary);
+        CHECK_TRUE(file.good());
+        execute(std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                                     std::istreambuf_iterator<char>()));
+        mInput.clear();
+        return;
+    }
+
+    // the build's count, unless a long run (PwmServiceFuzzLong) gives one
+    unsigned long iterations = PWM_SERVICE_FUZZ_ITERATIONS;
+    const char* const count = std::getenv("PWM_SERVICE_FUZZ_ITERATIONS");
+    if (count != nullptr) {
+        iterations = std::strtoul(count, nullptr, 0);
+    }
+
+    std::mt19937 random{PWM_SERVICE_FUZZ_SEED};
+    std::uniform_int_distribution<size_t> lengths(1, MAX_INPUT_LENGTH);
+    std::uniform_int_distribution<int> bytes(0, 255);
+    std::vector<uint8_t> input;
+    uint64_t operationBytes = 0;
+
+    const auto wallStart = Clock::now();
+    for (unsigned long iteration = 0; iteration < iterations; ++iteration) {
+        input.resize(lengths(random));
+        for (auto& byte : input) {
+            byte = static_cast<uint8_t>(bytes(random));
+        }
+        operationBytes += input.size();
+        execute(input);
+    }
+    mInput.clear();
+    const double wallSeconds = std::chrono::duration<double>(Clock::now() - wallStart).count();
+
+    printf("\n{\"pwm_service_fuzz\":{\"seed\":%u,\"inputs\":%lu,\"input_bytes\":%llu,"
+           "\"wall_s\":%.3f,\"execs_per_s\":%.0f}}\n",
+           static_cast<unsigned>(PWM_SERVICE_FUZZ_SEED),
+           iterations, static_cast<unsigned long long>(operationBytes), wallSeconds,
+           static_cast<double>(iterations) / wallSeconds);
+}
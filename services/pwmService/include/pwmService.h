@@ -24,19 +24,101 @@
 extern "C" {
 #endif
 
+/**
+ * The number of PWM channels managed by the single PwmService
+ * instance. May be overridden by the build, must not exceed
+ * the driver's PWM_MAX_CHANNELS.
+ */
+#ifndef PWM_SERVICE_CHANNEL_COUNT
+#define PWM_SERVICE_CHANNEL_COUNT 1
+#endif
+
+/**
+ * Channel value used in a PwmServiceStatusEvent to indicate
+ * that the status applies to every channel.
+ */
+#define PWM_SERVICE_ALL_CHANNELS 0xFFU
+
+/**
+ * Full scale (100%) duty cycle when the service is built
+ * with PWM_SERVICE_FIXED_POINT_DUTY. Matches the driver's
+ * PWM_DUTY_FULL_SCALE.
+ */
+#define PWM_SERVICE_DUTY_FULL_SCALE 0xFFFFU
+
+/**
+ * The duty cycle type used by the service's events and API.
+ * Building with PWM_SERVICE_FIXED_POINT_DUTY selects an integer
+ * duty cycle, [0 .. PWM_SERVICE_DUTY_FULL_SCALE], passed to the
+ * driver's PwmOnDuty(), so that no floating point math is
+ * performed by the service. Otherwise a float [0.0 .. 1.0] is
+ * passed to the driver's PwmOn().
+ */
+#ifdef PWM_SERVICE_FIXED_POINT_DUTY
+typedef uint16_t PwmServiceDuty;
+#else
+typedef float PwmServiceDuty;
+#endif
+
 typedef struct {
     QEvt super; //inherit QEvt, QP/C Framework OOP C style
 
-    float percent;
+    uint8_t channel; // [0 .. PWM_SERVICE_CHANNEL_COUNT-1]
+    PwmServiceDuty percent;
+#ifdef PWM_SERVICE_LATENCY_TRACE
+    uint32_t timestamp; // see PwmService_newOnRequest()
+#endif
 } PwmServiceOnRequestEvent;
 
+typedef struct {
+    QEvt super; //inherit QEvt, QP/C Framework OOP C style
+
+    uint8_t channel; // [0 .. PWM_SERVICE_CHANNEL_COUNT-1]
+#ifdef PWM_SERVICE_LATENCY_TRACE
+    uint32_t timestamp; // see PwmService_newOnRequest()
+#endif
+} PwmServiceOffRequestEvent;
+
+/**
+ * Ramp (soft start) profiles of PWM_REQUEST_RAMP_SIG. The profiles
+ * are lookup tables generated at build time (see rampgen), so a ramp
+ * step is a table lookup, without floating point math.
+ */
+enum PwmServiceRampProfile {
+    PWM_SERVICE_RAMP_LINEAR,
+    PWM_SERVICE_RAMP_S_CURVE, // smoothstep, gentle at both ends
+    PWM_SERVICE_RAMP_GAMMA,   // perceptually linear brightness (LEDs)
+    PWM_SERVICE_RAMP_PROFILE_COUNT
+};
 
+/**
+ * Published with PWM_REQUEST_RAMP_SIG. Turns the channel on and ramps
+ * from its present duty cycle (zero when off) to percent, advancing
+ * one table step per PWM_SERVICE_RAMP_TICKS. PWM_IS_ON_SIG is
+ * published when the ramp reaches percent. An on or off request for
+ * the channel cancels the ramp.
+ */
 typedef struct {
     QEvt super; //inherit QEvt, QP/C Framework OOP C style
 
-    QActive* requester;
-    QSignal  response_sig;
-} PwmServiceFactoryTestRequestEvent;
+    uint8_t channel; // [0 .. PWM_SERVICE_CHANNEL_COUNT-1]
+    PwmServiceDuty percent; // target
+    uint8_t profile; // enum PwmServiceRampProfile
+#ifdef PWM_SERVICE_LATENCY_TRACE
+    uint32_t timestamp; // see PwmService_newOnRequest()
+#endif
+} PwmServiceRampRequestEvent;
+
+/**
+ * Published by the service with PWM_IS_ON_SIG or PWM_IS_OFF_SIG.
+ * These are static (immutable) events owned by the service.
+ */
+typedef struct {
+    QEvt super; //inherit QEvt, QP/C Framework OOP C style
+
+    uint8_t channel; // or PWM_SERVICE_ALL_CHANNELS
+} PwmServiceStatusEvent;
+
 
 typedef struct {
     QEvt super; //inherit QEvt, QP/C Framework OOP C style
@@ -45,6 +127,54 @@ typedef struct {
     uint16_t device_id;
 } PwmServiceFactoryTestResponseEvent;
 
+/**
+ * Posted to the requester after each step of the factory test,
+ * when the request's progress_sig is not zero.
+ */
+typedef struct {
+    QEvt super; //inherit QEvt, QP/C Framework OOP C style
+
+    uint8_t steps_done;
+    uint8_t steps_total;
+} PwmServiceFactoryTestProgressEvent;
+
+typedef struct {
+    QEvt super; //inherit QEvt, QP/C Framework OOP C style
+
+    QActive* requester;
+    QSignal  response_sig;
+
+    /**
+     * Optional requester owned storage for the response.
+     * When NULL, the response is allocated from an event pool.
+     * Otherwise the service initializes and posts this (static)
+     * event, and no event pool is needed for the response.
+     * The storage must not be reused until the requester has
+     * processed the response.
+     */
+    PwmServiceFactoryTestResponseEvent* response;
+
+    /**
+     * Optional signal of PwmServiceFactoryTestProgressEvent(s) posted
+     * to the requester while the test runs, zero for none. Progress
+     * is not reported when built with PWM_SERVICE_ASYNC_DRIVER, where
+     * the driver reports completion only.
+     */
+    QSignal progress_sig;
+} PwmServiceFactoryTestRequestEvent;
+
+
+/**
+ * The factory test requests the service holds while it cannot act on
+ * them, e.g. while another factory test runs. A request arriving when
+ * this many are already held is answered at once with a failed
+ * response (test_passed false, device_id 0xFFFF), and is counted as a
+ * PWM_SERVICE_DROP_FACTORY_TEST_REQUEST drop when the service is built
+ * with PWM_SERVICE_BACKPRESSURE. May be overridden by the build.
+ */
+#ifndef PWM_SERVICE_DEFERRED_FACTORY_TESTS
+#define PWM_SERVICE_DEFERRED_FACTORY_TESTS 1
+#endif
 
 enum PostedSignals {
     PWM_REQUEST_FACTORY_TEST_SIG = MAX_PUB_SUB_SIG + 1,
@@ -61,6 +191,17 @@ extern QActive * g_thePwmService;
 
 /**
  * Construct the PWM Service.
+ * When built with PWM_SERVICE_REFRESH_SCHEDULER, its refreshes are
+ * scheduled by the shared refresh scheduler: the application calls
+ * RefreshScheduler_init() before, and RefreshScheduler_tick() from
+ * its clock tick (see refreshScheduler.h).
+ * Building with PWM_SERVICE_ASYNC_DRIVER selects the driver's non
+ * blocking PwmOnDutyAsync(), PwmOffAsync() and PwmFactoryTestAsync(),
+ * for drivers behind a slow bus. The service then waits for the
+ * driver's completion without blocking its run to completion step:
+ * status events and factory test responses are sent on completion,
+ * and requests arriving meanwhile are held (and coalesced, newest
+ * request per channel wins) until the driver is idle again.
  */
 void PwmService_ctor();
 
@@ -71,6 +212,258 @@ void PwmService_ctor();
  */
 void PwmService_dtor();
 
+/**
+ * Return the started service to the state it is in just after
+ * being started (all channels off, PWM_IS_OFF_SIG published), in
+ * place. Much cheaper than destroying, constructing and starting
+ * again, e.g. between the inputs of a fuzzer. Only for a unit
+ * testing environment: the service's event queue must be empty,
+ * and no driver operation may be in progress.
+ */
+void PwmService_reset();
+
+/**
+ * Coalescing alternative to publishing PWM_REQUEST_ON_SIG.
+ * The request is stored in a per channel mailbox and the
+ * service is woken by at most one queued event, no matter
+ * how many requests arrive before it runs. Only the newest
+ * request for each channel (last writer wins) reaches
+ * the driver. Safe to call from any thread or ISR after
+ * the service is started.
+ */
+void PwmService_requestOn(uint8_t channel, PwmServiceDuty percent);
+
+/**
+ * Coalescing alternative to publishing PWM_REQUEST_OFF_SIG.
+ * See PwmService_requestOn().
+ */
+void PwmService_requestOff(uint8_t channel);
+
+/**
+ * Coalescing alternative to publishing PWM_REQUEST_RAMP_SIG.
+ * See PwmService_requestOn().
+ */
+void PwmService_requestRamp(uint8_t channel, PwmServiceDuty percent, uint8_t profile);
+
+/**
+ * Allocate a PWM_REQUEST_ON_SIG event to publish (or post), with its
+ * fields set, and stamped when built with PWM_SERVICE_LATENCY_TRACE.
+ * As Q_NEW_X(), NULL is returned when fewer than margin events would
+ * remain in the pool, and QF_NO_MARGIN asserts instead, as Q_NEW().
+ */
+PwmServiceOnRequestEvent* PwmService_newOnRequest(uint_fast16_t margin, uint8_t channel, PwmServiceDuty percent);
+
+/**
+ * Allocate a PWM_REQUEST_OFF_SIG event. See PwmService_newOnRequest().
+ */
+PwmServiceOffRequestEvent* PwmService_newOffRequest(uint_fast16_t margin, uint8_t channel);
+
+/**
+ * Allocate a PWM_REQUEST_RAMP_SIG event. See PwmService_newOnRequest().
+ */
+PwmServiceRampRequestEvent* PwmService_newRampRequest(uint_fast16_t margin, uint8_t channel,
+                                                      PwmServiceDuty percent, uint8_t profile);
+
+/**
+ * Attempts made by PwmService_getStatusSnapshot() to copy a consistent
+ * snapshot, before giving up. May be overridden by the build.
+ */
+#ifndef PWM_SERVICE_SNAPSHOT_RETRIES
+#define PWM_SERVICE_SNAPSHOT_RETRIES 4
+#endif
+
+/**
+ * A copy of the service's status, an alternative to subscribing to
+ * PWM_IS_ON_SIG and PWM_IS_OFF_SIG for consumers which only poll
+ * occasionally. Updated as each status event is published, so the
+ * snapshot always agrees with the published status.
+ */
+typedef struct {
+    uint32_t change_count; // incremented by each published status
+    bool is_on[PWM_SERVICE_CHANNEL_COUNT];
+    PwmServiceDuty percent[PWM_SERVICE_CHANNEL_COUNT]; // zero when off
+} PwmServiceStatusSnapshot;
+
+/**
+ * Copy the service's status snapshot, without blocking and without
+ * posting an event. Safe to call from any thread or ISR. The snapshot
+ * is versioned (a sequence lock) and a copy which raced with an update
+ * is retried. Returns false, with the copy not valid, if every one of
+ * PWM_SERVICE_SNAPSHOT_RETRIES attempts raced with an update, such as
+ * from an ISR which preempted the service mid update. Poll again later.
+ */
+bool PwmService_getStatusSnapshot(PwmServiceStatusSnapshot* snapshot);
+
+/**
+ * Optional backpressure. By default a full event queue or event pool is
+ * an assertion, as usual in QP. When the service is built with
+ * PWM_SERVICE_BACKPRESSURE, it sheds load instead:
+ *  - requests posted with PwmService_postRequest() are dropped when
+ *    fewer than PWM_SERVICE_POST_MARGIN slots would remain in the
+ *    service's queue. The margin keeps room for the service's own
+ *    internal events. Publishing a request still asserts on a full
+ *    queue, as QF publishes without a margin.
+ *  - factory test responses and progress are dropped when the event
+ *    pool is exhausted, or when fewer than PWM_SERVICE_OUTPUT_MARGIN
+ *    slots would remain in the requester's queue.
+ *  - factory test requests beyond PWM_SERVICE_DEFERRED_FACTORY_TESTS
+ *    held ones are answered with a failed response.
+ * Every drop is counted per kind, and the first drop since the last
+ * PwmService_resetDropStats() marks the service overloaded, and is
+ * reported to the overload observer, if any. The service's status
+ * events (PWM_IS_ON_SIG, PWM_IS_OFF_SIG) are still published, and so
+ * still assert on a full subscriber queue, as QF publishes without a
+ * margin.
+ */
+enum PwmServiceDropKind {
+    PWM_SERVICE_DROP_ON_REQUEST,
+    PWM_SERVICE_DROP_OFF_REQUEST,
+    PWM_SERVICE_DROP_RAMP_REQUEST,
+    PWM_SERVICE_DROP_FACTORY_TEST_REQUEST,
+    PWM_SERVICE_DROP_FACTORY_TEST_RESPONSE,
+    PWM_SERVICE_DROP_FACTORY_TEST_PROGRESS,
+    PWM_SERVICE_DROP_KIND_COUNT
+};
+
+#ifdef PWM_SERVICE_BACKPRESSURE
+
+#ifndef PWM_SERVICE_POST_MARGIN
+#ifdef PWM_SERVICE_ASYNC_DRIVER
+//refresh, wake up, factory test, recall, and a completion per operation
+#define PWM_SERVICE_POST_MARGIN (4U + PWM_SERVICE_CHANNEL_COUNT + 1U)
+#else
+//refresh, wake up, factory test step and recall
+#define PWM_SERVICE_POST_MARGIN 4U
+#endif
+#endif
+
+#ifndef PWM_SERVICE_OUTPUT_MARGIN
+#define PWM_SERVICE_OUTPUT_MARGIN 0U
+#endif
+
+typedef struct {
+    uint32_t dropped[PWM_SERVICE_DROP_KIND_COUNT]; // by enum PwmServiceDropKind
+    bool overloaded; // a drop since the last reset
+} PwmServiceDropStats;
+
+/**
+ * Post a request event (PWM_REQUEST_ON_SIG, PWM_REQUEST_OFF_SIG,
+ * PWM_REQUEST_RAMP_SIG or PWM_REQUEST_FACTORY_TEST_SIG) to the service,
+ * with the PWM_SERVICE_POST_MARGIN margin. Returns false if the request
+ * was dropped, in which case QF has recycled the event. Safe to call
+ * from any thread or ISR.
+ */
+bool PwmService_postRequest(QEvt const* e);
+
+/**
+ * The drops counted since the last reset. Any thread.
+ */
+void PwmService_getDropStats(PwmServiceDropStats* stats);
+
+/**
+ * Clear the drop counters and the overloaded flag, re-arming the
+ * overload report.
+ */
+void PwmService_resetDropStats();
+
+/**
+ * Register the active object posted sig (a static PwmServiceStatusEvent,
+ * PWM_SERVICE_ALL_CHANNELS) on the first drop since the last reset, or
+ * NULL for none, after PwmService_ctor() and before the service is
+ * started. The report is posted with the PWM_SERVICE_OUTPUT_MARGIN
+ * margin: when the observer's queue is full the report is lost, and
+ * the overload is only seen by polling PwmService_getDropStats().
+ */
+void PwmService_setOverloadObserver(QActive* observer, QSignal sig);
+
+#endif //PWM_SERVICE_BACKPRESSURE
+
+/**
+ * Optional request-to-actuation latency instrumentation.
+ * When the service is built with PWM_SERVICE_LATENCY_TRACE, the time
+ * from a request being stamped (published) until the driver's
+ * PwmOn()/PwmOff() is invoked is sampled into a lock-free single
+ * producer ring. Without PWM_SERVICE_LATENCY_TRACE all of this
+ * compiles out.
+ */
+#ifdef PWM_SERVICE_LATENCY_TRACE
+
+/**
+ * Free running timestamp counter, in any unit (e.g. CPU cycles).
+ * Must be provided by the application (BSP).
+ */
+uint32_t PwmService_latencyTimestamp();
+
+/**
+ * Request events are stamped as they are allocated, by
+ * PwmService_newOnRequest() and its siblings, and the service clears
+ * each stamp as it takes it. A request allocated with Q_NEW() instead
+ * is counted as unstamped, and not sampled, as long as its pool block
+ * is either fresh from zeroed (static) storage or was last taken by
+ * the service. So allocate every request with the helpers: a stamped
+ * request dropped by PwmService_postRequest() is recycled stamped.
+ */
+
+typedef struct {
+    uint32_t count;   // samples since the last reset
+    uint32_t dropped; // samples lost to a full ring
+    uint32_t unstamped; // requests allocated without PwmService_newOnRequest() etc, not sampled
+    uint32_t min;
+    uint32_t max;
+    uint32_t p50;     // percentiles, resolution is a power of two
+    uint32_t p90;     // bucket, never more than max.
+    uint32_t p99;
+} PwmServiceLatencyStats;
+
+/**
+ * Drain the latency samples recorded by the service and report the
+ * statistics of all samples since the last reset. A single consumer
+ * (thread) must be used, which need not be the service's thread.
+ */
+void PwmService_getLatencyStats(PwmServiceLatencyStats* stats);
+
+/**
+ * Discard all latency samples. Same consumer as
+ * PwmService_getLatencyStats().
+ */
+void PwmService_resetLatencyStats();
+
+#endif
+
+/**
+ * Optional software trace of the service.
+ * When the service is built with PWM_SERVICE_TRACE, every on/off status
+ * it publishes, and every arm and disarm of its refresh timer, is
+ * reported to PwmService_onTrace(). Dispatches are not reported by the
+ * service itself; trace them where the event loop is (e.g. the QF port,
+ * or by interposing on the active object's dispatch).
+ * Without PWM_SERVICE_TRACE all of this compiles out.
+ */
+#ifdef PWM_SERVICE_TRACE
+
+typedef enum {
+    PWM_SERVICE_TRACE_PUBLISH,      // sig: the status, data: unused
+    PWM_SERVICE_TRACE_TIMER_ARM,    // sig: the timer's, data: ticks
+    PWM_SERVICE_TRACE_TIMER_DISARM, // sig: the timer's, data: unused
+} PwmServiceTraceRecord;
+
+/**
+ * Called by the service, in its own thread, for each trace record.
+ * Must be provided by the application, and must be cheap.
+ * @param channel the status or timer channel, or PWM_SERVICE_ALL_CHANNELS
+ */
+void PwmService_onTrace(PwmServiceTraceRecord record, QSignal sig,
+                        uint8_t channel, uint32_t data);
+
+/**
+ * The name of a signal handled, published or used internally by the
+ * service, or NULL for any other signal. For naming the signals of a
+ * trace (a signal dictionary).
+ */
+char const * PwmService_signalName(QSignal sig);
+
+#endif //PWM_SERVICE_TRACE
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,42 @@
+/// @file pwmServicePools.hpp
+/// @brief The QF event pools for the events allocated by the PwmService
+///        and its clients, laid out at compile time (see eventPoolLayout.hpp).
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#ifndef PWM_SERVICE_POOLS_HPP
+#define PWM_SERVICE_POOLS_HPP
+
+#include "pwmService.h"
+#include "eventPoolLayout.hpp"
+
+/// Every dynamic event of the service's interface. The status events are
+/// static, and are not listed. Initialize exactly poolCount() pools, with
+/// the block sizes of the layout, e.g. with cms::EventPoolStorage.
+using PwmServiceEventPools = cms::EventPoolLayout<PwmServiceOnRequestEvent,
+                                                  PwmServiceOffRequestEvent,
+                                                  PwmServiceRampRequestEvent,
+                                                  PwmServiceFactoryTestRequestEvent,
+                                                  PwmServiceFactoryTestResponseEvent,
+                                                  PwmServiceFactoryTestProgressEvent>;
+
+// The factory test request (pointers and signals) is by far the largest
+// event, and must not share a pool with the frequent on/off requests.
+static_assert(PwmServiceEventPools::poolOf<PwmServiceFactoryTestRequestEvent>() >
+                PwmServiceEventPools::poolOf<PwmServiceOnRequestEvent>(),
+              "the factory test request must have a pool of its own");
+static_assert(PwmServiceEventPools::poolOf<PwmServiceFactoryTestRequestEvent>() ==
+                PwmServiceEventPools::poolCount() - 1U,
+              "the factory test request is expected to be the largest event");
+
+#endif // PWM_SERVICE_POOLS_HPP
@@ -0,0 +1,113 @@
+/*
+ *   Build time generator of the PwmService ramp (soft start) profile
+ *   lookup tables. Executed on the build host, so that the service
+ *   advances a ramp by table lookup only, without floating point or
+ *   transcendental math on the target.
+ *
+ *   usage: pwmRampGen <output directory> <steps> <gamma>
+ *   writes pwmServiceRampTables.h and pwmServiceRampTables.c
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FULL_SCALE 0xFFFFU
+
+typedef double (*ProfileFunction)(double t, double gamma);
+
+static double linear(double t, double gamma)
+{
+    (void)gamma;
+    return t;
+}
+
+static double sCurve(double t, double gamma)
+{
+    (void)gamma;
+    return t * t * (3.0 - 2.0 * t); //smoothstep
+}
+
+static double gammaCurve(double t, double gamma)
+{
+    return pow(t, gamma);
+}
+
+//must match the order of enum PwmServiceRampProfile
+static const struct {
+    const char* name;
+    ProfileFunction function;
+} PROFILES[] = {
+    {"linear", linear},
+    {"s-curve", sCurve},
+    {"gamma", gammaCurve},
+};
+
+#define PROFILE_COUNT (sizeof(PROFILES) / sizeof(PROFILES[0]))
+
+static FILE* openOutput(const char* dir, const char* name)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    return file;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s <output directory> <steps> <gamma>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char* dir = argv[1];
+    const long steps = strtol(argv[2], NULL, 10);
+    const double gamma = strtod(argv[3], NULL);
+    if ((steps < 2) || (steps > 255) || (gamma <= 0.0)) {
+        fprintf(stderr, "%s: steps must be [2 .. 255] and gamma > 0\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE* header = openOutput(dir, "pwmServiceRampTables.h");
+    fprintf(header,
+            "/* generated by pwmRampGen, do not edit */\n"
+            "#ifndef PWM_SERVICE_RAMP_TABLES_H\n"
+            "#define PWM_SERVICE_RAMP_TABLES_H\n"
+            "\n"
+            "#include <stdint.h>\n"
+            "\n"
+            "#define PWM_RAMP_TABLE_STEPS %ldU\n"
+            "#define PWM_RAMP_TABLE_PROFILES %uU\n"
+            "#define PWM_RAMP_TABLE_FULL_SCALE 0x%XU\n"
+            "\n"
+            "/* ramp progress after each step, [0 .. PWM_RAMP_TABLE_FULL_SCALE], by profile */\n"
+            "extern const uint16_t g_pwmRampTables[PWM_RAMP_TABLE_PROFILES][PWM_RAMP_TABLE_STEPS];\n"
+            "\n"
+            "#endif /* PWM_SERVICE_RAMP_TABLES_H */\n",
+            steps, (unsigned)PROFILE_COUNT, FULL_SCALE);
+    fclose(header);
+
+    FILE* source = openOutput(dir, "pwmServiceRampTables.c");
+    fprintf(source,
+            "/* generated by pwmRampGen, do not edit */\n"
+            "#include \"pwmServiceRampTables.h\"\n"
+            "\n"
+            "const uint16_t g_pwmRampTables[PWM_RAMP_TABLE_PROFILES][PWM_RAMP_TABLE_STEPS] = {\n");
+    for (size_t profile = 0; profile < PROFILE_COUNT; ++profile) {
+        fprintf(source, "    /* %s */\n    {", PROFILES[profile].name);
+        for (long step = 0; step < steps; ++step) {
+            const double t = (double)(step + 1) / (double)steps;
+            const double value = PROFILES[profile].function(t, gamma) * FULL_SCALE + 0.5;
+            fprintf(source, "%s%s%u", (step == 0) ? "" : ",",
+                    (step % 8 == 0) ? "\n        " : " ", (unsigned)value);
+        }
+        fprintf(source, "\n    },\n");
+    }
+    fprintf(source, "};\n");
+    fclose(source);
+
+    return EXIT_SUCCESS;
+}
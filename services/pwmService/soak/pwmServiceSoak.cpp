@@ -0,0 +1,267 @@
+/// @brief  Soak simulation of the PwmService, executed on the host with the
+///         cpputest-for-qpc environment and the recording fake of the PWM
+///         driver. Replays a randomized (seeded, so repeatable) workload of
+///         on, off, ramp and factory test requests, with injected output
+///         drift, over simulated days of uptime. Checks that every request
+///         is answered, every drift is repaired, no event leaks (checked by
+///         qf_ctrl::Teardown()) and that the refresh timer is still on its
+///         schedule at the end. Throughput metrics are printed as JSON,
+///         and the peak pool and queue usage written to a report file
+///         by cmsQfUsageReport.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#include "qpc.h"
+#include "pwmService.h"
+#include "pwm.h"
+#include "cms_cpputest_qf_ctrl.hpp"
+#include "bspTicks.h"
+#include "pub_sub_signals.h"
+#include "cmsQfUsageReport.hpp"
+#include "pwmRecordingFake.hpp"
+#include "pwmServicePools.hpp"
+#include "cmsPwmServiceHarness.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// the cpputest headers must always be last
+#include "CppUTest/TestHarness.h"
+
+// Configured by the build, see PWM_SERVICE_SOAK_* in CMakeLists.txt.
+#ifndef PWM_SERVICE_SOAK_DAYS
+#define PWM_SERVICE_SOAK_DAYS 1
+#endif
+#ifndef PWM_SERVICE_SOAK_SEED
+#define PWM_SERVICE_SOAK_SEED 1
+#endif
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+using Call  = cms::test::PwmRecordingFake::Call;
+
+// The verify (read back) count of a channel, on and never drifting, for one
+// hour: at 250, 750, 1750, 3750 and 7750 ms, then every 4000 ms.
+static constexpr size_t READBACKS_PER_HOUR = 5 + (3600000 - 7750) / 4000;
+
+namespace {
+
+PwmServiceDuty SoakDuty(float percent)
+{
+#ifdef PWM_SERVICE_FIXED_POINT_DUTY
+    return PwmPercentToDuty(percent);
+#else
+    return percent;
+#endif
+}
+
+} // namespace
+
+TEST_GROUP(PwmServiceSoak)
+{
+    std::array<const QEvt*, 10> underTestEventQueueStorage;
+    cms::test::FactoryTestClient mClient;
+    std::mt19937 mRandom{PWM_SERVICE_SOAK_SEED};
+
+    // the workload's model of each channel
+    std::array<bool, PWM_SERVICE_CHANNEL_COUNT> mOn;
+
+    uint64_t mRequests       = 0;
+    uint64_t mFactoryTests   = 0;
+    uint64_t mDrifts         = 0;
+    std::chrono::milliseconds mSimulated{0};
+
+    void setup() final
+    {
+        using namespace cms::test;
+
+        qf_ctrl::Setup(MAX_PUB_SUB_SIG, BSP_TICKS_PER_SECOND, PwmServiceTestPools());
+
+        auto current = UtestShell::getCurrent();
+        QfUsageReport::Instance().beginTest(current->getGroup().asCharString(),
+                                            current->getName().asCharString(),
+                                            PwmServiceEventPools::blockSizes());
+
+        PwmRecordingFake::Instance().reset();
+        mOn.fill(false);
+
+        mClient.start(qf_ctrl::RECORDER_PRIORITY + 1, true);
+
+        PwmService_ctor();
+        DispatchCounter::Attach(g_thePwmService);
+
+        underTestEventQueueStorage.fill(nullptr);
+        QACTIVE_START(g_thePwmService, qf_ctrl::UNIT_UNDER_TEST_PRIORITY,
+                      underTestEventQueueStorage.data(), underTestEventQueueStorage.size(),
+                      nullptr, 0, nullptr);
+        qf_ctrl::ProcessEvents();
+    }
+
+    void teardown() final
+    {
+        auto& report = cms::test::QfUsageReport::Instance();
+        report.recordQueues({{cms::test::qf_ctrl::UNIT_UNDER_TEST_PRIORITY, "PwmService"},
+                             {cms::test::qf_ctrl::RECORDER_PRIORITY + 1, "Client"}});
+        report.endTest();
+
+        cms::test::DispatchCounter::Detach();
+        PwmService_dtor();
+
+        // fails the test if any event is still allocated
+        cms::test::qf_ctrl::Teardown();
+    }
+
+    void moveTimeForward(std::chrono::milliseconds duration)
+    {
+        cms::test::qf_ctrl::MoveTimeForward(duration);
+        mSimulated += duration;
+    }
+
+    void publishOn(uint8_t channel, float percent)
+    {
+        auto e = PwmService_newOnRequest(QF_NO_MARGIN, channel, SoakDuty(percent));
+        QF_PUBLISH(&e->super, nullptr);
+        cms::test::qf_ctrl::ProcessEvents();
+        mOn[channel] = true;
+        ++mRequests;
+    }
+
+    void publishOff(uint8_t channel)
+    {
+        auto e = PwmService_newOffRequest(QF_NO_MARGIN, channel);
+        QF_PUBLISH(&e->super, nullptr);
+        cms::test::qf_ctrl::ProcessEvents();
+        mOn[channel] = false;
+        ++mRequests;
+    }
+
+    void publishRamp(uint8_t channel, float percent, uint8_t profile)
+    {
+        auto e = PwmService_newRampRequest(QF_NO_MARGIN, channel, SoakDuty(percent), profile);
+        QF_PUBLISH(&e->super, nullptr);
+        cms::test::qf_ctrl::ProcessEvents();
+        mOn[channel] = true;
+        ++mRequests;
+    }
+
+    // the factory test is only accepted while every channel is off
+    void postFactoryTest()
+    {
+        for (uint8_t channel = 0; channel < PWM_SERVICE_CHANNEL_COUNT; ++channel) {
+            if (mOn[channel]) {
+                publishOff(channel);
+            }
+        }
+
+        auto e = mClient.newRequest(true);
+        QACTIVE_POST(g_thePwmService, &e->super, nullptr);
+        cms::test::qf_ctrl::ProcessEvents();
+        ++mRequests;
+        ++mFactoryTests;
+    }
+
+    // the hardware output of an on channel drifts, and must be
+    // repaired by the next verify, at most 4 s later.
+    void injectDrift(uint8_t channel)
+    {
+        auto& fake = cms::test::PwmRecordingFake::Instance();
+        auto const repairsBefore = fake.count(Call::FORCE_REFRESH, channel);
+
+        //let any ramp finish first, a ramp overwrites the output each step
+        moveTimeForward(1s);
+
+        bool enabled = false;
+        uint16_t duty = 0;
+        CHECK_TRUE(fake.readback(channel, &enabled, &duty));
+        fake.injectDrift(channel, enabled, duty ^ 1U);
+        ++mDrifts;
+
+        moveTimeForward(5s);
+        LONGS_EQUAL(repairsBefore + 1, fake.count(Call::FORCE_REFRESH, channel));
+    }
+
+    void runWorkload(std::chrono::milliseconds duration)
+    {
+        std::uniform_int_distribution<int> action(0, 99);
+        std::uniform_int_distribution<int> channels(0, PWM_SERVICE_CHANNEL_COUNT - 1);
+        std::uniform_int_distribution<int> profiles(0, PWM_SERVICE_RAMP_PROFILE_COUNT - 1);
+        std::uniform_real_distribution<float> percents(0.0f, 1.0f);
+        std::uniform_int_distribution<long> idleMs(10, 120000);
+
+        const auto end = mSimulated + duration;
+        while (mSimulated < end) {
+            const auto channel = static_cast<uint8_t>(channels(mRandom));
+            const int roll = action(mRandom);
+            if (roll < 40) {
+                publishOn(channel, percents(mRandom));
+            } else if (roll < 65) {
+                publishOff(channel);
+            } else if (roll < 80) {
+                publishRamp(channel, percents(mRandom), static_cast<uint8_t>(profiles(mRandom)));
+            } else if (roll < 90) {
+                if (mOn[channel]) {
+                    injectDrift(channel);
+                }
+            } else if (roll < 92) {
+                postFactoryTest();
+            }
+
+            moveTimeForward(std::chrono::milliseconds(idleMs(mRandom)));
+        }
+    }
+};
+
+TEST(PwmServiceSoak, randomized_workload_over_simulated_days)
+{
+    using namespace cms::test;
+    auto& fake = PwmRecordingFake::Instance();
+
+    const auto wallStart = Clock::now();
+    runWorkload(std::chrono::hours(24 * PWM_SERVICE_SOAK_DAYS));
+
+    //quiesce, then confirm the refresh timer is still on its schedule
+    for (uint8_t channel = 0; channel < PWM_SERVICE_CHANNEL_COUNT; ++channel) {
+        if (mOn[channel]) {
+            publishOff(channel);
+        }
+    }
+    publishOn(0, 0.5f);
+    const auto readbacksBefore = fake.count(Call::READBACK, 0);
+    moveTimeForward(1h);
+    LONGS_EQUAL(READBACKS_PER_HOUR, fake.count(Call::READBACK, 0) - readbacksBefore);
+    publishOff(0);
+
+    const double wallSeconds = std::chrono::duration<double>(Clock::now() - wallStart).count();
+    const double simSeconds  = std::chrono::duration<double>(mSimulated).count();
+    const uint64_t dispatched = cms::test::DispatchCounter::Count();
+
+    //every factory test was run and answered, with its progress
+    LONGS_EQUAL(mFactoryTests, fake.count(Call::FACTORY_TEST));
+    LONGS_EQUAL(mFactoryTests, mClient.factoryResponses);
+    LONGS_EQUAL(mFactoryTests * PWM_FACTORY_TEST_STEPS, mClient.factoryProgress);
+
+    //every drift was repaired exactly once
+    LONGS_EQUAL(mDrifts, fake.count(Call::FORCE_REFRESH));
+
+    printf("\n{\"pwm_service_soak\":{\"seed\":%u,\"simulated_s\":%.0f,\"wall_s\":%.3f,"
+           "\"simulated_s_per_wall_s\":%.0f,\"requests\":%llu,\"events_dispatched\":%llu,"
+           "\"events_per_wall_s\":%.0f,\"driver_calls\":%zu,\"factory_tests\":%llu,\"drifts\":%llu}}\n",
+           static_cast<unsigned>(PWM_SERVICE_SOAK_SEED), simSeconds, wallSeconds,
+           simSeconds / wallSeconds, static_cast<unsigned long long>(mRequests),
+           static_cast<unsigned long long>(dispatched),
+           static_cast<double>(dispatched) / wallSeconds, fake.total(),
+           static_cast<unsigned long long>(mFactoryTests),
+           static_cast<unsigned long long>(mDrifts));
+}
@@ -19,86 +19,795 @@
 #include "qsafe.h"
 #include "pub_sub_signals.h"
 #include "bspTicks.h"
+#include "pwmServiceRampTables.h"
+#ifdef PWM_SERVICE_REFRESH_SCHEDULER
+#include "refreshScheduler.h"
+#endif
 #include <stddef.h>
+#include <stdatomic.h>
 
 Q_DEFINE_THIS_MODULE("PwmService")
 
+_Static_assert(PWM_SERVICE_CHANNEL_COUNT <= PWM_MAX_CHANNELS,
+               "PwmService channel count exceeds the PWM driver channel count");
+_Static_assert(PWM_SERVICE_CHANNEL_COUNT < PWM_SERVICE_ALL_CHANNELS,
+               "PwmService channel count collides with PWM_SERVICE_ALL_CHANNELS");
+_Static_assert(PWM_SERVICE_DUTY_FULL_SCALE == PWM_DUTY_FULL_SCALE,
+               "PwmService and PWM driver disagree on the full scale duty cycle");
+_Static_assert(PWM_SERVICE_RAMP_PROFILE_COUNT == PWM_RAMP_TABLE_PROFILES,
+               "PwmService ramp profiles and the generated ramp tables disagree");
+_Static_assert(PWM_RAMP_TABLE_FULL_SCALE == PWM_DUTY_FULL_SCALE,
+               "generated ramp tables and PWM driver disagree on the full scale duty cycle");
+
 typedef struct {
     QActive super; /* inherit QActive, via QP/C Framework C style */
 
     //member variables of PwmService
-    float current_percent;
+#ifdef PWM_SERVICE_REFRESH_SCHEDULER
+    RefreshClient refresh_timer;
+#else
     QTimeEvt refresh_timer;
+#endif
+    uint32_t refresh_ticks; //current verify interval, backs off while stable
+    uint8_t on_count;
+
+    //per channel state, kept as parallel arrays so that
+    //a refresh walks contiguous memory.
+    PwmServiceDuty current_percent[PWM_SERVICE_CHANNEL_COUNT];
+    uint16_t expected_duty[PWM_SERVICE_CHANNEL_COUNT]; //as read back from the driver
+    bool is_on[PWM_SERVICE_CHANNEL_COUNT];
+
+    //ramp in progress, per channel
+    bool ramping[PWM_SERVICE_CHANNEL_COUNT];
+    uint8_t ramp_profile[PWM_SERVICE_CHANNEL_COUNT];
+    uint8_t ramp_next_step[PWM_SERVICE_CHANNEL_COUNT];
+    uint16_t ramp_from[PWM_SERVICE_CHANNEL_COUNT];
+    uint16_t ramp_to[PWM_SERVICE_CHANNEL_COUNT];
+    uint8_t ramp_count;
+
+    //coalesced request mailboxes, written by any context
+    //within a critical section.
+    uint8_t pending_request[PWM_SERVICE_CHANNEL_COUNT];
+    PwmServiceDuty pending_percent[PWM_SERVICE_CHANNEL_COUNT];
+    bool apply_pending_posted;
+
+    //while holding requests (see state_of_holding)
+    bool apply_pending_deferred;
+    QEQueue deferred_queue;
+    QEvt const * deferred_storage[PWM_SERVICE_DEFERRED_FACTORY_TESTS];
+
+    //the factory test in progress
+    QActive* factory_requester;
+    QSignal factory_response_sig;
+    PwmServiceFactoryTestResponseEvent* factory_response;
+#ifdef PWM_SERVICE_ASYNC_DRIVER
+    //driver operations in flight, at most one per channel
+    uint8_t in_flight;
+    uint8_t op[PWM_SERVICE_CHANNEL_COUNT];
+#else
+    QSignal factory_progress_sig;
+    uint8_t factory_steps_done;
+    PwmFactoryTestRun factory_run;
+#endif
+
+#ifdef PWM_SERVICE_LATENCY_TRACE
+    //UNSTAMPED when the request was not stamped
+    uint32_t pending_timestamp[PWM_SERVICE_CHANNEL_COUNT];
+    uint32_t request_timestamp; //of the request being handled
+    uint32_t op_timestamp[PWM_SERVICE_CHANNEL_COUNT]; //of the request driving each channel
+#endif
 } PwmService;
 
+#ifdef PWM_SERVICE_LATENCY_TRACE
+
+//must be a power of two
+#ifndef PWM_SERVICE_LATENCY_RING_SIZE
+#define PWM_SERVICE_LATENCY_RING_SIZE 64U
+#endif
+_Static_assert((PWM_SERVICE_LATENCY_RING_SIZE & (PWM_SERVICE_LATENCY_RING_SIZE - 1U)) == 0U,
+               "PWM_SERVICE_LATENCY_RING_SIZE must be a power of two");
+
+#define LATENCY_BUCKETS 33U //log2 buckets, bucket 0 holds the zero samples
+
+//single producer (the service) single consumer ring of samples.
+typedef struct {
+    uint32_t samples[PWM_SERVICE_LATENCY_RING_SIZE];
+    atomic_uint_fast32_t head;    //written by the producer only
+    atomic_uint_fast32_t tail;    //written by the consumer only
+    atomic_uint_fast32_t dropped; //written by the producer only
+    atomic_uint_fast32_t unstamped; //written by the producer only
+} LatencyRing;
+
+//consumer owned statistics
+typedef struct {
+    uint32_t buckets[LATENCY_BUCKETS];
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t dropped_at_reset;
+    uint32_t unstamped_at_reset;
+} LatencyHistogram;
+
+static LatencyRing m_latencyRing;
+static LatencyHistogram m_latencyHistogram;
+
+static void latencySample(PwmService const * me, uint8_t channel);
+
+#define UNSTAMPED 0U
+
+static uint32_t requestTimestamp(void);
+static uint32_t takeStamp(uint32_t const * timestamp);
+
+//a request event's stamp is taken (read and cleared) by the service, so
+//that its pool block reads as unstamped when reused by Q_NEW().
+#define REQUEST_TIMESTAMP() requestTimestamp()
+#define STAMP_REQUEST(e_) ((e_)->timestamp = requestTimestamp())
+#define EVENT_TAKE_STAMP(e_) takeStamp(&(e_)->timestamp)
+#define LATENCY_REQUEST(me_, timestamp_) ((me_)->request_timestamp = (timestamp_))
+#define LATENCY_REQUEST_EVENT(me_, e_) LATENCY_REQUEST(me_, EVENT_TAKE_STAMP(e_))
+#define LATENCY_START(me_, channel_) ((me_)->op_timestamp[channel_] = (me_)->request_timestamp)
+#define LATENCY_SAMPLE(me_, channel_) latencySample(me_, channel_)
+#else
+#define REQUEST_TIMESTAMP() 0U
+#define STAMP_REQUEST(e_) ((void)0)
+#define EVENT_TAKE_STAMP(e_) ((void)(e_), 0U)
+#define LATENCY_REQUEST(me_, timestamp_) ((void)0)
+#define LATENCY_REQUEST_EVENT(me_, e_) ((void)0)
+#define LATENCY_START(me_, channel_) ((void)(me_))
+#define LATENCY_SAMPLE(me_, channel_) ((void)(me_))
+#endif
+
+#ifdef PWM_SERVICE_TRACE
+#define TRACE_PUBLISH(status_) \
+    PwmService_onTrace(PWM_SERVICE_TRACE_PUBLISH, (status_)->super.sig, (status_)->channel, 0U)
+#define TRACE_TIMER_ARM(me_) \
+    PwmService_onTrace(PWM_SERVICE_TRACE_TIMER_ARM, PWM_REFRESH_SIG, PWM_SERVICE_ALL_CHANNELS, (me_)->refresh_ticks)
+#define TRACE_TIMER_DISARM(me_) \
+    PwmService_onTrace(PWM_SERVICE_TRACE_TIMER_DISARM, PWM_REFRESH_SIG, PWM_SERVICE_ALL_CHANNELS, 0U)
+#else
+#define TRACE_PUBLISH(status_) ((void)0)
+#define TRACE_TIMER_ARM(me_) ((void)(me_))
+#define TRACE_TIMER_DISARM(me_) ((void)(me_))
+#endif
+
+#ifdef PWM_SERVICE_BACKPRESSURE
+//written by any thread (requests) and by the service (outputs)
+static atomic_uint_fast32_t m_dropped[PWM_SERVICE_DROP_KIND_COUNT];
+static atomic_bool m_overloaded;
+static QActive * m_overloadObserver;
+
+static void countDrop(uint8_t kind);
+
+#define NEW_OUTPUT(evtT_, sig_) Q_NEW_X(evtT_, PWM_SERVICE_OUTPUT_MARGIN, (sig_))
+#define COUNT_DROP(kind_) countDrop(kind_)
+#else
+#define NEW_OUTPUT(evtT_, sig_) Q_NEW(evtT_, (sig_))
+#define COUNT_DROP(kind_) ((void)0)
+#endif
+
 enum InternalSignals {
-    PWM_REFRESH_SIG = MAX_PWM_POSTED_SIGNALS
+    PWM_REFRESH_SIG = MAX_PWM_POSTED_SIGNALS,
+    PWM_APPLY_PENDING_SIG,
+    PWM_DRIVER_DONE_SIG,
+    PWM_FACTORY_TEST_DONE_SIG,
+    PWM_FACTORY_TEST_STEP_SIG,
+    MAX_PWM_INTERNAL_SIG
+};
+
+enum PendingRequest {
+    PENDING_NONE,
+    PENDING_ON,
+    PENDING_OFF,
+    PENDING_RAMP //plus the ramp profile
 };
 
-static const uint32_t TICKS_PER_REFRESH = BSP_TICKS_PER_SECOND / 4;
+//driver operation on a channel
+enum DriverOp {
+    OP_NONE,
+    OP_ON,
+    OP_OFF,
+    OP_REFRESH,  //re-program after drift, not reported
+    OP_RAMP,     //a ramp step, not reported
+    OP_RAMP_DONE //the last ramp step, reported
+};
+
+#ifdef PWM_SERVICE_ASYNC_DRIVER
+//posted by the driver's completion callbacks
+typedef struct {
+    QEvt super;
+    uint8_t channel;
+    bool ok;
+} DriverDoneEvent;
+
+typedef struct {
+    QEvt super;
+    uint16_t device_id;
+} FactoryTestDoneEvent;
+
+#define IS_BUSY(me_) ((me_)->in_flight != 0U)
+#define TRAN_BUSY() Q_TRAN(&state_of_busy)
+#else
+//a synchronous driver has completed every operation on return
+#define IS_BUSY(me_) (false)
+#define TRAN_BUSY() Q_HANDLED() //unreachable
+#endif
+
+//While on, the output is verified (read back) every refresh interval, and
+//only re-programmed when it has drifted. The interval doubles after each
+//successful verification, up to the maximum, and returns to the minimum
+//after any request or drift. Both may be overridden by the build.
+#ifndef PWM_SERVICE_REFRESH_MIN_TICKS
+#define PWM_SERVICE_REFRESH_MIN_TICKS (BSP_TICKS_PER_SECOND / 4)
+#endif
+#ifndef PWM_SERVICE_REFRESH_MAX_TICKS
+#define PWM_SERVICE_REFRESH_MAX_TICKS (BSP_TICKS_PER_SECOND * 4)
+#endif
+
+//While any channel ramps, the refresh timer instead advances
+//every ramp by one table step each PWM_SERVICE_RAMP_TICKS.
+#ifndef PWM_SERVICE_RAMP_TICKS
+#define PWM_SERVICE_RAMP_TICKS (BSP_TICKS_PER_SECOND / 100)
+#endif
+
+//The refresh timer is a time event of the service, or, when built with
+//PWM_SERVICE_REFRESH_SCHEDULER, a client of the shared refresh scheduler,
+//which staggers the refreshes of its clients (see refreshScheduler.h).
+#ifdef PWM_SERVICE_REFRESH_SCHEDULER
+#define REFRESH_TIMER_CTOR(me_) RefreshClient_ctor(&(me_)->refresh_timer, &(me_)->super, PWM_REFRESH_SIG)
+#define REFRESH_TIMER_ARM(me_) RefreshClient_arm(&(me_)->refresh_timer, (me_)->refresh_ticks)
+#define REFRESH_TIMER_DISARM(me_) ((void)RefreshClient_disarm(&(me_)->refresh_timer))
+#else
+#define REFRESH_TIMER_CTOR(me_) QTimeEvt_ctorX(&(me_)->refresh_timer, &(me_)->super, PWM_REFRESH_SIG, 0U)
+#define REFRESH_TIMER_ARM(me_) QTimeEvt_armX(&(me_)->refresh_timer, (me_)->refresh_ticks, 0U)
+#define REFRESH_TIMER_DISARM(me_) ((void)QTimeEvt_disarm(&(me_)->refresh_timer))
+#endif
+
+static const uint32_t REFRESH_MIN_TICKS = PWM_SERVICE_REFRESH_MIN_TICKS;
+static const uint32_t REFRESH_MAX_TICKS = PWM_SERVICE_REFRESH_MAX_TICKS;
+static const uint32_t RAMP_TICKS = PWM_SERVICE_RAMP_TICKS;
 
 //internal state handlers.
 static QState initial(PwmService * me, void const * par);
 static QState state_of_off(PwmService * me, QEvt const * e);
 static QState state_of_on(PwmService * me, QEvt const * e);
+static QState state_of_holding(PwmService * me, QEvt const * e);
+#ifdef PWM_SERVICE_ASYNC_DRIVER
+static QState state_of_busy(PwmService * me, QEvt const * e);
+#else
+static QState state_of_factory_test(PwmService * me, QEvt const * e);
+#endif
+
+//internal helpers
+static void initInstance(PwmService * me);
+static void staticEventInit(QEvt * event, enum_t sig);
+static void statusEventInit(PwmServiceStatusEvent * event, enum_t sig, uint8_t channel);
+static void channelOn(PwmService * me, uint8_t channel, PwmServiceDuty percent);
+static void channelOff(PwmService * me, uint8_t channel);
+static void channelRamp(PwmService * me, uint8_t channel, PwmServiceDuty percent, uint8_t profile);
+static void advanceRamp(PwmService * me, uint8_t channel);
+static void stopRamp(PwmService * me, uint8_t channel);
+static void storePendingRequest(uint8_t channel, uint8_t request, PwmServiceDuty percent, uint32_t timestamp);
+static void driveChannel(PwmService * me, uint8_t channel, uint8_t op);
+static void completeChannelOp(PwmService * me, uint8_t channel, uint8_t op);
+static void updateSnapshot(PwmService const * me, uint8_t channel);
+static void publishStatus(PwmServiceStatusEvent const * status);
+static void postOutput(QActive * requester, QEvt const * e, uint8_t dropKind);
+static void postFactoryTestResponse(QActive * requester, QSignal sig,
+                                    PwmServiceFactoryTestResponseEvent * response, uint16_t id);
+static uint16_t toDuty(PwmServiceDuty percent);
+static void restartRefresh(PwmService * me);
+static bool verifyChannels(PwmService * me);
+static void applyPendingRequests(PwmService * me);
+static QState leaveHolding(PwmService * me);
+#ifdef PWM_SERVICE_ASYNC_DRIVER
+static void driverDone(void * context, bool ok);
+static void factoryTestDone(void * context, uint16_t device_id);
+#else
+static bool driverOn(uint8_t channel, PwmServiceDuty percent);
+static void postFactoryTestProgress(PwmService * me);
+#endif
 
 static PwmService m_instance;
 QActive * g_thePwmService = NULL;
 
+//static status events, one per channel, published without allocation
+static PwmServiceStatusEvent m_onStatusEvents[PWM_SERVICE_CHANNEL_COUNT];
+static PwmServiceStatusEvent m_offStatusEvents[PWM_SERVICE_CHANNEL_COUNT];
+static PwmServiceStatusEvent m_allOffStatusEvent;
+#ifdef PWM_SERVICE_BACKPRESSURE
+static PwmServiceStatusEvent m_overloadStatusEvent;
+#endif
+
+//status snapshot, a sequence lock written by the service only. The
+//sequence is odd while an update is in progress. The fields are relaxed
+//atomics, so that a reader racing with an update is well defined (and
+//then discards its copy).
+static struct {
+    atomic_uint_fast32_t sequence;
+    atomic_bool is_on[PWM_SERVICE_CHANNEL_COUNT];
+    _Atomic PwmServiceDuty percent[PWM_SERVICE_CHANNEL_COUNT];
+} m_snapshot;
+
+static const QEvt ApplyPendingEvent = QEVT_INITIALIZER(PWM_APPLY_PENDING_SIG);
+#ifndef PWM_SERVICE_ASYNC_DRIVER
+static const QEvt FactoryTestStepEvent = QEVT_INITIALIZER(PWM_FACTORY_TEST_STEP_SIG);
+#endif
+
+#ifdef PWM_SERVICE_ASYNC_DRIVER
+//static completion events, safe as at most one operation per channel is in flight
+static DriverDoneEvent m_driverDoneEvents[PWM_SERVICE_CHANNEL_COUNT];
+static FactoryTestDoneEvent m_factoryTestDoneEvent;
+#endif
+
 void PwmService_ctor()
 {
     QActive_ctor(&m_instance.super, Q_STATE_CAST(initial));
+
+    REFRESH_TIMER_CTOR(&m_instance);
+    initInstance(&m_instance);
+#ifdef PWM_SERVICE_BACKPRESSURE
+    m_overloadObserver = NULL;
+#endif
+
     g_thePwmService = &m_instance.super;
 }
 
 void PwmService_dtor()
 {
-    QTimeEvt_disarm(&m_instance.refresh_timer);
+    REFRESH_TIMER_DISARM(&m_instance);
     g_thePwmService = NULL;
 }
 
+void PwmService_reset()
+{
+    PwmService * const me = &m_instance;
+
+    //nothing is in flight: no queued event, and no driver operation
+    //(or factory test) to complete.
+    Q_REQUIRE(me->super.eQueue.frontEvt == NULL);
+    Q_REQUIRE(!IS_BUSY(me));
+
+    REFRESH_TIMER_DISARM(me);
+    (void)QActive_flushDeferred(&me->super, &me->deferred_queue, Q_DIM(me->deferred_storage));
+    initInstance(me);
+
+    //take the top-most initial transition again, as QActive_start() does,
+    //without exiting the present state (the timer is disarmed above).
+    me->super.super.state.fun = Q_STATE_CAST(&QHsm_top);
+    me->super.super.temp.fun = Q_STATE_CAST(&initial);
+    QASM_INIT(&me->super, NULL, me->super.prio);
+}
+
+// Everything but the active object and its timer, both of which
+// must survive PwmService_reset().
+static void initInstance(PwmService * const me)
+{
+    me->on_count = 0;
+    me->ramp_count = 0;
+    me->apply_pending_posted = false;
+    for (uint8_t channel = 0; channel < PWM_SERVICE_CHANNEL_COUNT; ++channel) {
+        me->current_percent[channel] = 0;
+        me->expected_duty[channel] = 0;
+        me->is_on[channel] = false;
+        me->ramping[channel] = false;
+        me->pending_request[channel] = PENDING_NONE;
+        me->pending_percent[channel] = 0;
+        statusEventInit(&m_onStatusEvents[channel], PWM_IS_ON_SIG, channel);
+        statusEventInit(&m_offStatusEvents[channel], PWM_IS_OFF_SIG, channel);
+    }
+    statusEventInit(&m_allOffStatusEvent, PWM_IS_OFF_SIG, PWM_SERVICE_ALL_CHANNELS);
+#ifdef PWM_SERVICE_BACKPRESSURE
+    PwmService_resetDropStats();
+#endif
+
+    atomic_store_explicit(&m_snapshot.sequence, 0U, memory_order_relaxed);
+    for (uint8_t channel = 0; channel < PWM_SERVICE_CHANNEL_COUNT; ++channel) {
+        atomic_store_explicit(&m_snapshot.is_on[channel], false, memory_order_relaxed);
+        atomic_store_explicit(&m_snapshot.percent[channel], 0, memory_order_relaxed);
+    }
+
+    me->apply_pending_deferred = false;
+    //a QEQueue holds its front event besides its ring, so the ring
+    //is one shorter than the storage
+    QEQueue_init(&me->deferred_queue, me->deferred_storage,
+                 Q_DIM(me->deferred_storage) - 1U);
+
+#ifdef PWM_SERVICE_ASYNC_DRIVER
+    me->in_flight = 0;
+    for (uint8_t channel = 0; channel < PWM_SERVICE_CHANNEL_COUNT; ++channel) {
+        me->op[channel] = OP_NONE;
+        staticEventInit(&m_driverDoneEvents[channel].super, PWM_DRIVER_DONE_SIG);
+        m_driverDoneEvents[channel].channel = channel;
+    }
+    staticEventInit(&m_factoryTestDoneEvent.super, PWM_FACTORY_TEST_DONE_SIG);
+#endif
+}
+
+void PwmService_requestOn(uint8_t channel, PwmServiceDuty percent)
+{
+    storePendingRequest(channel, PENDING_ON, percent, REQUEST_TIMESTAMP());
+}
+
+void PwmService_requestOff(uint8_t channel)
+{
+    storePendingRequest(channel, PENDING_OFF, 0, REQUEST_TIMESTAMP());
+}
+
+void PwmService_requestRamp(uint8_t channel, PwmServiceDuty percent, uint8_t profile)
+{
+    Q_ASSERT(profile < PWM_SERVICE_RAMP_PROFILE_COUNT);
+    storePendingRequest(channel, PENDING_RAMP + profile, percent, REQUEST_TIMESTAMP());
+}
+
+PwmServiceOnRequestEvent * PwmService_newOnRequest(uint_fast16_t const margin, uint8_t const channel,
+                                                   PwmServiceDuty const percent)
+{
+    PwmServiceOnRequestEvent * const e = Q_NEW_X(PwmServiceOnRequestEvent, margin, PWM_REQUEST_ON_SIG);
+    if (e != NULL) {
+        e->channel = channel;
+        e->percent = percent;
+        STAMP_REQUEST(e);
+    }
+    return e;
+}
+
+PwmServiceOffRequestEvent * PwmService_newOffRequest(uint_fast16_t const margin, uint8_t const channel)
+{
+    PwmServiceOffRequestEvent * const e = Q_NEW_X(PwmServiceOffRequestEvent, margin, PWM_REQUEST_OFF_SIG);
+    if (e != NULL) {
+        e->channel = channel;
+        STAMP_REQUEST(e);
+    }
+    return e;
+}
+
+PwmServiceRampRequestEvent * PwmService_newRampRequest(uint_fast16_t const margin, uint8_t const channel,
+                                                       PwmServiceDuty const percent, uint8_t const profile)
+{
+    PwmServiceRampRequestEvent * const e = Q_NEW_X(PwmServiceRampRequestEvent, margin, PWM_REQUEST_RAMP_SIG);
+    if (e != NULL) {
+        e->channel = channel;
+        e->percent = percent;
+        e->profile = profile;
+        STAMP_REQUEST(e);
+    }
+    return e;
+}
+
 static QState initial(PwmService * const me, void const * const par)
 {
     Q_UNUSED_PAR(par);
     QActive_subscribe(&me->super, PWM_REQUEST_ON_SIG);
     QActive_subscribe(&me->super, PWM_REQUEST_OFF_SIG);
-    QTimeEvt_ctorX(&me->refresh_timer, &me->super, PWM_REFRESH_SIG, 0U);
+    QActive_subscribe(&me->super, PWM_REQUEST_RAMP_SIG);
     bool ok = PwmInit();
     Q_ASSERT(true == ok);
+
+    for (uint8_t channel = 0; channel < PWM_SERVICE_CHANNEL_COUNT; ++channel) {
+        ok = PwmOff(channel);
+        Q_ASSERT(true == ok);
+    }
+    updateSnapshot(me, PWM_SERVICE_ALL_CHANNELS);
+    publishStatus(&m_allOffStatusEvent);
+
     return Q_TRAN(&state_of_off);
 }
 
+//The on and off states are each a list of signal to action pairs (an
+//X-macro list). By default each list generates the cases of a switch.
+//Built with PWM_SERVICE_TABLE_DISPATCH, each list instead generates a
+//table indexed by signal, so that dispatch is a single lookup no matter
+//how many signals a state handles.
+typedef QState (*PwmServiceAction)(PwmService * me, QEvt const * e);
+
+static QState offRequestOn(PwmService * const me, QEvt const * const e)
+{
+    const PwmServiceOnRequestEvent* event = (const PwmServiceOnRequestEvent*)e;
+    LATENCY_REQUEST_EVENT(me, event);
+    channelOn(me, event->channel, event->percent);
+    return IS_BUSY(me) ? TRAN_BUSY() : Q_TRAN(&state_of_on);
+}
+
+static QState offRequestRamp(PwmService * const me, QEvt const * const e)
+{
+    const PwmServiceRampRequestEvent* event = (const PwmServiceRampRequestEvent*)e;
+    LATENCY_REQUEST_EVENT(me, event);
+    channelRamp(me, event->channel, event->percent, event->profile);
+    return IS_BUSY(me) ? TRAN_BUSY() : Q_TRAN(&state_of_on);
+}
+
+static QState offRequestOff(PwmService * const me, QEvt const * const e)
+{
+    //already off, only the request's stamp is taken
+    (void)me;
+    (void)EVENT_TAKE_STAMP((const PwmServiceOffRequestEvent*)e);
+    return Q_HANDLED();
+}
+
+static QState offApplyPending(PwmService * const me, QEvt const * const e)
+{
+    (void)e;
+    applyPendingRequests(me);
+    if (IS_BUSY(me)) {
+        return TRAN_BUSY();
+    }
+    return (me->on_count > 0) ? Q_TRAN(&state_of_on) : Q_HANDLED();
+}
+
+static QState offRequestFactoryTest(PwmService * const me, QEvt const * const e)
+{
+    const PwmServiceFactoryTestRequestEvent * event = (const PwmServiceFactoryTestRequestEvent*)e;
+    me->factory_requester = event->requester;
+    me->factory_response_sig = event->response_sig;
+    me->factory_response = event->response;
+#ifdef PWM_SERVICE_ASYNC_DRIVER
+    ++me->in_flight;
+    bool ok = PwmFactoryTestAsync(&factoryTestDone, &m_factoryTestDoneEvent);
+    Q_ASSERT(true == ok);
+    return TRAN_BUSY();
+#else
+    me->factory_progress_sig = event->progress_sig;
+    return Q_TRAN(&state_of_factory_test);
+#endif
+}
+
+#define STATE_OF_OFF_ACTIONS(X)                            \
+    X(PWM_REQUEST_ON_SIG, offRequestOn)                    \
+    X(PWM_REQUEST_RAMP_SIG, offRequestRamp)                \
+    X(PWM_REQUEST_OFF_SIG, offRequestOff)                  \
+    X(PWM_APPLY_PENDING_SIG, offApplyPending)              \
+    X(PWM_REQUEST_FACTORY_TEST_SIG, offRequestFactoryTest)
+
+static QState onEntry(PwmService * const me, QEvt const * const e)
+{
+    (void)e;
+    restartRefresh(me);
+    return Q_HANDLED();
+}
+
+static QState onExit(PwmService * const me, QEvt const * const e)
+{
+    (void)e;
+    REFRESH_TIMER_DISARM(me);
+    TRACE_TIMER_DISARM(me);
+    return Q_HANDLED();
+}
+
+static QState onRequestOn(PwmService * const me, QEvt const * const e)
+{
+    const PwmServiceOnRequestEvent* event = (const PwmServiceOnRequestEvent*)e;
+    LATENCY_REQUEST_EVENT(me, event);
+    channelOn(me, event->channel, event->percent);
+    if (IS_BUSY(me)) {
+        return TRAN_BUSY();
+    }
+    restartRefresh(me);
+    return Q_HANDLED();
+}
+
+static QState onRequestRamp(PwmService * const me, QEvt const * const e)
+{
+    const PwmServiceRampRequestEvent* event = (const PwmServiceRampRequestEvent*)e;
+    LATENCY_REQUEST_EVENT(me, event);
+    channelRamp(me, event->channel, event->percent, event->profile);
+    if (IS_BUSY(me)) {
+        return TRAN_BUSY();
+    }
+    restartRefresh(me);
+    return Q_HANDLED();
+}
+
+static QState onRequestOff(PwmService * const me, QEvt const * const e)
+{
+    const PwmServiceOffRequestEvent* event = (const PwmServiceOffRequestEvent*)e;
+    LATENCY_REQUEST_EVENT(me, event);
+    channelOff(me, event->channel);
+    if (IS_BUSY(me)) {
+        return TRAN_BUSY();
+    }
+    return (me->on_count == 0) ? Q_TRAN(&state_of_off) : Q_HANDLED();
+}
+
+static QState onApplyPending(PwmService * const me, QEvt const * const e)
+{
+    (void)e;
+    applyPendingRequests(me);
+    if (IS_BUSY(me)) {
+        return TRAN_BUSY();
+    }
+    if (me->on_count == 0) {
+        return Q_TRAN(&state_of_off);
+    }
+    restartRefresh(me);
+    return Q_HANDLED();
+}
+
+static QState onRefresh(PwmService * const me, QEvt const * const e)
+{
+    (void)e;
+    if (me->ramp_count > 0U) {
+        for (uint8_t channel = 0; channel < PWM_SERVICE_CHANNEL_COUNT; ++channel) {
+            if (me->ramping[channel]) {
+                advanceRamp(me, channel);
+            }
+        }
+
+        if (IS_BUSY(me)) {
+            return TRAN_BUSY();
+        }
+
+        //next ramp step, or the first verify once done
+        restartRefresh(me);
+        return Q_HANDLED();
+    }
+
+    bool const drifted = verifyChannels(me);
+    if (IS_BUSY(me)) {
+        //re-programming, the refresh restarts once done
+        return TRAN_BUSY();
+    }
+
+    if (drifted) {
+        me->refresh_ticks = REFRESH_MIN_TICKS;
+    }
+    else if (me->refresh_ticks < REFRESH_MAX_TICKS) {
+        me->refresh_ticks *= 2U;
+        if (me->refresh_ticks > REFRESH_MAX_TICKS) {
+            me->refresh_ticks = REFRESH_MAX_TICKS;
+        }
+    }
+    REFRESH_TIMER_ARM(me);
+    TRACE_TIMER_ARM(me);
+    return Q_HANDLED();
+}
+
+static QState onRequestFactoryTest(PwmService * const me, QEvt const * const e)
+{
+    (void)me;
+    (void)e;
+    //factory test is not supported when PWM is on
+    Q_ASSERT(true == false);
+    return Q_HANDLED();
+}
+
+#define STATE_OF_ON_ACTIONS(X)                             \
+    X(Q_ENTRY_SIG, onEntry)                                \
+    X(Q_EXIT_SIG, onExit)                                  \
+    X(PWM_REQUEST_ON_SIG, onRequestOn)                     \
+    X(PWM_REQUEST_RAMP_SIG, onRequestRamp)                 \
+    X(PWM_REQUEST_OFF_SIG, onRequestOff)                   \
+    X(PWM_APPLY_PENDING_SIG, onApplyPending)               \
+    X(PWM_REFRESH_SIG, onRefresh)                          \
+    X(PWM_REQUEST_FACTORY_TEST_SIG, onRequestFactoryTest)
+
+#ifdef PWM_SERVICE_TABLE_DISPATCH
+
+#define ACTION_TABLE_ENTRY(sig_, action_) [sig_] = &action_,
+
+static const PwmServiceAction m_offActions[MAX_PWM_INTERNAL_SIG] = {
+    STATE_OF_OFF_ACTIONS(ACTION_TABLE_ENTRY)
+};
+static const PwmServiceAction m_onActions[MAX_PWM_INTERNAL_SIG] = {
+    STATE_OF_ON_ACTIONS(ACTION_TABLE_ENTRY)
+};
+
+static QState dispatchActions(PwmService * const me, QEvt const * const e,
+                              PwmServiceAction const * const actions, QStateHandler const super)
+{
+    if (e->sig < MAX_PWM_INTERNAL_SIG) {
+        PwmServiceAction const action = actions[e->sig];
+        if (action != NULL) {
+            return action(me, e);
+        }
+    }
+    return Q_SUPER(super);
+}
+
+QState state_of_off(PwmService * me, const QEvt* e)
+{
+    return dispatchActions(me, e, m_offActions, Q_STATE_CAST(&QHsm_top));
+}
+
+QState state_of_on(PwmService * me, const QEvt* e)
+{
+    return dispatchActions(me, e, m_onActions, Q_STATE_CAST(&QHsm_top));
+}
+
+#else
+
+#define ACTION_CASE(sig_, action_) \
+    case sig_:                     \
+        rtn = action_(me, e);      \
+        break;
+
 QState state_of_off(PwmService * me, const QEvt* e)
 {
-    static const QEvt OffStatusEvent = QEVT_INITIALIZER(PWM_IS_OFF_SIG);
     QState rtn;
 
     switch (e->sig) {
-        case Q_ENTRY_SIG: {
-            bool ok = PwmOff();
-            Q_ASSERT(true == ok);
-            QF_PUBLISH(&OffStatusEvent, &me->super);
+        STATE_OF_OFF_ACTIONS(ACTION_CASE)
+
+        default:
+            rtn = Q_SUPER(&QHsm_top);
+            break;
+    }
+
+    return rtn;
+}
+
+QState state_of_on(PwmService * me, const QEvt* e)
+{
+    QState rtn;
+
+    switch (e->sig) {
+        STATE_OF_ON_ACTIONS(ACTION_CASE)
+
+        default:
+            rtn = Q_SUPER(&QHsm_top);
+            break;
+    }
+
+    return rtn;
+}
+
+#endif //PWM_SERVICE_TABLE_DISPATCH
+
+//Requests are held until the service may act on them again: on and off
+//requests in the coalescing mailboxes (newest request per channel wins),
+//and a factory test request in the deferred queue.
+QState state_of_holding(PwmService * me, const QEvt* e)
+{
+    QState rtn;
+
+    switch (e->sig) {
+        case Q_EXIT_SIG: {
+            QActive_recall(&me->super, &me->deferred_queue);
             rtn = Q_HANDLED();
             break;
         }
+
         case PWM_REQUEST_ON_SIG: {
             const PwmServiceOnRequestEvent* event = (const PwmServiceOnRequestEvent*)e;
-            me->current_percent = event->percent;
-            rtn = Q_TRAN(&state_of_on);
+            storePendingRequest(event->channel, PENDING_ON, event->percent, EVENT_TAKE_STAMP(event));
+            rtn = Q_HANDLED();
             break;
         }
 
-        case PWM_REQUEST_FACTORY_TEST_SIG:{
-            const PwmServiceFactoryTestRequestEvent * event = (const PwmServiceFactoryTestRequestEvent*)e;
-            uint16_t id = PwmFactoryTest();
+        case PWM_REQUEST_OFF_SIG: {
+            const PwmServiceOffRequestEvent* event = (const PwmServiceOffRequestEvent*)e;
+            storePendingRequest(event->channel, PENDING_OFF, 0, EVENT_TAKE_STAMP(event));
+            rtn = Q_HANDLED();
+            break;
+        }
+
+        case PWM_REQUEST_RAMP_SIG: {
+            const PwmServiceRampRequestEvent* event = (const PwmServiceRampRequestEvent*)e;
+            Q_ASSERT(event->profile < PWM_SERVICE_RAMP_PROFILE_COUNT);
+            storePendingRequest(event->channel, PENDING_RAMP + event->profile, event->percent,
+                                EVENT_TAKE_STAMP(event));
+            rtn = Q_HANDLED();
+            break;
+        }
 
-            PwmServiceFactoryTestResponseEvent * response = Q_NEW(PwmServiceFactoryTestResponseEvent, event->response_sig);
-            response->test_passed = id != 0xFFFF; //should refactor to eliminate magic number
-            response->device_id = id;
+        case PWM_APPLY_PENDING_SIG: {
+            me->apply_pending_deferred = true;
+            rtn = Q_HANDLED();
+            break;
+        }
 
-            //post the response to the requester
-            QACTIVE_POST(event->requester, &response->super, 0);
+        case PWM_REQUEST_FACTORY_TEST_SIG: {
+            if (!QActive_defer(&me->super, &me->deferred_queue, e)) {
+                //too many held, the requester must not wait forever
+                const PwmServiceFactoryTestRequestEvent * event = (const PwmServiceFactoryTestRequestEvent*)e;
+                COUNT_DROP(PWM_SERVICE_DROP_FACTORY_TEST_REQUEST);
+                postFactoryTestResponse(event->requester, event->response_sig, event->response, 0xFFFF);
+            }
+            rtn = Q_HANDLED();
+            break;
+        }
 
+        case PWM_REFRESH_SIG: {
+            //stale, the refresh restarts when back on
             rtn = Q_HANDLED();
             break;
         }
@@ -111,46 +820,683 @@ QState state_of_off(PwmService * me, const QEvt* e)
     return rtn;
 }
 
-QState state_of_on(PwmService * me, const QEvt* e)
+static QState leaveHolding(PwmService * const me)
+{
+    if (me->apply_pending_deferred) {
+        //requests held meanwhile. The posted flag is still set,
+        //so this is the only wake up event in the queue.
+        me->apply_pending_deferred = false;
+        QACTIVE_POST(&me->super, &ApplyPendingEvent, &me->super);
+    }
+
+    return (me->on_count > 0) ? Q_TRAN(&state_of_on) : Q_TRAN(&state_of_off);
+}
+
+#ifdef PWM_SERVICE_ASYNC_DRIVER
+
+//Driver operations are in flight. Once every operation has
+//completed, the service settles in on or off.
+QState state_of_busy(PwmService * me, const QEvt* e)
 {
-    static const QEvt OnStatusEvent = QEVT_INITIALIZER(PWM_IS_ON_SIG);
     QState rtn;
 
     switch (e->sig) {
-        case Q_ENTRY_SIG: {
-            QTimeEvt_armX(&me->refresh_timer, TICKS_PER_REFRESH, TICKS_PER_REFRESH);
-            bool ok = PwmOn(me->current_percent);
-            Q_ASSERT(true == ok);
-            QF_PUBLISH(&OnStatusEvent, &me->super);
-            rtn = Q_HANDLED();
+        case PWM_DRIVER_DONE_SIG: {
+            const DriverDoneEvent* event = (const DriverDoneEvent*)e;
+            uint8_t const channel = event->channel;
+            uint8_t const op = me->op[channel];
+            Q_ASSERT(true == event->ok);
+            Q_ASSERT(op != OP_NONE);
+
+            me->op[channel] = OP_NONE;
+            --me->in_flight;
+            completeChannelOp(me, channel, op);
+            rtn = IS_BUSY(me) ? Q_HANDLED() : leaveHolding(me);
             break;
         }
-        case Q_EXIT_SIG: {
-            QTimeEvt_disarm(&me->refresh_timer);
-            rtn = Q_HANDLED();
+
+        case PWM_FACTORY_TEST_DONE_SIG: {
+            const FactoryTestDoneEvent* event = (const FactoryTestDoneEvent*)e;
+            postFactoryTestResponse(me->factory_requester, me->factory_response_sig,
+                                    me->factory_response, event->device_id);
+            --me->in_flight;
+            rtn = IS_BUSY(me) ? Q_HANDLED() : leaveHolding(me);
             break;
         }
 
-        case PWM_REQUEST_OFF_SIG:
-            rtn = Q_TRAN(&state_of_off);
+        default:
+            rtn = Q_SUPER(&state_of_holding);
             break;
+    }
 
-        case PWM_REFRESH_SIG: {
-            bool ok = PwmOn(me->current_percent);
-            Q_ASSERT(true == ok);
+    return rtn;
+}
+
+static void driverDone(void * const context, bool const ok)
+{
+    DriverDoneEvent * const event = (DriverDoneEvent *)context;
+    event->ok = ok;
+    QACTIVE_POST(&m_instance.super, &event->super, NULL);
+}
+
+static void factoryTestDone(void * const context, uint16_t const device_id)
+{
+    FactoryTestDoneEvent * const event = (FactoryTestDoneEvent *)context;
+    event->device_id = device_id;
+    QACTIVE_POST(&m_instance.super, &event->super, NULL);
+}
+
+#else
+
+//The factory test runs one bounded driver step per run to completion
+//step, so events queued meanwhile are not stuck behind the whole test.
+QState state_of_factory_test(PwmService * me, const QEvt* e)
+{
+    QState rtn;
+
+    switch (e->sig) {
+        case Q_ENTRY_SIG: {
+            me->factory_steps_done = 0;
+            PwmFactoryTestBegin(&me->factory_run);
+            QACTIVE_POST(&me->super, &FactoryTestStepEvent, &me->super);
             rtn = Q_HANDLED();
             break;
         }
-        case PWM_REQUEST_FACTORY_TEST_SIG:
-            //factory test is not supported when PWM is on
-            Q_ASSERT(true == false);
-            rtn = Q_HANDLED();
+
+        case PWM_FACTORY_TEST_STEP_SIG: {
+            bool const done = PwmFactoryTestStep(&me->factory_run);
+            ++me->factory_steps_done;
+            postFactoryTestProgress(me);
+
+            if (done) {
+                postFactoryTestResponse(me->factory_requester, me->factory_response_sig,
+                                        me->factory_response, me->factory_run.device_id);
+                rtn = leaveHolding(me);
+            }
+            else {
+                //queued behind any events which arrived during this step
+                QACTIVE_POST(&me->super, &FactoryTestStepEvent, &me->super);
+                rtn = Q_HANDLED();
+            }
             break;
+        }
 
         default:
-            rtn = Q_SUPER(&QHsm_top);
+            rtn = Q_SUPER(&state_of_holding);
             break;
     }
 
     return rtn;
 }
+
+static void postFactoryTestProgress(PwmService * const me)
+{
+    if (me->factory_progress_sig == 0U) {
+        return;
+    }
+
+    PwmServiceFactoryTestProgressEvent * const progress =
+        NEW_OUTPUT(PwmServiceFactoryTestProgressEvent, me->factory_progress_sig);
+    if (progress == NULL) {
+        COUNT_DROP(PWM_SERVICE_DROP_FACTORY_TEST_PROGRESS);
+        return;
+    }
+    progress->steps_done = me->factory_steps_done;
+    progress->steps_total = PWM_FACTORY_TEST_STEPS;
+    postOutput(me->factory_requester, &progress->super, PWM_SERVICE_DROP_FACTORY_TEST_PROGRESS);
+}
+
+#endif //PWM_SERVICE_ASYNC_DRIVER
+
+static void staticEventInit(QEvt * const event, enum_t const sig)
+{
+    static const QEvt StaticEventInit = QEVT_INITIALIZER(0);
+    *event = StaticEventInit;
+    event->sig = (QSignal)sig;
+}
+
+static void statusEventInit(PwmServiceStatusEvent * const event, enum_t const sig, uint8_t const channel)
+{
+    staticEventInit(&event->super, sig);
+    event->channel = channel;
+}
+
+static void postFactoryTestResponse(QActive * const requester, QSignal const sig,
+                                    PwmServiceFactoryTestResponseEvent * response, uint16_t const id)
+{
+    if (response == NULL) {
+        response = NEW_OUTPUT(PwmServiceFactoryTestResponseEvent, sig);
+        if (response == NULL) {
+            COUNT_DROP(PWM_SERVICE_DROP_FACTORY_TEST_RESPONSE);
+            return;
+        }
+    }
+    else {
+        //requester supplied the storage, no allocation
+        staticEventInit(&response->super, sig);
+    }
+    response->test_passed = id != 0xFFFF; //should refactor to eliminate magic number
+    response->device_id = id;
+
+    //post the response to the requester
+    postOutput(requester, &response->super, PWM_SERVICE_DROP_FACTORY_TEST_RESPONSE);
+}
+
+static void postOutput(QActive * const requester, QEvt const * const e, uint8_t const dropKind)
+{
+#ifdef PWM_SERVICE_BACKPRESSURE
+    if (!QACTIVE_POST_X(requester, e, PWM_SERVICE_OUTPUT_MARGIN, &m_instance.super)) {
+        //QF has recycled the event
+        countDrop(dropKind);
+    }
+#else
+    (void)dropKind;
+    QACTIVE_POST(requester, e, &m_instance.super);
+#endif
+}
+
+#ifdef PWM_SERVICE_BACKPRESSURE
+bool PwmService_postRequest(QEvt const * const e)
+{
+    uint8_t kind;
+    switch (e->sig) {
+        case PWM_REQUEST_ON_SIG:
+            kind = PWM_SERVICE_DROP_ON_REQUEST;
+            break;
+        case PWM_REQUEST_OFF_SIG:
+            kind = PWM_SERVICE_DROP_OFF_REQUEST;
+            break;
+        case PWM_REQUEST_RAMP_SIG:
+            kind = PWM_SERVICE_DROP_RAMP_REQUEST;
+            break;
+        case PWM_REQUEST_FACTORY_TEST_SIG:
+            kind = PWM_SERVICE_DROP_FACTORY_TEST_REQUEST;
+            break;
+        default:
+            kind = PWM_SERVICE_DROP_KIND_COUNT;
+            break;
+    }
+    Q_ASSERT(kind < PWM_SERVICE_DROP_KIND_COUNT);
+
+    if (QACTIVE_POST_X(&m_instance.super, e, PWM_SERVICE_POST_MARGIN, NULL)) {
+        return true;
+    }
+
+    //QF has recycled the event
+    countDrop(kind);
+    return false;
+}
+
+void PwmService_getDropStats(PwmServiceDropStats * const stats)
+{
+    for (uint8_t kind = 0; kind < PWM_SERVICE_DROP_KIND_COUNT; ++kind) {
+        stats->dropped[kind] = (uint32_t)atomic_load_explicit(&m_dropped[kind], memory_order_relaxed);
+    }
+    stats->overloaded = atomic_load_explicit(&m_overloaded, memory_order_relaxed);
+}
+
+void PwmService_resetDropStats()
+{
+    for (uint8_t kind = 0; kind < PWM_SERVICE_DROP_KIND_COUNT; ++kind) {
+        atomic_store_explicit(&m_dropped[kind], 0U, memory_order_relaxed);
+    }
+    atomic_store_explicit(&m_overloaded, false, memory_order_relaxed);
+}
+
+void PwmService_setOverloadObserver(QActive * const observer, QSignal const sig)
+{
+    m_overloadObserver = observer;
+    statusEventInit(&m_overloadStatusEvent, sig, PWM_SERVICE_ALL_CHANNELS);
+}
+
+static void countDrop(uint8_t const kind)
+{
+    atomic_fetch_add_explicit(&m_dropped[kind], 1U, memory_order_relaxed);
+
+    //reported once per overload, until the counters are reset. Posted
+    //with a margin, so that a full observer queue loses the report
+    //rather than asserting, possibly from the ISR of a dropped request.
+    if (!atomic_exchange_explicit(&m_overloaded, true, memory_order_relaxed) && (m_overloadObserver != NULL)) {
+        (void)QACTIVE_POST_X(m_overloadObserver, &m_overloadStatusEvent.super, PWM_SERVICE_OUTPUT_MARGIN, NULL);
+    }
+}
+#endif //PWM_SERVICE_BACKPRESSURE
+
+#ifndef PWM_SERVICE_ASYNC_DRIVER
+static bool driverOn(uint8_t const channel, PwmServiceDuty const percent)
+{
+#ifdef PWM_SERVICE_FIXED_POINT_DUTY
+    return PwmOnDuty(channel, percent);
+#else
+    return PwmOn(channel, percent);
+#endif
+}
+#endif
+
+// Turn a channel on (or re-program it) or off. With the synchronous
+// driver the operation has completed on return, otherwise it completes
+// in state_of_busy.
+static void driveChannel(PwmService * const me, uint8_t const channel, uint8_t const op)
+{
+    LATENCY_START(me, channel);
+
+#ifdef PWM_SERVICE_ASYNC_DRIVER
+    Q_ASSERT(me->op[channel] == OP_NONE);
+    me->op[channel] = op;
+    ++me->in_flight;
+
+    DriverDoneEvent * const done = &m_driverDoneEvents[channel];
+    bool const ok = (op == OP_OFF) ?
+                    PwmOffAsync(channel, &driverDone, done) :
+                    PwmOnDutyAsync(channel, me->expected_duty[channel], &driverDone, done);
+    Q_ASSERT(true == ok);
+#else
+    bool ok;
+    if (op == OP_OFF) {
+        ok = PwmOff(channel);
+    }
+    else if (op == OP_RAMP) {
+        ok = PwmOnDuty(channel, me->expected_duty[channel]);
+    }
+    else {
+        ok = driverOn(channel, me->current_percent[channel]);
+    }
+    Q_ASSERT(true == ok);
+    completeChannelOp(me, channel, op);
+#endif
+}
+
+static void completeChannelOp(PwmService * const me, uint8_t const channel, uint8_t const op)
+{
+    if (op == OP_ON) {
+        LATENCY_SAMPLE(me, channel);
+        updateSnapshot(me, channel);
+        publishStatus(&m_onStatusEvents[channel]);
+    }
+    else if (op == OP_RAMP_DONE) {
+        updateSnapshot(me, channel);
+        publishStatus(&m_onStatusEvents[channel]);
+    }
+    else if (op == OP_OFF) {
+        LATENCY_SAMPLE(me, channel);
+        updateSnapshot(me, channel);
+        publishStatus(&m_offStatusEvents[channel]);
+    }
+}
+
+static void publishStatus(PwmServiceStatusEvent const * const status)
+{
+    TRACE_PUBLISH(status);
+    QF_PUBLISH(&status->super, &m_instance.super);
+}
+
+static void updateSnapshot(PwmService const * const me, uint8_t const channel)
+{
+    uint_fast32_t const sequence = atomic_load_explicit(&m_snapshot.sequence, memory_order_relaxed);
+    atomic_store_explicit(&m_snapshot.sequence, sequence + 1U, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    for (uint8_t ch = 0; ch < PWM_SERVICE_CHANNEL_COUNT; ++ch) {
+        if ((channel == PWM_SERVICE_ALL_CHANNELS) || (channel == ch)) {
+            bool const on = me->is_on[ch];
+            atomic_store_explicit(&m_snapshot.is_on[ch], on, memory_order_relaxed);
+            atomic_store_explicit(&m_snapshot.percent[ch], on ? me->current_percent[ch] : 0,
+                                  memory_order_relaxed);
+        }
+    }
+
+    atomic_store_explicit(&m_snapshot.sequence, sequence + 2U, memory_order_release);
+}
+
+bool PwmService_getStatusSnapshot(PwmServiceStatusSnapshot * const snapshot)
+{
+    Q_ASSERT(snapshot != NULL);
+
+    for (unsigned attempt = 0; attempt < PWM_SERVICE_SNAPSHOT_RETRIES; ++attempt) {
+        uint_fast32_t const before = atomic_load_explicit(&m_snapshot.sequence, memory_order_acquire);
+        if ((before & 1U) != 0U) {
+            continue; //update in progress
+        }
+
+        for (uint8_t ch = 0; ch < PWM_SERVICE_CHANNEL_COUNT; ++ch) {
+            snapshot->is_on[ch] = atomic_load_explicit(&m_snapshot.is_on[ch], memory_order_relaxed);
+            snapshot->percent[ch] = atomic_load_explicit(&m_snapshot.percent[ch], memory_order_relaxed);
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&m_snapshot.sequence, memory_order_relaxed) == before) {
+            snapshot->change_count = (uint32_t)(before / 2U);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static uint16_t toDuty(PwmServiceDuty const percent)
+{
+#ifdef PWM_SERVICE_FIXED_POINT_DUTY
+    return percent;
+#else
+    return PwmPercentToDuty(percent);
+#endif
+}
+
+static void restartRefresh(PwmService * const me)
+{
+    me->refresh_ticks = (me->ramp_count > 0U) ? RAMP_TICKS : REFRESH_MIN_TICKS;
+    REFRESH_TIMER_DISARM(me);
+    REFRESH_TIMER_ARM(me);
+    TRACE_TIMER_ARM(me);
+}
+
+// Read back every channel which is on, and re-program any channel
+// which has drifted. Returns true if any channel had drifted.
+static bool verifyChannels(PwmService * const me)
+{
+    bool drifted = false;
+
+    for (uint8_t channel = 0; channel < PWM_SERVICE_CHANNEL_COUNT; ++channel) {
+        if (!me->is_on[channel]) {
+            continue;
+        }
+
+        bool enabled = false;
+        uint16_t duty = 0;
+        bool ok = PwmReadback(channel, &enabled, &duty);
+        Q_ASSERT(true == ok);
+
+        if (!enabled || (duty != me->expected_duty[channel])) {
+            drifted = true;
+
+            //the driver's shadow no longer matches the hardware
+            PwmForceRefresh(channel);
+            driveChannel(me, channel, OP_REFRESH);
+        }
+    }
+
+    return drifted;
+}
+
+static void channelOn(PwmService * const me, uint8_t const channel, PwmServiceDuty const percent)
+{
+    Q_ASSERT(channel < PWM_SERVICE_CHANNEL_COUNT);
+
+    stopRamp(me, channel);
+
+    me->current_percent[channel] = percent;
+    me->expected_duty[channel] = toDuty(percent);
+    if (!me->is_on[channel]) {
+        me->is_on[channel] = true;
+        ++me->on_count;
+    }
+
+    driveChannel(me, channel, OP_ON);
+}
+
+static void channelOff(PwmService * const me, uint8_t const channel)
+{
+    Q_ASSERT(channel < PWM_SERVICE_CHANNEL_COUNT);
+
+    stopRamp(me, channel);
+
+    if (!me->is_on[channel]) {
+        //already off, nothing to do
+        return;
+    }
+
+    me->is_on[channel] = false;
+    --me->on_count;
+
+    driveChannel(me, channel, OP_OFF);
+}
+
+static void channelRamp(PwmService * const me, uint8_t const channel, PwmServiceDuty const percent,
+                        uint8_t const profile)
+{
+    Q_ASSERT(channel < PWM_SERVICE_CHANNEL_COUNT);
+    Q_ASSERT(profile < PWM_SERVICE_RAMP_PROFILE_COUNT);
+
+    //ramp from the present duty cycle
+    me->ramp_from[channel] = me->is_on[channel] ? me->expected_duty[channel] : 0U;
+    me->ramp_to[channel] = toDuty(percent);
+    me->ramp_profile[channel] = profile;
+    me->ramp_next_step[channel] = 0U;
+    if (!me->ramping[channel]) {
+        me->ramping[channel] = true;
+        ++me->ramp_count;
+    }
+
+    me->current_percent[channel] = percent;
+    if (!me->is_on[channel]) {
+        me->is_on[channel] = true;
+        ++me->on_count;
+    }
+
+    //the first step is taken right away
+    advanceRamp(me, channel);
+}
+
+// Take the next step of a channel's ramp, a table lookup scaled
+// to the ramp's span. The last step is exactly the requested duty.
+static void advanceRamp(PwmService * const me, uint8_t const channel)
+{
+    uint8_t const step = me->ramp_next_step[channel]++;
+    if (step + 1U >= PWM_RAMP_TABLE_STEPS) {
+        stopRamp(me, channel);
+        me->expected_duty[channel] = me->ramp_to[channel];
+        driveChannel(me, channel, OP_RAMP_DONE);
+        return;
+    }
+
+    uint32_t const progress = g_pwmRampTables[me->ramp_profile[channel]][step];
+    uint16_t const from = me->ramp_from[channel];
+    uint16_t const to = me->ramp_to[channel];
+    if (to >= from) {
+        me->expected_duty[channel] = (uint16_t)(from + (((uint32_t)(to - from) * progress) >> 16U));
+    }
+    else {
+        me->expected_duty[channel] = (uint16_t)(from - (((uint32_t)(from - to) * progress) >> 16U));
+    }
+    driveChannel(me, channel, OP_RAMP);
+}
+
+static void stopRamp(PwmService * const me, uint8_t const channel)
+{
+    if (me->ramping[channel]) {
+        me->ramping[channel] = false;
+        --me->ramp_count;
+    }
+}
+
+static void storePendingRequest(uint8_t const channel, uint8_t const request, PwmServiceDuty const percent,
+                                uint32_t const timestamp)
+{
+    Q_ASSERT(channel < PWM_SERVICE_CHANNEL_COUNT);
+
+    bool post;
+    QF_CRIT_STAT
+    QF_CRIT_ENTRY();
+    m_instance.pending_request[channel] = request;
+    m_instance.pending_percent[channel] = percent;
+#ifdef PWM_SERVICE_LATENCY_TRACE
+    m_instance.pending_timestamp[channel] = timestamp;
+#else
+    (void)timestamp;
+#endif
+    post = !m_instance.apply_pending_posted;
+    m_instance.apply_pending_posted = true;
+    QF_CRIT_EXIT();
+
+    //only the first request of a burst occupies a queue slot
+    if (post) {
+        QACTIVE_POST(&m_instance.super, &ApplyPendingEvent, NULL);
+    }
+}
+
+static void applyPendingRequests(PwmService * const me)
+{
+    QF_CRIT_STAT
+
+    //clear the posted flag first, so requests arriving
+    //while applying will post a new wake up event.
+    QF_CRIT_ENTRY();
+    me->apply_pending_posted = false;
+    QF_CRIT_EXIT();
+
+    for (uint8_t channel = 0; channel < PWM_SERVICE_CHANNEL_COUNT; ++channel) {
+        QF_CRIT_ENTRY();
+        uint8_t const request = me->pending_request[channel];
+        PwmServiceDuty const percent = me->pending_percent[channel];
+        me->pending_request[channel] = PENDING_NONE;
+        LATENCY_REQUEST(me, me->pending_timestamp[channel]);
+        QF_CRIT_EXIT();
+
+        if (request == PENDING_ON) {
+            channelOn(me, channel, percent);
+        }
+        else if (request == PENDING_OFF) {
+            channelOff(me, channel);
+        }
+        else if (request >= PENDING_RAMP) {
+            channelRamp(me, channel, percent, request - PENDING_RAMP);
+        }
+    }
+}
+
+#ifdef PWM_SERVICE_LATENCY_TRACE
+
+static uint32_t requestTimestamp(void)
+{
+    uint32_t const timestamp = PwmService_latencyTimestamp();
+    return (timestamp != UNSTAMPED) ? timestamp : UNSTAMPED + 1U;
+}
+
+static uint32_t takeStamp(uint32_t const * const timestamp)
+{
+    //the service is the only consumer of a request's stamp
+    uint32_t const stamp = *timestamp;
+    *(uint32_t *)timestamp = UNSTAMPED;
+    return stamp;
+}
+
+static void latencySample(PwmService const * const me, uint8_t const channel)
+{
+    if (me->op_timestamp[channel] == UNSTAMPED) {
+        uint_fast32_t const unstamped = atomic_load_explicit(&m_latencyRing.unstamped, memory_order_relaxed);
+        atomic_store_explicit(&m_latencyRing.unstamped, unstamped + 1U, memory_order_relaxed);
+        return;
+    }
+
+    uint32_t const sample = PwmService_latencyTimestamp() - me->op_timestamp[channel];
+
+    uint_fast32_t const head = atomic_load_explicit(&m_latencyRing.head, memory_order_relaxed);
+    uint_fast32_t const tail = atomic_load_explicit(&m_latencyRing.tail, memory_order_acquire);
+    if ((uint32_t)(head - tail) >= PWM_SERVICE_LATENCY_RING_SIZE) {
+        uint_fast32_t const dropped = atomic_load_explicit(&m_latencyRing.dropped, memory_order_relaxed);
+        atomic_store_explicit(&m_latencyRing.dropped, dropped + 1U, memory_order_relaxed);
+        return;
+    }
+
+    m_latencyRing.samples[head & (PWM_SERVICE_LATENCY_RING_SIZE - 1U)] = sample;
+    atomic_store_explicit(&m_latencyRing.head, head + 1U, memory_order_release);
+}
+
+static uint32_t latencyBucket(uint32_t const sample)
+{
+    uint32_t bucket = 0U;
+    for (uint32_t value = sample; value != 0U; value >>= 1U) {
+        ++bucket;
+    }
+    return bucket; //bucket n holds [2^(n-1) .. 2^n - 1]
+}
+
+static uint32_t latencyPercentile(uint32_t const percent)
+{
+    LatencyHistogram const * const h = &m_latencyHistogram;
+    uint32_t const rank = (uint32_t)(((uint64_t)h->count * percent + 99U) / 100U);
+    uint32_t seen = 0U;
+    for (uint32_t bucket = 0U; bucket < LATENCY_BUCKETS; ++bucket) {
+        seen += h->buckets[bucket];
+        if ((seen >= rank) && (seen != 0U)) {
+            uint32_t const upper = (bucket == 0U) ? 0U :
+                                   (bucket == 32U) ? UINT32_MAX : ((1U << bucket) - 1U);
+            return (upper < h->max) ? upper : h->max;
+        }
+    }
+    return h->max;
+}
+
+void PwmService_getLatencyStats(PwmServiceLatencyStats* stats)
+{
+    LatencyHistogram * const h = &m_latencyHistogram;
+
+    //drain the ring into the histogram
+    uint_fast32_t tail = atomic_load_explicit(&m_latencyRing.tail, memory_order_relaxed);
+    uint_fast32_t const head = atomic_load_explicit(&m_latencyRing.head, memory_order_acquire);
+    while (tail != head) {
+        uint32_t const sample = m_latencyRing.samples[tail & (PWM_SERVICE_LATENCY_RING_SIZE - 1U)];
+        ++h->buckets[latencyBucket(sample)];
+        if ((h->count == 0U) || (sample < h->min)) {
+            h->min = sample;
+        }
+        if (sample > h->max) {
+            h->max = sample;
+        }
+        ++h->count;
+        ++tail;
+    }
+    atomic_store_explicit(&m_latencyRing.tail, tail, memory_order_release);
+
+    stats->count = h->count;
+    stats->dropped = (uint32_t)atomic_load_explicit(&m_latencyRing.dropped, memory_order_relaxed) - h->dropped_at_reset;
+    stats->unstamped =
+        (uint32_t)atomic_load_explicit(&m_latencyRing.unstamped, memory_order_relaxed) - h->unstamped_at_reset;
+    stats->min = h->min;
+    stats->max = h->max;
+    stats->p50 = latencyPercentile(50U);
+    stats->p90 = latencyPercentile(90U);
+    stats->p99 = latencyPercentile(99U);
+}
+
+void PwmService_resetLatencyStats()
+{
+    PwmServiceLatencyStats discard;
+    PwmService_getLatencyStats(&discard);
+
+    LatencyHistogram * const h = &m_latencyHistogram;
+    for (uint32_t bucket = 0U; bucket < LATENCY_BUCKETS; ++bucket) {
+        h->buckets[bucket] = 0U;
+    }
+    h->count = 0U;
+    h->min = 0U;
+    h->max = 0U;
+    h->dropped_at_reset = (uint32_t)atomic_load_explicit(&m_latencyRing.dropped, memory_order_relaxed);
+    h->unstamped_at_reset = (uint32_t)atomic_load_explicit(&m_latencyRing.unstamped, memory_order_relaxed);
+}
+
+#endif //PWM_SERVICE_LATENCY_TRACE
+
+#ifdef PWM_SERVICE_TRACE
+
+#define SIGNAL_NAME(sig_) [sig_] = #sig_,
+
+static char const * const m_signalNames[MAX_PWM_INTERNAL_SIG] = {
+    SIGNAL_NAME(Q_ENTRY_SIG)
+    SIGNAL_NAME(Q_EXIT_SIG)
+    SIGNAL_NAME(Q_INIT_SIG)
+    PUB_SUB_SIGNALS(SIGNAL_NAME)
+    SIGNAL_NAME(PWM_REQUEST_FACTORY_TEST_SIG)
+    SIGNAL_NAME(PWM_REFRESH_SIG)
+    SIGNAL_NAME(PWM_APPLY_PENDING_SIG)
+    SIGNAL_NAME(PWM_DRIVER_DONE_SIG)
+    SIGNAL_NAME(PWM_FACTORY_TEST_DONE_SIG)
+    SIGNAL_NAME(PWM_FACTORY_TEST_STEP_SIG)
+};
+
+char const * PwmService_signalName(QSignal const sig)
+{
+    return (sig < Q_DIM(m_signalNames)) ? m_signalNames[sig] : NULL;
+}
+
+#endif //PWM_SERVICE_TRACE
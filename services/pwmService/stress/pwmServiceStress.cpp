@@ -0,0 +1,427 @@
+/// @brief  Multi-threaded stress harness of the PwmService, on the real
+///         QP/C POSIX port with the no-op PWM driver. For each number of
+///         producer threads (1, 2, 4, ... up to the number of cores):
+///           - on_off: every producer posts on and off requests, as fast
+///             as it can, for a fixed period.
+///           - factory_test: every producer posts factory test requests,
+///             serialized by the harness (see FactoryTestProducer()).
+///         Reports the sustained throughput of the service, the queue
+///         overflow rate, and the event pool contention (exhausted pool
+///         and the mean cost of an allocation) as JSON.
+///
+///         usage: PwmServiceStress [seconds per phase] [max producers]
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#include "qpc.h"
+#include "pwmService.h"
+#include "pwm.h"
+#include "pwmServicePools.hpp"
+#include "cmsPwmServiceHarness.hpp"
+#include "bspTicks.h"
+#include "pub_sub_signals.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+Q_DEFINE_THIS_MODULE("pwmServiceStress")
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+constexpr uint_fast8_t REQUESTER_PRIORITY = 1U;
+constexpr uint_fast8_t SERVICE_PRIORITY   = 2U;
+constexpr int TICKER_THREAD_PRIORITY      = 30;
+
+constexpr size_t SERVICE_QUEUE_LENGTH = 32;
+constexpr size_t EVENTS_PER_POOL      = 256;
+constexpr unsigned MAX_PRODUCERS      = 64;
+
+// Producers leave room in the service's queue for its refresh timer
+// event, which is posted without a margin (and would assert on overflow).
+constexpr uint_fast16_t QUEUE_MARGIN = 2U;
+constexpr uint_fast16_t POOL_MARGIN  = 1U;
+
+constexpr QSignal FACTORY_RESPONSE_SIG = MAX_PWM_POSTED_SIGNALS;
+
+cms::EventPoolStorage<PwmServiceEventPools, EVENTS_PER_POOL> l_poolSto;
+QSubscrList l_subscrSto[MAX_PUB_SUB_SIG];
+std::array<QEvt const*, SERVICE_QUEUE_LENGTH> l_serviceQueueSto;
+
+// The service accepts one factory test at a time (one deferred request),
+// so the factory test producers take turns holding this token.
+std::mutex l_factoryMutex;
+std::condition_variable l_factoryIdle;
+bool l_factoryOutstanding = false;
+std::atomic<uint64_t> l_factoryResponses{0};
+
+void ReleaseFactoryToken()
+{
+    {
+        std::lock_guard<std::mutex> lock(l_factoryMutex);
+        l_factoryOutstanding = false;
+    }
+    l_factoryIdle.notify_all();
+}
+
+// The requester of the factory tests, receives the responses.
+struct Requester
+{
+    QActive super;
+    std::array<QEvt const*, 8> queueStorage;
+
+    static QState initial(Requester* const me, void const* const par)
+    {
+        Q_UNUSED_PAR(par);
+        return Q_TRAN(&active);
+    }
+
+    static QState active(Requester* const me, QEvt const* const e)
+    {
+        switch (e->sig) {
+            case Q_ENTRY_SIG:
+            case Q_EXIT_SIG:
+                return Q_HANDLED();
+            case FACTORY_RESPONSE_SIG:
+                l_factoryResponses.fetch_add(1U, std::memory_order_relaxed);
+                ReleaseFactoryToken();
+                return Q_HANDLED();
+            default:
+                break;
+        }
+        return Q_SUPER(&QHsm_top);
+    }
+};
+
+Requester l_requester;
+
+std::mutex l_startedMutex;
+std::condition_variable l_startedCondition;
+bool l_started = false;
+
+// per producer counters, one cache line each
+struct alignas(64) ProducerStats
+{
+    uint64_t attempts;
+    uint64_t posted;
+    uint64_t queueFull;
+    uint64_t poolEmpty;
+    Clock::duration allocTime;
+    Clock::duration postTime;
+};
+
+std::array<ProducerStats, MAX_PRODUCERS> l_producerStats;
+
+struct PhaseResult
+{
+    const char* phase;
+    unsigned producers;
+    double seconds;
+    ProducerStats total;
+    uint64_t dispatched;
+    uint64_t factoryTests;
+};
+
+PwmServiceDuty StressDuty(float percent)
+{
+#ifdef PWM_SERVICE_FIXED_POINT_DUTY
+    return PwmPercentToDuty(percent);
+#else
+    return percent;
+#endif
+}
+
+QEvt const* NewRequest(bool on, uint8_t channel, float percent)
+{
+    if (on) {
+        auto e = PwmService_newOnRequest(POOL_MARGIN, channel, StressDuty(percent));
+        return (e != nullptr) ? &e->super : nullptr;
+    }
+
+    auto e = PwmService_newOffRequest(POOL_MARGIN, channel);
+    return (e != nullptr) ? &e->super : nullptr;
+}
+
+// Posts (rather than publishes) so that a full queue is counted as an
+// overflow, where a publish to a full queue is an assertion.
+void OnOffProducer(unsigned index, std::atomic<bool> const& run)
+{
+    auto& stats = l_producerStats[index];
+    std::mt19937 random(index + 1U);
+    std::uniform_real_distribution<float> percents(0.0f, 1.0f);
+    auto const channel = static_cast<uint8_t>(index % PWM_SERVICE_CHANNEL_COUNT);
+    bool on = true;
+
+    while (run.load(std::memory_order_relaxed)) {
+        ++stats.attempts;
+        auto const t0 = Clock::now();
+        QEvt const* e = NewRequest(on, channel, percents(random));
+        auto const t1 = Clock::now();
+        stats.allocTime += t1 - t0;
+        if (e == nullptr) {
+            ++stats.poolEmpty;
+            continue;
+        }
+
+        bool const posted = QACTIVE_POST_X(g_thePwmService, e, QUEUE_MARGIN, nullptr);
+        stats.postTime += Clock::now() - t1;
+        if (posted) {
+            ++stats.posted;
+            on = !on;
+        }
+        else {
+            ++stats.queueFull; //the event was recycled by QF
+        }
+    }
+}
+
+void FactoryTestProducer(unsigned index, std::atomic<bool> const& run)
+{
+    auto& stats = l_producerStats[index];
+
+    while (run.load(std::memory_order_relaxed)) {
+        {
+            std::unique_lock<std::mutex> lock(l_factoryMutex);
+            l_factoryIdle.wait(lock, [&run] {
+                return !l_factoryOutstanding || !run.load(std::memory_order_relaxed);
+            });
+            if (!run.load(std::memory_order_relaxed)) {
+                break;
+            }
+            l_factoryOutstanding = true;
+        }
+
+        ++stats.attempts;
+        auto const t0 = Clock::now();
+        auto e = Q_NEW_X(PwmServiceFactoryTestRequestEvent, POOL_MARGIN, PWM_REQUEST_FACTORY_TEST_SIG);
+        auto const t1 = Clock::now();
+        stats.allocTime += t1 - t0;
+        if (e == nullptr) {
+            ++stats.poolEmpty;
+            ReleaseFactoryToken();
+            continue;
+        }
+        e->requester = &l_requester.super;
+        e->response_sig = FACTORY_RESPONSE_SIG;
+        e->response = nullptr;
+        e->progress_sig = 0;
+
+        bool const posted = QACTIVE_POST_X(g_thePwmService, &e->super, QUEUE_MARGIN, nullptr);
+        stats.postTime += Clock::now() - t1;
+        if (posted) {
+            ++stats.posted;
+        }
+        else {
+            ++stats.queueFull;
+            ReleaseFactoryToken();
+        }
+    }
+}
+
+// The service is idle once its queue stays empty and no
+// event was dispatched in the meantime.
+void WaitForServiceIdle()
+{
+    for (;;) {
+        uint64_t const dispatched = cms::test::DispatchCounter::Count();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+        QF_CRIT_STAT
+        QF_CRIT_ENTRY();
+        bool const empty = (g_thePwmService->eQueue.frontEvt == nullptr);
+        QF_CRIT_EXIT();
+
+        if (empty && (dispatched == cms::test::DispatchCounter::Count())) {
+            return;
+        }
+    }
+}
+
+PhaseResult RunPhase(const char* phase, unsigned producers, double seconds,
+                     void (*producer)(unsigned, std::atomic<bool> const&))
+{
+    l_producerStats.fill(ProducerStats{});
+    uint64_t const dispatchedBefore = cms::test::DispatchCounter::Count();
+    uint64_t const factoryBefore = l_factoryResponses.load();
+
+    std::atomic<bool> run{true};
+    std::vector<std::thread> threads;
+    auto const start = Clock::now();
+    for (unsigned i = 0; i < producers; ++i) {
+        threads.emplace_back(producer, i, std::cref(run));
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    {
+        std::lock_guard<std::mutex> lock(l_factoryMutex);
+        run = false;
+    }
+    l_factoryIdle.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(l_factoryMutex);
+        l_factoryIdle.wait(lock, [] { return !l_factoryOutstanding; });
+    }
+    WaitForServiceIdle();
+    auto const elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    PhaseResult result{phase, producers, elapsed, ProducerStats{},
+                       cms::test::DispatchCounter::Count() - dispatchedBefore,
+                       l_factoryResponses.load() - factoryBefore};
+    for (unsigned i = 0; i < producers; ++i) {
+        auto const& s = l_producerStats[i];
+        result.total.attempts += s.attempts;
+        result.total.posted += s.posted;
+        result.total.queueFull += s.queueFull;
+        result.total.poolEmpty += s.poolEmpty;
+        result.total.allocTime += s.allocTime;
+        result.total.postTime += s.postTime;
+    }
+    return result;
+}
+
+// the factory test is only accepted while every channel is off
+void TurnAllChannelsOff()
+{
+    for (uint8_t channel = 0; channel < PWM_SERVICE_CHANNEL_COUNT; ++channel) {
+        auto e = PwmService_newOffRequest(QF_NO_MARGIN, channel);
+        QACTIVE_POST(g_thePwmService, &e->super, nullptr);
+    }
+    WaitForServiceIdle();
+}
+
+double NsPer(Clock::duration total, uint64_t count)
+{
+    return (count == 0U) ? 0.0 : std::chrono::duration<double, std::nano>(total).count() / count;
+}
+
+void PrintResults(const std::vector<PhaseResult>& results, double seconds)
+{
+    printf("{\"pwm_service_stress\":{\"cores\":%u,\"seconds_per_phase\":%.3f,\"results\":[\n",
+           std::thread::hardware_concurrency(), seconds);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        const auto attempts = static_cast<double>(std::max<uint64_t>(r.total.attempts, 1U));
+        printf("%s{\"phase\":\"%s\",\"producers\":%u,\"seconds\":%.3f,\"attempts\":%llu,"
+               "\"posted\":%llu,\"queue_full\":%llu,\"pool_empty\":%llu,\"overflow_rate\":%.4f,"
+               "\"dispatched_per_s\":%.0f,\"factory_tests_per_s\":%.0f,\"alloc_ns\":%.1f,\"post_ns\":%.1f}",
+               (i == 0) ? "" : ",\n", r.phase, r.producers, r.seconds,
+               static_cast<unsigned long long>(r.total.attempts),
+               static_cast<unsigned long long>(r.total.posted),
+               static_cast<unsigned long long>(r.total.queueFull),
+               static_cast<unsigned long long>(r.total.poolEmpty),
+               static_cast<double>(r.total.queueFull) / attempts,
+               static_cast<double>(r.dispatched) / r.seconds,
+               static_cast<double>(r.factoryTests) / r.seconds,
+               NsPer(r.total.allocTime, r.total.attempts),
+               NsPer(r.total.postTime, r.total.attempts - r.total.poolEmpty));
+    }
+    printf("]}}\n");
+}
+
+void RunStress(double seconds, unsigned maxProducers)
+{
+    //wait for QF_run(), then for the service's initial transition
+    {
+        std::unique_lock<std::mutex> lock(l_startedMutex);
+        l_startedCondition.wait(lock, [] { return l_started; });
+    }
+    PwmServiceStatusSnapshot snapshot{};
+    while (!PwmService_getStatusSnapshot(&snapshot) || (snapshot.change_count == 0U)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::vector<PhaseResult> results;
+    for (unsigned producers = 1; producers <= maxProducers; producers *= 2) {
+        results.push_back(RunPhase("on_off", producers, seconds, &OnOffProducer));
+        TurnAllChannelsOff();
+        results.push_back(RunPhase("factory_test", producers, seconds, &FactoryTestProducer));
+    }
+
+    PrintResults(results, seconds);
+    QF_stop();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    double const seconds = (argc > 1) ? atof(argv[1]) : 1.0;
+    unsigned maxProducers = (argc > 2) ? static_cast<unsigned>(atoi(argv[2]))
+                                       : std::thread::hardware_concurrency();
+    maxProducers = std::min(std::max(maxProducers, 1U), MAX_PRODUCERS);
+
+    QF_init();
+    QActive_psInit(l_subscrSto, Q_DIM(l_subscrSto));
+    l_poolSto.init();
+
+    l_requester.queueStorage.fill(nullptr);
+    QActive_ctor(&l_requester.super, Q_STATE_CAST(&Requester::initial));
+    QACTIVE_START(&l_requester.super, REQUESTER_PRIORITY,
+                  l_requester.queueStorage.data(), l_requester.queueStorage.size(),
+                  nullptr, 0, nullptr);
+
+    PwmService_ctor();
+    cms::test::DispatchCounter::Attach(g_thePwmService);
+
+    l_serviceQueueSto.fill(nullptr);
+    QACTIVE_START(g_thePwmService, SERVICE_PRIORITY,
+                  l_serviceQueueSto.data(), l_serviceQueueSto.size(),
+                  nullptr, 0, nullptr);
+
+    std::thread director(&RunStress, seconds, maxProducers);
+    int const status = QF_run(); //returns once QF_stop() is called
+    director.join();
+    return status;
+}
+
+extern "C" {
+
+void QF_onStartup(void)
+{
+    QF_setTickRate(BSP_TICKS_PER_SECOND, TICKER_THREAD_PRIORITY);
+    {
+        std::lock_guard<std::mutex> lock(l_startedMutex);
+        l_started = true;
+    }
+    l_startedCondition.notify_all();
+}
+
+void QF_onCleanup(void)
+{
+}
+
+void QF_onClockTick(void)
+{
+    QTIMEEVT_TICK_X(0U, nullptr);
+}
+
+void Q_onError(char const* const module, int_t const id)
+{
+    fprintf(stderr, "PwmServiceStress: QP error in %s:%d\n", module, static_cast<int>(id));
+    abort();
+}
+
+} // extern "C"
@@ -0,0 +1,202 @@
+/// @brief  Soak tests for the PWM Service, simulating hours of operation.
+///         Built with the recording fake of the PWM driver (see
+///         pwmRecordingFake.hpp) instead of the cpputest mock, since the
+///         mock's per call expectation matching is far too slow for
+///         the number of driver calls in a long simulation.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+/// Copyright (C) 2024 Matthew Eshleman. All rights reserved.
+///
+/// This program is open source software: you can redistribute it and/or
+/// modify it under the terms of the GNU General Public License as published
+/// by the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// Alternatively, upon written permission from Matthew Eshleman, this program
+/// may be distributed and modified under the terms of a Commercial
+/// License. For further details, see the Contact Information below.
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#include "qpc.h"
+#include "pwmService.h"
+#include "pwm.h"
+#include "cms_cpputest_qf_ctrl.hpp"
+#include "cmsTestPublishedEventRecorder.hpp"
+#include "bspTicks.h"
+#include "pub_sub_signals.h"
+#include "pwmRecordingFake.hpp"
+#include "pwmServicePools.hpp"
+#include "cmsPwmServiceHarness.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+// the cpputest headers must always be last
+#include "CppUTest/TestHarness.h"
+
+using namespace std::chrono_literals;
+using Call = cms::test::PwmRecordingFake::Call;
+
+// The verify (read back) schedule of a channel that never drifts:
+// 250, 750, 1750, 3750 and 7750 ms, then every 4000 ms.
+static size_t ExpectedReadbacks(std::chrono::milliseconds onTime)
+{
+    constexpr std::array<long, 5> BACK_OFF_MS = {250, 750, 1750, 3750, 7750};
+    constexpr long MAX_INTERVAL_MS = 4000;
+
+    auto ms = static_cast<long>(onTime.count());
+    auto count = static_cast<size_t>(
+      std::count_if(BACK_OFF_MS.begin(), BACK_OFF_MS.end(), [ms](long t) { return t <= ms; }));
+    if (ms > BACK_OFF_MS.back()) {
+        count += static_cast<size_t>((ms - BACK_OFF_MS.back()) / MAX_INTERVAL_MS);
+    }
+    return count;
+}
+
+TEST_GROUP(PwmServiceSoakTests)
+{
+    QActive* mUnderTest         = nullptr;
+    std::array<const QEvt*, 10> underTestEventQueueStorage;
+    cms::test::PublishedEventRecorder* mRecorder = nullptr;
+
+    void setup() final
+    {
+        using namespace cms::test;
+
+        qf_ctrl::Setup(MAX_PUB_SUB_SIG, BSP_TICKS_PER_SECOND, PwmServiceTestPools());
+
+        mRecorder = PublishedEventRecorder::CreatePublishedEventRecorder(
+          qf_ctrl::RECORDER_PRIORITY,
+          Q_USER_SIG,
+          MAX_PUB_SUB_SIG);
+
+        PwmRecordingFake::Instance().reset();
+
+        CHECK_TRUE(g_thePwmService == nullptr);
+        PwmService_ctor();
+        mUnderTest = g_thePwmService;
+        CHECK_TRUE(mUnderTest != nullptr);
+
+        underTestEventQueueStorage.fill(nullptr);
+    }
+
+    void teardown() final
+    {
+        PwmService_dtor();
+        mUnderTest = nullptr;
+
+        cms::test::qf_ctrl::Teardown();
+
+        delete mRecorder;
+    }
+
+    void startServiceUnderTest()
+    {
+        using namespace cms::test;
+
+        QACTIVE_START(mUnderTest, qf_ctrl::UNIT_UNDER_TEST_PRIORITY,
+                      underTestEventQueueStorage.data(), underTestEventQueueStorage.size(),
+                      nullptr, 0, nullptr);
+        qf_ctrl::ProcessEvents();
+
+        auto& fake = PwmRecordingFake::Instance();
+        LONGS_EQUAL(1, fake.count(Call::INIT));
+        LONGS_EQUAL(PWM_SERVICE_CHANNEL_COUNT, fake.count(Call::OFF));
+        drainRecorder();
+    }
+
+    void pwmOn(float percent, uint8_t channel)
+    {
+        auto e = Q_NEW(PwmServiceOnRequestEvent, PWM_REQUEST_ON_SIG);
+        e->channel = channel;
+        e->percent = percent;
+        cms::test::qf_ctrl::PublishAndProcess(&e->super, mRecorder);
+        drainRecorder();
+    }
+
+    // the service's status events are not of interest here,
+    // but must not be allowed to fill the recorder's queue
+    void drainRecorder()
+    {
+        while (!mRecorder->isEmpty()) {
+            (void)mRecorder->getRecordedEvent();
+        }
+    }
+
+    static uint16_t Duty(float percent)
+    {
+        return PwmPercentToDuty(percent);
+    }
+};
+
+TEST(PwmServiceSoakTests, given_on_for_an_hour_when_readback_matches_then_verify_follows_the_back_off_schedule_and_pwm_is_never_reprogrammed)
+{
+    using namespace cms::test;
+    auto& fake = PwmRecordingFake::Instance();
+
+    constexpr float TEST_PERCENT = 0.55f;
+    startServiceUnderTest();
+    pwmOn(TEST_PERCENT, 0);
+    LONGS_EQUAL(1, fake.count(Call::ON, 0));
+
+    qf_ctrl::MoveTimeForward(1h);
+
+    LONGS_EQUAL(ExpectedReadbacks(1h), fake.count(Call::READBACK, 0));
+    LONGS_EQUAL(0, fake.count(Call::FORCE_REFRESH));
+    LONGS_EQUAL(1, fake.count(Call::ON));
+    CHECK_TRUE(fake.last().call == Call::READBACK);
+}
+
+TEST(PwmServiceSoakTests, given_all_channels_on_for_an_hour_then_each_channel_is_verified_on_the_shared_schedule)
+{
+    using namespace cms::test;
+    auto& fake = PwmRecordingFake::Instance();
+
+    startServiceUnderTest();
+    for (uint8_t channel = 0; channel < PWM_SERVICE_CHANNEL_COUNT; ++channel) {
+        pwmOn(0.1f * static_cast<float>(channel + 1), channel);
+    }
+
+    qf_ctrl::MoveTimeForward(1h);
+
+    for (uint8_t channel = 0; channel < PWM_SERVICE_CHANNEL_COUNT; ++channel) {
+        LONGS_EQUAL(ExpectedReadbacks(1h), fake.count(Call::READBACK, channel));
+        LONGS_EQUAL(1, fake.count(Call::ON, channel));
+    }
+    LONGS_EQUAL(0, fake.count(Call::FORCE_REFRESH));
+}
+
+TEST(PwmServiceSoakTests, given_on_for_an_hour_when_output_drifts_periodically_then_each_drift_is_reprogrammed_exactly_once)
+{
+    using namespace cms::test;
+    auto& fake = PwmRecordingFake::Instance();
+
+    constexpr float TEST_PERCENT = 0.55f;
+    constexpr size_t DRIFTS = 6;
+    startServiceUnderTest();
+    pwmOn(TEST_PERCENT, 0);
+
+    for (size_t drift = 1; drift <= DRIFTS; ++drift) {
+        fake.injectDrift(0, true, Duty(TEST_PERCENT) ^ 1U);
+        qf_ctrl::MoveTimeForward(10min);
+        drainRecorder();
+
+        LONGS_EQUAL(drift, fake.count(Call::FORCE_REFRESH, 0));
+        LONGS_EQUAL(drift + 1, fake.count(Call::ON, 0));
+    }
+
+    //the most recent re-program restored the requested duty cycle
+    bool enabled = false;
+    uint16_t duty = 0;
+    CHECK_TRUE(fake.readback(0, &enabled, &duty));
+    CHECK_TRUE(enabled);
+    LONGS_EQUAL(Duty(TEST_PERCENT), duty);
+}
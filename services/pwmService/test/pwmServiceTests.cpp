@@ -25,13 +25,27 @@
 
 #include "qpc.h"
 #include "pwmService.h"
+#include "pwm.h"
 #include "cms_cpputest_qf_ctrl.hpp"
 #include "cmsTestPublishedEventRecorder.hpp"
 #include "qassertMockSupport.hpp"
 #include "bspTicks.h"
 #include "pub_sub_signals.h"
+#include "cmsQfUsageReport.hpp"
+#include "pwmMockAsync.hpp"
+#include "pwmServiceRampTables.h"
+#include "pwmServicePools.hpp"
+#include "cmsPwmServiceHarness.hpp"
+#ifdef PWM_SERVICE_TRACE
+#include "cmsTraceFile.hpp"
+#endif
+#ifdef PWM_SERVICE_REFRESH_SCHEDULER
+#include "refreshScheduler.h"
+#endif
+#include <algorithm>
 #include <array>
 #include <chrono>
+#include <string>
 
 // the cpputest headers must always be last
 #include "CppUTest/TestHarness.h"
@@ -41,18 +55,91 @@ Q_DEFINE_THIS_MODULE("pwmServiceTests")
 
 using namespace std::chrono_literals;
 
+// Tests are written in terms of a float percentage. When the service
+// is built with a fixed point duty cycle, convert to the integer duty.
+static PwmServiceDuty TestDuty(float percent)
+{
+#ifdef PWM_SERVICE_FIXED_POINT_DUTY
+    return PwmPercentToDuty(percent);
+#else
+    return percent;
+#endif
+}
+
+// The integer duty cycle the driver reads back for a percentage
+static uint16_t TestDutyCounts(float percent)
+{
+    return PwmPercentToDuty(percent);
+}
+
+#ifdef PWM_SERVICE_LATENCY_TRACE
+// fake timestamp counter for the service's latency instrumentation
+static uint32_t s_fakeLatencyTimestamp = 0;
+
+uint32_t PwmService_latencyTimestamp()
+{
+    return s_fakeLatencyTimestamp;
+}
+#endif
+
+#ifdef PWM_SERVICE_TRACE
+// Each test is traced into this file, which then holds the trace of the
+// latest test. The trace of a failed test is kept as
+// <group>.<test>.trace, decode either with cmsTraceDecode.
+static const char* const TRACE_FILE = "PwmServiceTests.trace";
+
+void PwmService_onTrace(PwmServiceTraceRecord record, QSignal sig, uint8_t channel, uint32_t data)
+{
+    using cms::test::trace::Kind;
+    static constexpr Kind kinds[] = {Kind::PUBLISH, Kind::TIMER_ARM, Kind::TIMER_DISARM};
+    cms::test::TraceFile::Instance().record(kinds[record], sig, channel, data);
+}
+#endif
+
+// Time passes for the QF time events and, when the service is built with
+// the shared refresh scheduler, for the scheduler too, tick by tick.
+static void MoveTimeForward(std::chrono::milliseconds duration)
+{
+#ifdef PWM_SERVICE_REFRESH_SCHEDULER
+    static constexpr std::chrono::milliseconds TICK(1000 / BSP_TICKS_PER_SECOND);
+    for (std::chrono::milliseconds elapsed(0); elapsed < duration; elapsed += TICK) {
+        RefreshScheduler_tick();
+        cms::test::qf_ctrl::MoveTimeForward(TICK);
+    }
+#else
+    cms::test::qf_ctrl::MoveTimeForward(duration);
+#endif
+}
+
 TEST_GROUP(PwmServiceTests)
 {
     QActive* mUnderTest         = nullptr;
     std::array<const QEvt*, 10> underTestEventQueueStorage;
     cms::test::PublishedEventRecorder* mRecorder = nullptr;
 
+    // storage for the mocked PwmReadback() output parameters
+    std::array<bool, PWM_SERVICE_CHANNEL_COUNT> mReadbackEnabled;
+    std::array<uint16_t, PWM_SERVICE_CHANNEL_COUNT> mReadbackDuty;
+
+    // storage for the mocked PwmFactoryTestStep() output parameter
+    uint16_t mFactoryTestDeviceId = 0;
+
     void setup() final
     {
         using namespace cms::test;
 
-        // Setup and create the cpputest-for-qpc environment
-        qf_ctrl::Setup(MAX_PUB_SUB_SIG, BSP_TICKS_PER_SECOND);
+        // Setup and create the cpputest-for-qpc environment, with the event
+        // pools laid out for the service's events. The peak usage of each
+        // pool is reported at the end of the test run (see cmsQfUsageReport.hpp).
+        qf_ctrl::Setup(MAX_PUB_SUB_SIG, BSP_TICKS_PER_SECOND, PwmServiceTestPools());
+#ifdef PWM_SERVICE_REFRESH_SCHEDULER
+        RefreshScheduler_init();
+#endif
+
+        auto current = UtestShell::getCurrent();
+        QfUsageReport::Instance().beginTest(current->getGroup().asCharString(),
+                                            current->getName().asCharString(),
+                                            PwmServiceEventPools::blockSizes());
 
         mRecorder = PublishedEventRecorder::CreatePublishedEventRecorder(
           qf_ctrl::RECORDER_PRIORITY,
@@ -73,17 +160,47 @@ TEST_GROUP(PwmServiceTests)
         mUnderTest = g_thePwmService;
         CHECK_TRUE(mUnderTest != nullptr);
 
+#ifdef PWM_SERVICE_TRACE
+        TraceFile& trace = TraceFile::Instance();
+        if (!trace.isOpen()) {
+            CHECK_TRUE(trace.open(TRACE_FILE));
+        }
+        const std::string testName = std::string(current->getGroup().asCharString()) + "." +
+                                     current->getName().asCharString();
+        trace.begin(testName.c_str());
+        for (uint16_t sig = 0; sig < trace::MAX_SIGNAL_NAMES; ++sig) {
+            trace.nameSignal(sig, PwmService_signalName(sig));
+        }
+        trace.traceDispatch(mUnderTest);
+#endif
+
         underTestEventQueueStorage.fill(nullptr);
     }
 
     void teardown() final
     {
+        // Record peak pool and queue usage for the sizing report,
+        // of every active object started by the test
+        auto& report = cms::test::QfUsageReport::Instance();
+        report.recordQueues({{cms::test::qf_ctrl::UNIT_UNDER_TEST_PRIORITY, "PwmService"},
+                             {cms::test::qf_ctrl::RECORDER_PRIORITY, "PublishedEventRecorder"}});
+        report.endTest();
+
+#ifdef PWM_SERVICE_TRACE
+        auto current = UtestShell::getCurrent();
+        if (current->hasFailed()) {
+            cms::test::TraceFile::Instance().saveAs(std::string(current->getGroup().asCharString()) +
+                                                    "." + current->getName().asCharString() + ".trace");
+        }
+#endif
+
         // Destroy the unit under test
         PwmService_dtor();
         mUnderTest = nullptr;
 
         // Clear out the cpputest mock subsystem
         mock().clear();
+        cms::test::pwm_mock::Reset();
 
         // Tear down (destroy) the cpputest-for-qpc environment
         cms::test::qf_ctrl::Teardown();
@@ -98,8 +215,10 @@ TEST_GROUP(PwmServiceTests)
 
         //mock: expect PWM Init
         mock().expectOneCall("PwmInit").andReturnValue(true);
-        //mock: expect PWM off
-        mock().expectOneCall("PwmOff").andReturnValue(true);
+        //mock: expect PWM off, for every channel
+        for (int channel = 0; channel < PWM_SERVICE_CHANNEL_COUNT; ++channel) {
+            mock().expectOneCall("PwmOff").withParameter("channel", channel).andReturnValue(true);
+        }
         //Start the AO under test
 
         QACTIVE_START(mUnderTest, qf_ctrl::UNIT_UNDER_TEST_PRIORITY,
@@ -112,26 +231,32 @@ TEST_GROUP(PwmServiceTests)
         //mock: check expectations
         mock().checkExpectations();
 
-        //confirm that the service published the off status
+        //confirm that the service published the off status, for all channels
         auto event = mRecorder->getRecordedEvent();
         CHECK_TRUE(event != nullptr);
         CHECK_EQUAL(PWM_IS_OFF_SIG, event->sig);
+        auto statusEvent = (const PwmServiceStatusEvent*)(event.get());
+        LONGS_EQUAL(PWM_SERVICE_ALL_CHANNELS, statusEvent->channel);
     }
 
-    void startServiceAndPwmOn(float percent)
+    void startServiceAndPwmOn(float percent, uint8_t channel = 0)
     {
         //  Subscribe to PWM On event (with percentage [ 0.0f … 1.0f ])
-        using namespace cms::test;
-
         startServiceUnderTest();
         //service is now started.
 
+        pwmOn(percent, channel);
+    }
+
+    void pwmOn(float percent, uint8_t channel)
+    {
+        using namespace cms::test;
+
         //allocate event to publish, same as firmware would
-        auto e = Q_NEW(PwmServiceOnRequestEvent, PWM_REQUEST_ON_SIG);
-        e->percent = percent;
+        auto e = PwmService_newOnRequest(QF_NO_MARGIN, channel, TestDuty(percent));
 
-        //mock: expect pwm on call with expected percent value
-        mock().expectOneCall("PwmOn").withParameter("percent", percent).andReturnValue(true);
+        //mock: expect pwm on call with expected channel and percent value
+        expectPwmOn(channel, percent);
         //use helper method to publish and give processing time
         qf_ctrl::PublishAndProcess(&e->super, mRecorder);
 
@@ -140,6 +265,119 @@ TEST_GROUP(PwmServiceTests)
         auto onStatusEvent = mRecorder->getRecordedEvent();
         CHECK_TRUE(onStatusEvent != nullptr);
         CHECK_EQUAL(PWM_IS_ON_SIG, onStatusEvent->sig);
+        auto statusEvent = (const PwmServiceStatusEvent*)(onStatusEvent.get());
+        LONGS_EQUAL(channel, statusEvent->channel);
+    }
+
+    void expectPwmOn(uint8_t channel, float percent)
+    {
+#if defined(PWM_SERVICE_ASYNC_DRIVER)
+        mock().expectOneCall("PwmOnDutyAsync").withParameter("channel", channel).withParameter("duty", TestDutyCounts(percent)).andReturnValue(true);
+#elif defined(PWM_SERVICE_FIXED_POINT_DUTY)
+        mock().expectOneCall("PwmOnDuty").withParameter("channel", channel).withParameter("duty", TestDuty(percent)).andReturnValue(true);
+#else
+        mock().expectOneCall("PwmOn").withParameter("channel", channel).withParameter("percent", percent).andReturnValue(true);
+#endif
+    }
+
+    //mock: expect an integer duty cycle, as programmed by each step of a ramp
+    void expectPwmOnDuty(uint8_t channel, uint16_t duty)
+    {
+#ifdef PWM_SERVICE_ASYNC_DRIVER
+        mock().expectOneCall("PwmOnDutyAsync").withParameter("channel", channel).withParameter("duty", duty).andReturnValue(true);
+#else
+        mock().expectOneCall("PwmOnDuty").withParameter("channel", channel).withParameter("duty", duty).andReturnValue(true);
+#endif
+    }
+
+    void publishRamp(uint8_t channel, float percent, uint8_t profile)
+    {
+        auto e = PwmService_newRampRequest(QF_NO_MARGIN, channel, TestDuty(percent), profile);
+        cms::test::qf_ctrl::PublishAndProcess(&e->super, mRecorder);
+    }
+
+    void expectNoPwmOn()
+    {
+#if defined(PWM_SERVICE_ASYNC_DRIVER)
+        mock().expectNoCall("PwmOnDutyAsync");
+#elif defined(PWM_SERVICE_FIXED_POINT_DUTY)
+        mock().expectNoCall("PwmOnDuty");
+#else
+        mock().expectNoCall("PwmOn");
+#endif
+    }
+
+    void expectPwmOff(uint8_t channel)
+    {
+#ifdef PWM_SERVICE_ASYNC_DRIVER
+        mock().expectOneCall("PwmOffAsync").withParameter("channel", channel).andReturnValue(true);
+#else
+        mock().expectOneCall("PwmOff").withParameter("channel", channel).andReturnValue(true);
+#endif
+    }
+
+    void expectNoPwmOff()
+    {
+#ifdef PWM_SERVICE_ASYNC_DRIVER
+        mock().expectNoCall("PwmOffAsync");
+#else
+        mock().expectNoCall("PwmOff");
+#endif
+    }
+
+    void expectFactoryTest(uint16_t deviceId)
+    {
+#ifdef PWM_SERVICE_ASYNC_DRIVER
+        mock().expectOneCall("PwmFactoryTestAsync").andReturnValue(deviceId);
+#else
+        //the test runs in steps, the last step reads the device ID
+        mFactoryTestDeviceId = deviceId;
+        mock().expectOneCall("PwmFactoryTestBegin");
+        for (unsigned step = 1; step <= PWM_FACTORY_TEST_STEPS; ++step) {
+            mock().expectOneCall("PwmFactoryTestStep")
+              .withOutputParameterReturning("device_id", &mFactoryTestDeviceId, sizeof(mFactoryTestDeviceId))
+              .andReturnValue(step == PWM_FACTORY_TEST_STEPS);
+        }
+#endif
+    }
+
+    //mock: expect the service to read back (verify) a channel,
+    //and to re-program the channel if it has drifted.
+    void expectVerify(uint8_t channel, float percent, bool drifted)
+    {
+        mReadbackEnabled[channel] = true;
+        mReadbackDuty[channel] = TestDutyCounts(percent);
+        if (drifted) {
+            mReadbackDuty[channel] ^= 1U;
+        }
+
+        mock().expectOneCall("PwmReadback")
+          .withParameter("channel", channel)
+          .withOutputParameterReturning("enabled", &mReadbackEnabled[channel], sizeof(bool))
+          .withOutputParameterReturning("duty", &mReadbackDuty[channel], sizeof(uint16_t))
+          .andReturnValue(true);
+
+        if (drifted) {
+            mock().expectOneCall("PwmForceRefresh").withParameter("channel", channel);
+            expectPwmOn(channel, percent);
+        }
+    }
+
+    void pwmOff(uint8_t channel)
+    {
+        using namespace cms::test;
+
+        auto e = PwmService_newOffRequest(QF_NO_MARGIN, channel);
+
+        expectPwmOff(channel);
+        qf_ctrl::PublishAndProcess(&e->super, mRecorder);
+        mock().checkExpectations();
+
+        auto offStatusEvent = mRecorder->getRecordedEvent();
+        CHECK_TRUE(offStatusEvent != nullptr);
+        CHECK_EQUAL(PWM_IS_OFF_SIG, offStatusEvent->sig);
+        auto statusEvent = (const PwmServiceStatusEvent*)(offStatusEvent.get());
+        LONGS_EQUAL(channel, statusEvent->channel);
     }
 };
 
@@ -163,39 +401,222 @@ TEST(PwmServiceTests, given_started_when_pwm_on_event_then_sets_the_pwm_to_expec
     startServiceAndPwmOn(TEST_PERCENT);
 }
 
-//  When On, the AO must refresh the PWM every 250 milliseconds.
-TEST(PwmServiceTests, given_on_when_every_250ms_then_refreshes_pwm_percent)
+//  When On, the AO must verify the PWM 250 milliseconds after a change,
+//  and then back off, doubling the interval while the PWM is stable.
+TEST(PwmServiceTests, given_on_when_readback_matches_then_pwm_is_not_reprogrammed_and_verify_interval_backs_off)
 {
     using namespace cms::test;
 
     constexpr float TEST_PERCENT = 0.55f;
     startServiceAndPwmOn(TEST_PERCENT);
 
-    mock().clear();
-    mock().expectOneCall("PwmOn").withParameter("percent", TEST_PERCENT).andReturnValue(true);
-    qf_ctrl::MoveTimeForward(250ms);
+    expectVerify(0, TEST_PERCENT, false);
+    MoveTimeForward(250ms);
+    mock().checkExpectations();
+
+    //next verify is 500 ms later
+    MoveTimeForward(250ms);
+    mock().checkExpectations();
+    expectVerify(0, TEST_PERCENT, false);
+    MoveTimeForward(250ms);
     mock().checkExpectations();
 
-    //one more time period to confirm that the behavior repeats
-    mock().expectOneCall("PwmOn").withParameter("percent", TEST_PERCENT).andReturnValue(true);
-    qf_ctrl::MoveTimeForward(250ms);
+    //next verify is 1000 ms later
+    MoveTimeForward(750ms);
+    mock().checkExpectations();
+    expectVerify(0, TEST_PERCENT, false);
+    MoveTimeForward(250ms);
     mock().checkExpectations();
 }
 
-TEST(PwmServiceTests, given_on_when_off_req_is_published_then_pwm_is_off)
+TEST(PwmServiceTests, given_on_when_readback_differs_then_pwm_is_reprogrammed_and_verify_interval_resets)
 {
     using namespace cms::test;
 
     constexpr float TEST_PERCENT = 0.55f;
     startServiceAndPwmOn(TEST_PERCENT);
 
-    mock().expectOneCall("PwmOff").andReturnValue(true);
-    qf_ctrl::PublishAndProcess(PWM_REQUEST_OFF_SIG, mRecorder);
+    expectVerify(0, TEST_PERCENT, false);
+    MoveTimeForward(250ms);
     mock().checkExpectations();
 
-    auto offStatusEvent = mRecorder->getRecordedEvent();
-    CHECK_TRUE(offStatusEvent != nullptr);
-    CHECK_EQUAL(PWM_IS_OFF_SIG, offStatusEvent->sig);
+    expectVerify(0, TEST_PERCENT, true);
+    MoveTimeForward(500ms);
+    mock().checkExpectations();
+
+    //after drift, verification returns to the minimum interval
+    expectVerify(0, TEST_PERCENT, false);
+    MoveTimeForward(250ms);
+    mock().checkExpectations();
+}
+
+#ifdef PWM_SERVICE_REFRESH_SCHEDULER
+TEST(PwmServiceTests, given_another_refresh_due_on_the_same_tick_when_turned_on_then_the_verify_is_staggered)
+{
+    using namespace cms::test;
+
+    constexpr float TEST_PERCENT = 0.55f;
+    constexpr uint32_t VERIFY_TICKS = BSP_TICKS_PER_SECOND / 4;
+    startServiceUnderTest();
+
+    //another service's refresh, due when the first verify would be
+    RefreshClient other;
+    RefreshClient_ctor(&other, mUnderTest, Q_USER_SIG);
+    RefreshClient_arm(&other, VERIFY_TICKS);
+
+    pwmOn(TEST_PERCENT, 0);
+    LONGS_EQUAL(1, RefreshScheduler_dueIn(VERIFY_TICKS));
+    LONGS_EQUAL(1, RefreshScheduler_dueIn(VERIFY_TICKS + 1));
+    CHECK_TRUE(RefreshClient_disarm(&other));
+
+    //verified a tick later
+    MoveTimeForward(250ms);
+    mock().checkExpectations();
+    expectVerify(0, TEST_PERCENT, false);
+    MoveTimeForward(1ms);
+    mock().checkExpectations();
+}
+#endif
+
+TEST(PwmServiceTests, given_on_when_off_req_is_published_then_pwm_is_off)
+{
+    constexpr float TEST_PERCENT = 0.55f;
+    startServiceAndPwmOn(TEST_PERCENT);
+
+    //helper method confirms the channel is turned off and the status is published
+    pwmOff(0);
+}
+
+TEST(PwmServiceTests, given_off_when_off_req_is_published_then_request_is_ignored)
+{
+    using namespace cms::test;
+
+    startServiceUnderTest();
+
+    auto e = PwmService_newOffRequest(QF_NO_MARGIN, 0);
+
+    expectNoPwmOff();
+    qf_ctrl::PublishAndProcess(&e->super, mRecorder);
+    mock().checkExpectations();
+
+    CHECK_TRUE(mRecorder->getRecordedEvent() == nullptr);
+}
+
+TEST(PwmServiceTests, given_status_changes_when_snapshot_is_read_then_snapshot_agrees_with_published_status)
+{
+    constexpr float TEST_PERCENT = 0.25f;
+    constexpr uint8_t TEST_CHANNEL = PWM_SERVICE_CHANNEL_COUNT - 1;
+    PwmServiceStatusSnapshot snapshot;
+
+    startServiceUnderTest();
+    CHECK_TRUE(PwmService_getStatusSnapshot(&snapshot));
+    LONGS_EQUAL(1, snapshot.change_count);
+    for (uint8_t channel = 0; channel < PWM_SERVICE_CHANNEL_COUNT; ++channel) {
+        CHECK_FALSE(snapshot.is_on[channel]);
+    }
+
+    pwmOn(TEST_PERCENT, TEST_CHANNEL);
+    CHECK_TRUE(PwmService_getStatusSnapshot(&snapshot));
+    LONGS_EQUAL(2, snapshot.change_count);
+    CHECK_TRUE(snapshot.is_on[TEST_CHANNEL]);
+    CHECK_TRUE(snapshot.percent[TEST_CHANNEL] == TestDuty(TEST_PERCENT));
+    CHECK_FALSE(snapshot.is_on[0]);
+
+    pwmOff(TEST_CHANNEL);
+    CHECK_TRUE(PwmService_getStatusSnapshot(&snapshot));
+    LONGS_EQUAL(3, snapshot.change_count);
+    CHECK_FALSE(snapshot.is_on[TEST_CHANNEL]);
+    CHECK_TRUE(snapshot.percent[TEST_CHANNEL] == 0);
+}
+
+TEST(PwmServiceTests, given_on_when_reset_then_pwm_is_reinitialized_to_off_and_is_no_longer_verified)
+{
+    using namespace cms::test;
+
+    constexpr float TEST_PERCENT = 0.35f;
+    startServiceAndPwmOn(TEST_PERCENT);
+
+    mock().expectOneCall("PwmInit").andReturnValue(true);
+    for (int channel = 0; channel < PWM_SERVICE_CHANNEL_COUNT; ++channel) {
+        mock().expectOneCall("PwmOff").withParameter("channel", channel).andReturnValue(true);
+    }
+    PwmService_reset();
+    qf_ctrl::ProcessEvents();
+    mock().checkExpectations();
+
+    auto event = mRecorder->getRecordedEvent();
+    CHECK_TRUE(event != nullptr);
+    CHECK_EQUAL(PWM_IS_OFF_SIG, event->sig);
+    auto statusEvent = (const PwmServiceStatusEvent*)(event.get());
+    LONGS_EQUAL(PWM_SERVICE_ALL_CHANNELS, statusEvent->channel);
+
+    PwmServiceStatusSnapshot snapshot;
+    CHECK_TRUE(PwmService_getStatusSnapshot(&snapshot));
+    LONGS_EQUAL(1, snapshot.change_count);
+
+    //the refresh timer was disarmed, the mock fails on any readback
+    MoveTimeForward(5s);
+    mock().checkExpectations();
+
+    //and the service is ready for requests again
+    pwmOn(TEST_PERCENT, 0);
+}
+
+TEST(PwmServiceTests, given_one_channel_on_when_another_channel_on_req_is_published_then_both_channels_are_verified)
+{
+    using namespace cms::test;
+
+    constexpr float TEST_PERCENT_1 = 0.25f;
+    constexpr float TEST_PERCENT_2 = 0.75f;
+    constexpr uint8_t TEST_CHANNEL_2 = PWM_SERVICE_CHANNEL_COUNT - 1;
+    startServiceAndPwmOn(TEST_PERCENT_1, 0);
+    pwmOn(TEST_PERCENT_2, TEST_CHANNEL_2);
+
+    //a single refresh tick walks all channels which are on,
+    //re-programming only the channel which drifted
+    expectVerify(0, TEST_PERCENT_1, true);
+    expectVerify(TEST_CHANNEL_2, TEST_PERCENT_2, false);
+    MoveTimeForward(250ms);
+    mock().checkExpectations();
+}
+
+TEST(PwmServiceTests, given_two_channels_on_when_one_channel_off_req_is_published_then_other_channel_is_still_verified)
+{
+    using namespace cms::test;
+
+    constexpr float TEST_PERCENT_1 = 0.25f;
+    constexpr float TEST_PERCENT_2 = 0.75f;
+    constexpr uint8_t TEST_CHANNEL_2 = PWM_SERVICE_CHANNEL_COUNT - 1;
+    startServiceAndPwmOn(TEST_PERCENT_1, 0);
+    pwmOn(TEST_PERCENT_2, TEST_CHANNEL_2);
+    pwmOff(0);
+
+    expectVerify(TEST_CHANNEL_2, TEST_PERCENT_2, true);
+    MoveTimeForward(250ms);
+    mock().checkExpectations();
+
+    //turning off the last channel stops the refresh
+    pwmOff(TEST_CHANNEL_2);
+    mock().expectNoCall("PwmReadback");
+    expectNoPwmOn();
+    MoveTimeForward(250ms);
+    mock().checkExpectations();
+}
+
+TEST(PwmServiceTests, given_started_when_on_req_for_invalid_channel_is_published_then_assert)
+{
+    using namespace cms::test;
+
+    //the assert will interrupt processing, ignore memory pool leak checking.
+    qf_ctrl::ChangeMemPoolTeardownOption(qf_ctrl::MemPoolTeardownOption::IGNORE);
+
+    startServiceUnderTest();
+
+    auto e = PwmService_newOnRequest(QF_NO_MARGIN, PWM_SERVICE_CHANNEL_COUNT, TestDuty(0.5f));
+
+    MockExpectQAssert();
+    qf_ctrl::PublishAndProcess(&e->super, mRecorder);
+    mock().checkExpectations();
 }
 
 TEST(PwmServiceTests, given_off_when_factory_test_request_is_posted_then_pwm_factory_test_is_executed_and_results_are_posted_back)
@@ -220,9 +641,11 @@ TEST(PwmServiceTests, given_off_when_factory_test_request_is_posted_then_pwm_fac
 
     e->requester = dummy->getQActive();
     e->response_sig = MAX_PUB_SUB_SIG + 1000; //ensure well outside pub sub range
+    e->response = nullptr; //service allocates the response
+    e->progress_sig = 0; //no progress reports
 
     //about to post, we expect the pwm factory test to be executed
-    mock().expectOneCall("PwmFactoryTest").andReturnValue(EXPECTED_DEVICE_ID);
+    expectFactoryTest(EXPECTED_DEVICE_ID);
     QACTIVE_POST(mUnderTest, &e->super, nullptr);
     qf_ctrl::ProcessEvents();
     mock().checkExpectations();
@@ -238,6 +661,100 @@ TEST(PwmServiceTests, given_off_when_factory_test_request_is_posted_then_pwm_fac
     CHECK_TRUE(responseEvent->test_passed);
 }
 
+TEST(PwmServiceTests, given_off_when_factory_test_request_supplies_response_storage_then_response_is_posted_without_allocation)
+{
+    const uint16_t EXPECTED_DEVICE_ID = 0x4321;
+    const QSignal RESPONSE_SIG = MAX_PUB_SUB_SIG + 1000;
+
+    using namespace cms::test;
+
+    startServiceUnderTest();   // will be in off state
+
+    auto dummy = std::unique_ptr<cms::DefaultDummyActiveObject>(
+      new cms::DefaultDummyActiveObject(
+        cms::DefaultDummyActiveObject::EventBehavior::RECORDER));
+    dummy->dummyStart(qf_ctrl::UNIT_UNDER_TEST_PRIORITY - 1);
+
+    //both the request and the response are static (non pool) events
+    static PwmServiceFactoryTestResponseEvent response;
+    static PwmServiceFactoryTestRequestEvent request;
+    request = PwmServiceFactoryTestRequestEvent{
+      QEVT_INITIALIZER(PWM_REQUEST_FACTORY_TEST_SIG),
+      dummy->getQActive(),
+      RESPONSE_SIG,
+      &response,
+      0};
+
+    expectFactoryTest(EXPECTED_DEVICE_ID);
+    QACTIVE_POST(mUnderTest, &request.super, nullptr);
+    qf_ctrl::ProcessEvents();
+    mock().checkExpectations();
+
+    auto recordedEvent = dummy->getRecordedEvent();
+    CHECK_TRUE(recordedEvent != nullptr);
+    CHECK_EQUAL(RESPONSE_SIG, recordedEvent->sig);
+
+    //the posted response is the storage supplied by the requester
+    POINTERS_EQUAL(&response, recordedEvent.get());
+    CHECK_EQUAL(EXPECTED_DEVICE_ID, response.device_id);
+    CHECK_TRUE(response.test_passed);
+}
+
+TEST(PwmServiceTests, given_factory_tests_requested_back_to_back_when_too_many_are_held_then_the_excess_request_fails_at_once)
+{
+    const uint16_t EXPECTED_DEVICE_ID = 0x1234;
+    const QSignal RESPONSE_SIG = MAX_PUB_SUB_SIG + 1000;
+    //one runs, the rest are held, and the last is one too many
+    constexpr unsigned REQUESTS = PWM_SERVICE_DEFERRED_FACTORY_TESTS + 2U;
+
+    using namespace cms::test;
+
+    startServiceUnderTest();
+
+    auto dummy = std::unique_ptr<cms::DefaultDummyActiveObject>(
+      new cms::DefaultDummyActiveObject(
+        cms::DefaultDummyActiveObject::EventBehavior::RECORDER));
+    dummy->dummyStart(qf_ctrl::UNIT_UNDER_TEST_PRIORITY - 1);
+
+    for (unsigned i = 0; i < REQUESTS - 1U; ++i) {
+        expectFactoryTest(EXPECTED_DEVICE_ID);
+    }
+    for (unsigned i = 0; i < REQUESTS; ++i) {
+        auto e = Q_NEW(PwmServiceFactoryTestRequestEvent, PWM_REQUEST_FACTORY_TEST_SIG);
+        e->requester = dummy->getQActive();
+        e->response_sig = RESPONSE_SIG;
+        e->response = nullptr;
+        e->progress_sig = 0;
+        QACTIVE_POST(mUnderTest, &e->super, nullptr);
+    }
+    qf_ctrl::ProcessEvents();
+    mock().checkExpectations();
+
+    //the excess request is answered first, without running the test
+    auto recordedEvent = dummy->getRecordedEvent();
+    CHECK_TRUE(recordedEvent != nullptr);
+    CHECK_EQUAL(RESPONSE_SIG, recordedEvent->sig);
+    auto responseEvent = (const PwmServiceFactoryTestResponseEvent*)(recordedEvent.get());
+    CHECK_FALSE(responseEvent->test_passed);
+    CHECK_EQUAL(0xFFFF, responseEvent->device_id);
+
+    for (unsigned i = 0; i < REQUESTS - 1U; ++i) {
+        recordedEvent = dummy->getRecordedEvent();
+        CHECK_TRUE(recordedEvent != nullptr);
+        CHECK_EQUAL(RESPONSE_SIG, recordedEvent->sig);
+        responseEvent = (const PwmServiceFactoryTestResponseEvent*)(recordedEvent.get());
+        CHECK_TRUE(responseEvent->test_passed);
+        CHECK_EQUAL(EXPECTED_DEVICE_ID, responseEvent->device_id);
+    }
+    CHECK_TRUE(dummy->getRecordedEvent() == nullptr);
+
+#ifdef PWM_SERVICE_BACKPRESSURE
+    PwmServiceDropStats stats;
+    PwmService_getDropStats(&stats);
+    LONGS_EQUAL(1, stats.dropped[PWM_SERVICE_DROP_FACTORY_TEST_REQUEST]);
+#endif
+}
+
 TEST(PwmServiceTests, given_on_when_factory_test_requested_then_assert)
 {
     using namespace cms::test;
@@ -253,9 +770,636 @@ TEST(PwmServiceTests, given_on_when_factory_test_requested_then_assert)
     auto e = Q_NEW(PwmServiceFactoryTestRequestEvent, PWM_REQUEST_FACTORY_TEST_SIG);
     e->requester = mUnderTest; //don't care for this test
     e->response_sig = MAX_PUB_SUB_SIG + 1000; //don't care for this test
+    e->response = nullptr; //don't care for this test
+    e->progress_sig = 0; //don't care for this test
 
     MockExpectQAssert();
     QACTIVE_POST(mUnderTest, &e->super, nullptr);
     qf_ctrl::ProcessEvents();
     mock().checkExpectations();
 }
+
+TEST(PwmServiceTests, given_started_when_burst_of_coalesced_on_requests_then_only_newest_percent_reaches_the_pwm)
+{
+    using namespace cms::test;
+
+    constexpr float FINAL_PERCENT = 0.9f;
+    startServiceUnderTest();
+
+    //a burst much larger than the service's event queue
+    for (size_t i = 0; i < underTestEventQueueStorage.size() * 4; ++i) {
+        PwmService_requestOn(0, TestDuty(0.1f));
+    }
+    PwmService_requestOn(0, TestDuty(FINAL_PERCENT));
+
+    expectPwmOn(0, FINAL_PERCENT);
+    qf_ctrl::ProcessEvents();
+    mock().checkExpectations();
+
+    auto onStatusEvent = mRecorder->getRecordedEvent();
+    CHECK_TRUE(onStatusEvent != nullptr);
+    CHECK_EQUAL(PWM_IS_ON_SIG, onStatusEvent->sig);
+    CHECK_TRUE(mRecorder->getRecordedEvent() == nullptr);
+}
+
+TEST(PwmServiceTests, given_on_when_coalesced_on_then_off_requests_then_pwm_is_off)
+{
+    using namespace cms::test;
+
+    constexpr float TEST_PERCENT = 0.55f;
+    startServiceAndPwmOn(TEST_PERCENT);
+
+    PwmService_requestOn(0, TestDuty(0.2f));
+    PwmService_requestOff(0);
+
+    expectNoPwmOn();
+    expectPwmOff(0);
+    qf_ctrl::ProcessEvents();
+    mock().checkExpectations();
+
+    auto offStatusEvent = mRecorder->getRecordedEvent();
+    CHECK_TRUE(offStatusEvent != nullptr);
+    CHECK_EQUAL(PWM_IS_OFF_SIG, offStatusEvent->sig);
+
+    //refresh stops once the last channel is off
+    mock().expectNoCall("PwmReadback");
+    expectNoPwmOn();
+    MoveTimeForward(250ms);
+    mock().checkExpectations();
+}
+
+TEST(PwmServiceTests, given_coalesced_requests_for_several_channels_then_each_channel_gets_its_newest_request)
+{
+    using namespace cms::test;
+
+    constexpr uint8_t TEST_CHANNEL_2 = PWM_SERVICE_CHANNEL_COUNT - 1;
+    startServiceUnderTest();
+
+    PwmService_requestOn(0, TestDuty(0.1f));
+    PwmService_requestOn(TEST_CHANNEL_2, TestDuty(0.2f));
+    PwmService_requestOn(0, TestDuty(0.3f));
+    PwmService_requestOn(TEST_CHANNEL_2, TestDuty(0.4f));
+
+    expectPwmOn(0, 0.3f);
+    expectPwmOn(TEST_CHANNEL_2, 0.4f);
+    qf_ctrl::ProcessEvents();
+    mock().checkExpectations();
+}
+
+#ifdef PWM_SERVICE_LATENCY_TRACE
+TEST(PwmServiceTests, given_latency_trace_when_requests_are_handled_then_request_to_actuation_latency_is_reported)
+{
+    using namespace cms::test;
+
+    constexpr float TEST_PERCENT = 0.5f;
+    startServiceUnderTest();
+    PwmService_resetLatencyStats();
+
+    //on request stamped at 100, driver invoked at 250
+    s_fakeLatencyTimestamp = 100;
+    auto e = PwmService_newOnRequest(QF_NO_MARGIN, 0, TestDuty(TEST_PERCENT));
+    s_fakeLatencyTimestamp = 250;
+    expectPwmOn(0, TEST_PERCENT);
+    qf_ctrl::PublishAndProcess(&e->super, mRecorder);
+    mock().checkExpectations();
+
+    //coalesced off request stored at 1000, driver invoked at 1010
+    s_fakeLatencyTimestamp = 1000;
+    PwmService_requestOff(0);
+    s_fakeLatencyTimestamp = 1010;
+    expectPwmOff(0);
+    qf_ctrl::ProcessEvents();
+    mock().checkExpectations();
+
+    PwmServiceLatencyStats stats;
+    PwmService_getLatencyStats(&stats);
+    LONGS_EQUAL(2, stats.count);
+    LONGS_EQUAL(0, stats.dropped);
+    LONGS_EQUAL(0, stats.unstamped);
+    LONGS_EQUAL(10, stats.min);
+    LONGS_EQUAL(150, stats.max);
+    CHECK_TRUE(stats.p50 >= stats.min);
+    LONGS_EQUAL(150, stats.p99);
+
+    PwmService_resetLatencyStats();
+    PwmService_getLatencyStats(&stats);
+    LONGS_EQUAL(0, stats.count);
+}
+#endif
+
+#ifdef PWM_SERVICE_LATENCY_TRACE
+TEST(PwmServiceTests, given_latency_trace_when_a_stamped_request_block_is_reused_unstamped_then_it_is_counted_and_not_sampled)
+{
+    using namespace cms::test;
+
+    startServiceUnderTest();
+    PwmService_resetLatencyStats();
+
+    //stamped at 100, driver invoked at 250
+    s_fakeLatencyTimestamp = 100;
+    auto stamped = PwmService_newOnRequest(QF_NO_MARGIN, 0, TestDuty(0.5f));
+    const void* const block = stamped;
+    s_fakeLatencyTimestamp = 250;
+    expectPwmOn(0, 0.5f);
+    qf_ctrl::PublishAndProcess(&stamped->super, mRecorder);
+    mock().checkExpectations();
+
+    //the same pool block, allocated without the helper, so not stamped
+    s_fakeLatencyTimestamp = 5000;
+    auto unstamped = Q_NEW(PwmServiceOnRequestEvent, PWM_REQUEST_ON_SIG);
+    CHECK_TRUE(static_cast<const void*>(unstamped) == block);
+    unstamped->channel = 0;
+    unstamped->percent = TestDuty(0.7f);
+    expectPwmOn(0, 0.7f);
+    qf_ctrl::PublishAndProcess(&unstamped->super, mRecorder);
+    mock().checkExpectations();
+
+    PwmServiceLatencyStats stats;
+    PwmService_getLatencyStats(&stats);
+    LONGS_EQUAL(1, stats.count);
+    LONGS_EQUAL(1, stats.unstamped);
+    LONGS_EQUAL(150, stats.max);
+
+    PwmService_resetLatencyStats();
+    PwmService_getLatencyStats(&stats);
+    LONGS_EQUAL(0, stats.unstamped);
+}
+#endif
+
+#ifdef PWM_SERVICE_TRACE
+TEST(PwmServiceTests, given_trace_when_turned_on_then_the_dispatch_publish_and_refresh_timer_are_traced)
+{
+    using namespace cms::test;
+    using trace::Kind;
+
+    startServiceUnderTest();
+    TraceFile& trace = TraceFile::Instance();
+    const size_t before = trace.size();
+
+    pwmOn(0.5f, 0);
+
+    // recorded in completion order: the dispatch returns last
+    LONGS_EQUAL(before + 3, trace.size());
+    const trace::Record& published = trace.at(before);
+    const trace::Record& armed = trace.at(before + 1);
+    const trace::Record& dispatched = trace.at(before + 2);
+
+    CHECK_TRUE(Kind::PUBLISH == published.kind);
+    LONGS_EQUAL(PWM_IS_ON_SIG, published.signal);
+    LONGS_EQUAL(0, published.object);
+
+    CHECK_TRUE(Kind::TIMER_ARM == armed.kind);
+    STRCMP_EQUAL("PWM_REFRESH_SIG", PwmService_signalName(armed.signal));
+    CHECK_TRUE(armed.data > 0);
+
+    CHECK_TRUE(Kind::DISPATCH == dispatched.kind);
+    LONGS_EQUAL(PWM_REQUEST_ON_SIG, dispatched.signal);
+    LONGS_EQUAL(mUnderTest->prio, dispatched.object);
+    CHECK_TRUE(dispatched.timestampNs <= published.timestampNs);
+    CHECK_TRUE(published.timestampNs <= dispatched.timestampNs + dispatched.data);
+
+    STRCMP_EQUAL("PWM_REQUEST_ON_SIG", PwmService_signalName(PWM_REQUEST_ON_SIG));
+    CHECK_TRUE(PwmService_signalName(0xFFFF) == nullptr);
+}
+#endif
+
+TEST(PwmServiceTests, given_generated_ramp_tables_then_every_profile_rises_to_full_scale)
+{
+    for (unsigned profile = 0; profile < PWM_SERVICE_RAMP_PROFILE_COUNT; ++profile) {
+        for (unsigned step = 1; step < PWM_RAMP_TABLE_STEPS; ++step) {
+            CHECK_TRUE(g_pwmRampTables[profile][step] >= g_pwmRampTables[profile][step - 1]);
+        }
+        LONGS_EQUAL(PWM_SERVICE_DUTY_FULL_SCALE, g_pwmRampTables[profile][PWM_RAMP_TABLE_STEPS - 1]);
+    }
+
+    //the s-curve and gamma profiles start gently
+    CHECK_TRUE(g_pwmRampTables[PWM_SERVICE_RAMP_S_CURVE][0] < g_pwmRampTables[PWM_SERVICE_RAMP_LINEAR][0]);
+    CHECK_TRUE(g_pwmRampTables[PWM_SERVICE_RAMP_GAMMA][0] < g_pwmRampTables[PWM_SERVICE_RAMP_LINEAR][0]);
+}
+
+TEST(PwmServiceTests, given_off_when_ramp_req_is_published_then_each_ramp_tick_advances_one_table_step)
+{
+    using namespace cms::test;
+
+    constexpr float TEST_PERCENT = 0.8f;
+    constexpr uint8_t PROFILE = PWM_SERVICE_RAMP_S_CURVE;
+    const uint32_t target = TestDutyCounts(TEST_PERCENT);
+    startServiceUnderTest();
+
+    //the first step is taken right away
+    expectPwmOnDuty(0, static_cast<uint16_t>((target * g_pwmRampTables[PROFILE][0]) >> 16));
+    publishRamp(0, TEST_PERCENT, PROFILE);
+    mock().checkExpectations();
+    CHECK_TRUE(mRecorder->getRecordedEvent() == nullptr);
+
+    for (unsigned step = 1; step < PWM_RAMP_TABLE_STEPS - 1; ++step) {
+        expectPwmOnDuty(0, static_cast<uint16_t>((target * g_pwmRampTables[PROFILE][step]) >> 16));
+        MoveTimeForward(10ms);
+        mock().checkExpectations();
+    }
+
+    //the last step is exactly the requested percent, and reports on
+    expectPwmOn(0, TEST_PERCENT);
+    MoveTimeForward(10ms);
+    mock().checkExpectations();
+
+    auto onStatusEvent = mRecorder->getRecordedEvent();
+    CHECK_TRUE(onStatusEvent != nullptr);
+    CHECK_EQUAL(PWM_IS_ON_SIG, onStatusEvent->sig);
+
+    //back to verifying, the minimum interval later
+    expectVerify(0, TEST_PERCENT, false);
+    MoveTimeForward(250ms);
+    mock().checkExpectations();
+}
+
+TEST(PwmServiceTests, given_ramping_when_on_req_is_published_then_ramp_is_cancelled)
+{
+    using namespace cms::test;
+
+    constexpr float TEST_PERCENT = 0.3f;
+    const uint32_t target = TestDutyCounts(1.0f);
+    startServiceUnderTest();
+
+    expectPwmOnDuty(0, static_cast<uint16_t>((target * g_pwmRampTables[PWM_SERVICE_RAMP_LINEAR][0]) >> 16));
+    publishRamp(0, 1.0f, PWM_SERVICE_RAMP_LINEAR);
+    mock().checkExpectations();
+
+    pwmOn(TEST_PERCENT, 0);
+
+    //no further ramp steps, only the verify of the on request
+    expectVerify(0, TEST_PERCENT, false);
+    MoveTimeForward(250ms);
+    mock().checkExpectations();
+}
+
+#ifndef PWM_SERVICE_ASYNC_DRIVER
+TEST(PwmServiceTests, given_factory_test_in_progress_when_on_req_is_published_then_request_is_held_and_progress_is_reported)
+{
+    const uint16_t EXPECTED_DEVICE_ID = 0x1234;
+    const QSignal RESPONSE_SIG = MAX_PUB_SUB_SIG + 1000;
+    const QSignal PROGRESS_SIG = MAX_PUB_SUB_SIG + 1001;
+    constexpr float TEST_PERCENT = 0.5f;
+
+    using namespace cms::test;
+
+    startServiceUnderTest();
+
+    auto dummy = std::unique_ptr<cms::DefaultDummyActiveObject>(
+      new cms::DefaultDummyActiveObject(
+        cms::DefaultDummyActiveObject::EventBehavior::RECORDER));
+    dummy->dummyStart(qf_ctrl::UNIT_UNDER_TEST_PRIORITY - 1);
+
+    //the on request is applied once the factory test completes
+    mock().strictOrder();
+    expectFactoryTest(EXPECTED_DEVICE_ID);
+    expectPwmOn(0, TEST_PERCENT);
+
+    auto e = Q_NEW(PwmServiceFactoryTestRequestEvent, PWM_REQUEST_FACTORY_TEST_SIG);
+    e->requester = dummy->getQActive();
+    e->response_sig = RESPONSE_SIG;
+    e->response = nullptr;
+    e->progress_sig = PROGRESS_SIG;
+    QACTIVE_POST(mUnderTest, &e->super, nullptr);
+
+    //queued behind the factory test request
+    auto on = PwmService_newOnRequest(QF_NO_MARGIN, 0, TestDuty(TEST_PERCENT));
+    qf_ctrl::PublishAndProcess(&on->super, mRecorder);
+    mock().checkExpectations();
+
+    for (unsigned step = 1; step <= PWM_FACTORY_TEST_STEPS; ++step) {
+        auto recordedEvent = dummy->getRecordedEvent();
+        CHECK_TRUE(recordedEvent != nullptr);
+        CHECK_EQUAL(PROGRESS_SIG, recordedEvent->sig);
+        auto progressEvent = (const PwmServiceFactoryTestProgressEvent*)(recordedEvent.get());
+        LONGS_EQUAL(step, progressEvent->steps_done);
+        LONGS_EQUAL(PWM_FACTORY_TEST_STEPS, progressEvent->steps_total);
+    }
+
+    auto recordedEvent = dummy->getRecordedEvent();
+    CHECK_TRUE(recordedEvent != nullptr);
+    CHECK_EQUAL(RESPONSE_SIG, recordedEvent->sig);
+    auto responseEvent = (const PwmServiceFactoryTestResponseEvent*)(recordedEvent.get());
+    CHECK_EQUAL(EXPECTED_DEVICE_ID, responseEvent->device_id);
+    CHECK_TRUE(responseEvent->test_passed);
+
+    auto onStatusEvent = mRecorder->getRecordedEvent();
+    CHECK_TRUE(onStatusEvent != nullptr);
+    CHECK_EQUAL(PWM_IS_ON_SIG, onStatusEvent->sig);
+}
+#endif
+
+#ifdef PWM_SERVICE_ASYNC_DRIVER
+TEST(PwmServiceTests, given_slow_driver_when_on_req_is_published_then_on_status_is_published_when_driver_completes)
+{
+    using namespace cms::test;
+
+    constexpr float TEST_PERCENT = 0.4f;
+    startServiceUnderTest();
+    pwm_mock::SetCompletionDelay(10ms);
+
+    auto e = PwmService_newOnRequest(QF_NO_MARGIN, 0, TestDuty(TEST_PERCENT));
+
+    expectPwmOn(0, TEST_PERCENT);
+    qf_ctrl::PublishAndProcess(&e->super, mRecorder);
+    mock().checkExpectations();
+
+    //the run to completion step did not wait for the driver
+    CHECK_TRUE(mRecorder->getRecordedEvent() == nullptr);
+    LONGS_EQUAL(1, pwm_mock::PendingCount());
+
+    pwm_mock::AdvanceTime(10ms);
+    qf_ctrl::ProcessEvents();
+
+    auto onStatusEvent = mRecorder->getRecordedEvent();
+    CHECK_TRUE(onStatusEvent != nullptr);
+    CHECK_EQUAL(PWM_IS_ON_SIG, onStatusEvent->sig);
+}
+
+TEST(PwmServiceTests, given_driver_busy_when_on_reqs_are_published_then_newest_is_applied_once_driver_completes)
+{
+    using namespace cms::test;
+
+    startServiceUnderTest();
+    pwm_mock::SetCompletionDelay(10ms);
+
+    auto first = PwmService_newOnRequest(QF_NO_MARGIN, 0, TestDuty(0.2f));
+    expectPwmOn(0, 0.2f);
+    qf_ctrl::PublishAndProcess(&first->super, mRecorder);
+    mock().checkExpectations();
+
+    //held while the driver is busy
+    for (float percent : {0.5f, 0.7f}) {
+        auto e = PwmService_newOnRequest(QF_NO_MARGIN, 0, TestDuty(percent));
+        qf_ctrl::PublishAndProcess(&e->super, mRecorder);
+    }
+    mock().checkExpectations();
+
+    //completion reports the first request, then applies the newest
+    expectPwmOn(0, 0.7f);
+    pwm_mock::AdvanceTime(10ms);
+    qf_ctrl::ProcessEvents();
+    mock().checkExpectations();
+
+    auto onStatusEvent = mRecorder->getRecordedEvent();
+    CHECK_TRUE(onStatusEvent != nullptr);
+    CHECK_EQUAL(PWM_IS_ON_SIG, onStatusEvent->sig);
+    CHECK_TRUE(mRecorder->getRecordedEvent() == nullptr);
+
+    pwm_mock::AdvanceTime(10ms);
+    qf_ctrl::ProcessEvents();
+    onStatusEvent = mRecorder->getRecordedEvent();
+    CHECK_TRUE(onStatusEvent != nullptr);
+    CHECK_EQUAL(PWM_IS_ON_SIG, onStatusEvent->sig);
+}
+
+TEST(PwmServiceTests, given_driver_busy_turning_off_when_factory_test_is_requested_then_test_runs_once_off)
+{
+    const uint16_t EXPECTED_DEVICE_ID = 0x1234;
+    const QSignal RESPONSE_SIG = MAX_PUB_SUB_SIG + 1000;
+
+    using namespace cms::test;
+
+    startServiceAndPwmOn(0.5f);
+
+    auto dummy = std::unique_ptr<cms::DefaultDummyActiveObject>(
+      new cms::DefaultDummyActiveObject(
+        cms::DefaultDummyActiveObject::EventBehavior::RECORDER));
+    dummy->dummyStart(qf_ctrl::UNIT_UNDER_TEST_PRIORITY - 1);
+
+    pwm_mock::SetCompletionDelay(10ms);
+    auto off = PwmService_newOffRequest(QF_NO_MARGIN, 0);
+    expectPwmOff(0);
+    qf_ctrl::PublishAndProcess(&off->super, mRecorder);
+    mock().checkExpectations();
+
+    //deferred while the driver is busy
+    auto e = Q_NEW(PwmServiceFactoryTestRequestEvent, PWM_REQUEST_FACTORY_TEST_SIG);
+    e->requester = dummy->getQActive();
+    e->response_sig = RESPONSE_SIG;
+    e->response = nullptr;
+    e->progress_sig = 0;
+    QACTIVE_POST(mUnderTest, &e->super, nullptr);
+    qf_ctrl::ProcessEvents();
+    mock().checkExpectations();
+
+    expectFactoryTest(EXPECTED_DEVICE_ID);
+    pwm_mock::AdvanceTime(10ms);
+    qf_ctrl::ProcessEvents();
+    mock().checkExpectations();
+
+    auto offStatusEvent = mRecorder->getRecordedEvent();
+    CHECK_TRUE(offStatusEvent != nullptr);
+    CHECK_EQUAL(PWM_IS_OFF_SIG, offStatusEvent->sig);
+    CHECK_TRUE(dummy->getRecordedEvent() == nullptr);
+
+    pwm_mock::AdvanceTime(10ms);
+    qf_ctrl::ProcessEvents();
+
+    auto recordedEvent = dummy->getRecordedEvent();
+    CHECK_TRUE(recordedEvent != nullptr);
+    CHECK_EQUAL(RESPONSE_SIG, recordedEvent->sig);
+    auto responseEvent = (const PwmServiceFactoryTestResponseEvent*)(recordedEvent.get());
+    CHECK_EQUAL(EXPECTED_DEVICE_ID, responseEvent->device_id);
+    CHECK_TRUE(responseEvent->test_passed);
+}
+
+TEST(PwmServiceTests, given_slow_driver_when_operation_completes_with_error_then_assert)
+{
+    using namespace cms::test;
+
+    qf_ctrl::ChangeMemPoolTeardownOption(qf_ctrl::MemPoolTeardownOption::IGNORE);
+
+    startServiceUnderTest();
+    pwm_mock::SetCompletionDelay(10ms);
+    pwm_mock::SetCompletionResult(false);
+
+    auto e = PwmService_newOnRequest(QF_NO_MARGIN, 0, TestDuty(0.5f));
+    expectPwmOn(0, 0.5f);
+    qf_ctrl::PublishAndProcess(&e->super, mRecorder);
+    mock().checkExpectations();
+
+    MockExpectQAssert();
+    pwm_mock::AdvanceTime(10ms);
+    qf_ctrl::ProcessEvents();
+    mock().checkExpectations();
+}
+#endif
+
+#ifdef PWM_SERVICE_BACKPRESSURE
+static constexpr QSignal OVERLOAD_SIG = MAX_PUB_SUB_SIG + 1002; //well outside pub sub range
+
+TEST(PwmServiceTests, given_backpressure_when_service_queue_is_full_then_requests_are_dropped_and_overload_is_reported_once)
+{
+    using namespace cms::test;
+
+    auto observer = std::unique_ptr<cms::DefaultDummyActiveObject>(
+      new cms::DefaultDummyActiveObject(
+        cms::DefaultDummyActiveObject::EventBehavior::RECORDER));
+    observer->dummyStart(qf_ctrl::UNIT_UNDER_TEST_PRIORITY - 1);
+    PwmService_setOverloadObserver(observer->getQActive(), OVERLOAD_SIG);
+
+    startServiceUnderTest();
+
+    //nothing is processed meanwhile, so the service's queue fills up
+    auto postOff = []() {
+        auto e = PwmService_newOffRequest(QF_NO_MARGIN, 0);
+        return PwmService_postRequest(&e->super);
+    };
+    size_t accepted = 0;
+    while (postOff()) {
+        ++accepted;
+        CHECK_TRUE(accepted <= underTestEventQueueStorage.size());
+    }
+    CHECK_FALSE(postOff());
+
+    //the margin is kept free for the service's own events
+    CHECK_TRUE(QEQueue_getNFree(&mUnderTest->eQueue) >= PWM_SERVICE_POST_MARGIN);
+
+    PwmServiceDropStats stats;
+    PwmService_getDropStats(&stats);
+    LONGS_EQUAL(2, stats.dropped[PWM_SERVICE_DROP_OFF_REQUEST]);
+    LONGS_EQUAL(0, stats.dropped[PWM_SERVICE_DROP_ON_REQUEST]);
+    CHECK_TRUE(stats.overloaded);
+
+    //the accepted requests are handled, channel 0 is already off
+    expectNoPwmOff();
+    qf_ctrl::ProcessEvents();
+    mock().checkExpectations();
+
+    auto event = observer->getRecordedEvent();
+    CHECK_TRUE(event != nullptr);
+    CHECK_EQUAL(OVERLOAD_SIG, event->sig);
+    CHECK_TRUE(observer->getRecordedEvent() == nullptr);
+    CHECK_TRUE(mRecorder->getRecordedEvent() == nullptr);
+
+    //once reset, the next overload is reported again
+    PwmService_resetDropStats();
+    PwmService_getDropStats(&stats);
+    LONGS_EQUAL(0, stats.dropped[PWM_SERVICE_DROP_OFF_REQUEST]);
+    CHECK_FALSE(stats.overloaded);
+    while (postOff()) {
+    }
+    qf_ctrl::ProcessEvents();
+    event = observer->getRecordedEvent();
+    CHECK_TRUE(event != nullptr);
+    CHECK_EQUAL(OVERLOAD_SIG, event->sig);
+}
+
+TEST(PwmServiceTests, given_backpressure_without_an_overload_observer_when_service_queue_is_full_then_overload_is_only_polled)
+{
+    using namespace cms::test;
+
+    startServiceUnderTest();
+
+    auto postOff = []() {
+        auto e = PwmService_newOffRequest(QF_NO_MARGIN, 0);
+        return PwmService_postRequest(&e->super);
+    };
+    while (postOff()) {
+    }
+
+    PwmServiceDropStats stats;
+    PwmService_getDropStats(&stats);
+    CHECK_TRUE(stats.overloaded);
+
+    expectNoPwmOff();
+    qf_ctrl::ProcessEvents();
+    mock().checkExpectations();
+    CHECK_TRUE(mRecorder->getRecordedEvent() == nullptr);
+}
+
+#ifndef PWM_SERVICE_ASYNC_DRIVER
+namespace {
+// A factory test requester with a queue too short for every progress
+// report. It has a lower priority than the service, so it only runs
+// once the factory test is complete.
+struct ShortQueueRequester
+{
+    QActive super;
+    std::array<const QEvt*, 2> queueStorage;
+    uint32_t received;
+
+    static QState initial(ShortQueueRequester* const me, void const* const par)
+    {
+        Q_UNUSED_PAR(par);
+        return Q_TRAN(&active);
+    }
+
+    static QState active(ShortQueueRequester* const me, QEvt const* const e)
+    {
+        if (e->sig >= Q_USER_SIG) {
+            ++me->received;
+            return Q_HANDLED();
+        }
+        return Q_SUPER(&QHsm_top);
+    }
+};
+} // namespace
+
+TEST(PwmServiceTests, given_backpressure_when_requester_queue_is_full_then_factory_test_outputs_are_dropped)
+{
+    using namespace cms::test;
+
+    auto observer = std::unique_ptr<cms::DefaultDummyActiveObject>(
+      new cms::DefaultDummyActiveObject(
+        cms::DefaultDummyActiveObject::EventBehavior::RECORDER));
+    observer->dummyStart(qf_ctrl::UNIT_UNDER_TEST_PRIORITY - 2);
+    PwmService_setOverloadObserver(observer->getQActive(), OVERLOAD_SIG);
+
+    startServiceUnderTest();
+
+    static ShortQueueRequester requester;
+    requester = ShortQueueRequester{};
+    QActive_ctor(&requester.super, Q_STATE_CAST(&ShortQueueRequester::initial));
+    QACTIVE_START(&requester.super, qf_ctrl::UNIT_UNDER_TEST_PRIORITY - 1,
+                  requester.queueStorage.data(), requester.queueStorage.size(),
+                  nullptr, 0, nullptr);
+    qf_ctrl::ProcessEvents();
+
+    auto e = Q_NEW(PwmServiceFactoryTestRequestEvent, PWM_REQUEST_FACTORY_TEST_SIG);
+    e->requester = &requester.super;
+    e->response_sig = MAX_PUB_SUB_SIG + 1000;
+    e->response = nullptr;
+    e->progress_sig = MAX_PUB_SUB_SIG + 1001;
+
+    expectFactoryTest(0x1234);
+    CHECK_TRUE(PwmService_postRequest(&e->super));
+    qf_ctrl::ProcessEvents();
+    mock().checkExpectations();
+
+    //the response is the last output, so it found the queue full
+    PwmServiceDropStats stats;
+    PwmService_getDropStats(&stats);
+    LONGS_EQUAL(1, stats.dropped[PWM_SERVICE_DROP_FACTORY_TEST_RESPONSE]);
+    LONGS_EQUAL(PWM_FACTORY_TEST_STEPS + 1,
+                requester.received + stats.dropped[PWM_SERVICE_DROP_FACTORY_TEST_PROGRESS] +
+                stats.dropped[PWM_SERVICE_DROP_FACTORY_TEST_RESPONSE]);
+
+    CHECK_TRUE(stats.overloaded);
+    auto event = observer->getRecordedEvent();
+    CHECK_TRUE(event != nullptr);
+    CHECK_EQUAL(OVERLOAD_SIG, event->sig);
+}
+#endif
+#endif
+
+template <typename E>
+static void CheckAllocatedFromItsPool()
+{
+    // QF numbers its pools from 1
+    auto e = Q_NEW(E, Q_USER_SIG);
+    LONGS_EQUAL(PwmServiceEventPools::poolOf<E>() + 1U, e->super.poolId_);
+    CHECK_TRUE(PwmServiceEventPools::wasteOf<E>() < PwmServiceEventPools::GRANULE);
+    QF_gc(&e->super);
+}
+
+TEST(PwmServiceTests, every_event_is_allocated_from_the_pool_of_its_compile_time_layout)
+{
+    CheckAllocatedFromItsPool<PwmServiceOnRequestEvent>();
+    CheckAllocatedFromItsPool<PwmServiceOffRequestEvent>();
+    CheckAllocatedFromItsPool<PwmServiceRampRequestEvent>();
+    CheckAllocatedFromItsPool<PwmServiceFactoryTestRequestEvent>();
+    CheckAllocatedFromItsPool<PwmServiceFactoryTestResponseEvent>();
+    CheckAllocatedFromItsPool<PwmServiceFactoryTestProgressEvent>();
+}
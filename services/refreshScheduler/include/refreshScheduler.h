@@ -0,0 +1,106 @@
+/// @file refreshScheduler.h
+/// @brief A refresh scheduler shared by periodic services, in place of a
+///        QTimeEvt per active object: a hashed timer wheel, ticked once
+///        per system clock tick, which staggers the expiries of its
+///        clients so that their periodic work is spread across ticks.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#ifndef REFRESH_SCHEDULER_H
+#define REFRESH_SCHEDULER_H
+
+#include "qpc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The number of slots of the wheel, a power of two. A client is
+ * hashed to the slot of its expiry tick, and a tick only walks the
+ * clients of one slot, so a wheel of at least the longest period
+ * (in ticks) walks only the clients expiring on that tick. Longer
+ * periods take more than one turn of the wheel. May be overridden
+ * by the build.
+ */
+#ifndef REFRESH_SCHEDULER_SLOTS
+#define REFRESH_SCHEDULER_SLOTS 256U
+#endif
+
+/**
+ * The most an expiry is delayed (staggered) to a less busy tick.
+ * An expiry is delayed by less than this, and by at most an eighth
+ * of its period, so short periods are never staggered. May be
+ * overridden by the build, 1 disables the staggering.
+ */
+#ifndef REFRESH_SCHEDULER_STAGGER_TICKS
+#define REFRESH_SCHEDULER_STAGGER_TICKS 8U
+#endif
+
+/**
+ * A client of the scheduler: a one-shot timeout, posted to its active
+ * object as a static event, like a QTimeEvt. Do not access the members.
+ */
+typedef struct RefreshClient {
+    QEvt super; /* inherit QEvt, the event posted on expiry */
+
+    struct RefreshClient * next; //in its slot, while armed
+    struct RefreshClient * prev;
+    struct RefreshClient * expired_next; //while being posted by the tick
+    QActive * act;
+    uint32_t rounds; //full turns of the wheel before the expiry
+    uint16_t slot;
+    bool armed;
+} RefreshClient;
+
+/**
+ * Clear the wheel, forgetting every client. Call once, before
+ * any client is armed, and before the clock tick is started.
+ */
+void RefreshScheduler_init();
+
+/**
+ * Advance the wheel by one tick, posting the event of every client
+ * expiring on this tick. Call from the system clock tick (e.g.
+ * QF_onClockTick() or the tick ISR), like QTIMEEVT_TICK_X().
+ */
+void RefreshScheduler_tick();
+
+/**
+ * The number of clients expiring in exactly ticks ticks, [1 ..].
+ */
+uint16_t RefreshScheduler_dueIn(uint32_t ticks);
+
+/**
+ * Construct a client, posting sig to act on each expiry.
+ */
+void RefreshClient_ctor(RefreshClient * me, QActive * act, enum_t sig);
+
+/**
+ * Arm a disarmed client to expire once, in ticks ticks, or up to
+ * REFRESH_SCHEDULER_STAGGER_TICKS - 1 ticks later, on the least
+ * busy of those ticks (the earliest of the least busy).
+ */
+void RefreshClient_arm(RefreshClient * me, uint32_t ticks);
+
+/**
+ * Disarm a client. Returns false if the client was not armed,
+ * i.e. it has expired, and its event may still be in the queue.
+ */
+bool RefreshClient_disarm(RefreshClient * me);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // REFRESH_SCHEDULER_H
@@ -0,0 +1,201 @@
+/// @brief The shared refresh scheduler: a hashed timer wheel. An armed
+///        client is linked into the slot of its expiry tick, with the
+///        number of full turns of the wheel left before it expires. A
+///        tick advances the wheel by one slot, walking only the clients
+///        of that slot, however many clients are armed.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#include "refreshScheduler.h"
+#include "qsafe.h"
+#include <stddef.h>
+
+Q_DEFINE_THIS_MODULE("RefreshScheduler")
+
+_Static_assert((REFRESH_SCHEDULER_SLOTS & (REFRESH_SCHEDULER_SLOTS - 1U)) == 0U,
+               "the refresh scheduler's slots must be a power of two");
+_Static_assert(REFRESH_SCHEDULER_SLOTS <= 0x10000U,
+               "the refresh scheduler's slots must fit the client's slot index");
+_Static_assert(REFRESH_SCHEDULER_STAGGER_TICKS >= 1U,
+               "an expiry may be staggered by REFRESH_SCHEDULER_STAGGER_TICKS - 1 ticks");
+
+#define SLOT_MASK (REFRESH_SCHEDULER_SLOTS - 1U)
+
+typedef struct {
+    RefreshClient * slots[REFRESH_SCHEDULER_SLOTS];
+    uint16_t cursor; //the slot of the current tick
+} RefreshWheel;
+
+static RefreshWheel m_wheel;
+
+static void linkClient(RefreshClient * me, uint32_t ticks);
+static void unlinkClient(RefreshClient * me);
+static uint16_t dueIn(uint32_t ticks);
+static uint32_t staggered(uint32_t ticks);
+
+void RefreshScheduler_init()
+{
+    for (uint32_t slot = 0; slot < REFRESH_SCHEDULER_SLOTS; ++slot) {
+        m_wheel.slots[slot] = NULL;
+    }
+    m_wheel.cursor = 0U;
+}
+
+void RefreshScheduler_tick()
+{
+    RefreshClient * expired = NULL;
+
+    QF_CRIT_STAT
+    QF_CRIT_ENTRY();
+    m_wheel.cursor = (uint16_t)((m_wheel.cursor + 1U) & SLOT_MASK);
+    RefreshClient * client = m_wheel.slots[m_wheel.cursor];
+    while (client != NULL) {
+        RefreshClient * const next = client->next;
+        if (client->rounds == 0U) {
+            unlinkClient(client);
+            client->expired_next = expired;
+            expired = client;
+        }
+        else {
+            --client->rounds;
+        }
+        client = next;
+    }
+    QF_CRIT_EXIT();
+
+    //posted outside of the critical section, as QF posts
+    //the events of expired time events.
+    while (expired != NULL) {
+        RefreshClient * const next = expired->expired_next;
+        QACTIVE_POST(expired->act, &expired->super, &m_wheel);
+        expired = next;
+    }
+}
+
+uint16_t RefreshScheduler_dueIn(uint32_t const ticks)
+{
+    Q_REQUIRE(ticks > 0U);
+
+    QF_CRIT_STAT
+    QF_CRIT_ENTRY();
+    uint16_t const due = dueIn(ticks);
+    QF_CRIT_EXIT();
+    return due;
+}
+
+void RefreshClient_ctor(RefreshClient * const me, QActive * const act, enum_t const sig)
+{
+    static const QEvt StaticEventInit = QEVT_INITIALIZER(0);
+    me->super = StaticEventInit;
+    me->super.sig = (QSignal)sig;
+
+    me->next = NULL;
+    me->prev = NULL;
+    me->expired_next = NULL;
+    me->act = act;
+    me->rounds = 0U;
+    me->slot = 0U;
+    me->armed = false;
+}
+
+void RefreshClient_arm(RefreshClient * const me, uint32_t const ticks)
+{
+    Q_REQUIRE(ticks > 0U);
+    Q_REQUIRE(me->act != NULL);
+    Q_REQUIRE(!me->armed); //disarm (or expire) it first, as a QTimeEvt
+
+    QF_CRIT_STAT
+    QF_CRIT_ENTRY();
+    linkClient(me, staggered(ticks));
+    QF_CRIT_EXIT();
+}
+
+bool RefreshClient_disarm(RefreshClient * const me)
+{
+    QF_CRIT_STAT
+    QF_CRIT_ENTRY();
+    bool const wasArmed = me->armed;
+    if (wasArmed) {
+        unlinkClient(me);
+    }
+    QF_CRIT_EXIT();
+    return wasArmed;
+}
+
+// Within a critical section: expire in ticks ticks.
+static void linkClient(RefreshClient * const me, uint32_t const ticks)
+{
+    uint16_t const slot = (uint16_t)((m_wheel.cursor + ticks) & SLOT_MASK);
+    me->slot = slot;
+    me->rounds = (ticks - 1U) / REFRESH_SCHEDULER_SLOTS;
+    me->prev = NULL;
+    me->next = m_wheel.slots[slot];
+    if (me->next != NULL) {
+        me->next->prev = me;
+    }
+    m_wheel.slots[slot] = me;
+    me->armed = true;
+}
+
+// Within a critical section: remove an armed client from its slot.
+static void unlinkClient(RefreshClient * const me)
+{
+    if (me->prev != NULL) {
+        me->prev->next = me->next;
+    }
+    else {
+        m_wheel.slots[me->slot] = me->next;
+    }
+    if (me->next != NULL) {
+        me->next->prev = me->prev;
+    }
+    me->next = NULL;
+    me->prev = NULL;
+    me->armed = false;
+}
+
+// Within a critical section: the clients of the slot of that tick,
+// which are on their last turn of the wheel when it comes.
+static uint16_t dueIn(uint32_t const ticks)
+{
+    uint32_t const rounds = (ticks - 1U) / REFRESH_SCHEDULER_SLOTS;
+    uint16_t due = 0U;
+    for (RefreshClient const * client = m_wheel.slots[(m_wheel.cursor + ticks) & SLOT_MASK];
+         client != NULL; client = client->next) {
+        if (client->rounds == rounds) {
+            ++due;
+        }
+    }
+    return due;
+}
+
+// Within a critical section: the least busy tick of [ticks .. ticks +
+// window), the earliest of them on a tie, so a client alone is on time.
+static uint32_t staggered(uint32_t const ticks)
+{
+    uint32_t window = ticks / 8U;
+    if (window > REFRESH_SCHEDULER_STAGGER_TICKS) {
+        window = REFRESH_SCHEDULER_STAGGER_TICKS;
+    }
+
+    uint32_t best = ticks;
+    uint16_t bestDue = dueIn(ticks);
+    for (uint32_t delay = 1U; (delay < window) && (bestDue > 0U); ++delay) {
+        uint16_t const due = dueIn(ticks + delay);
+        if (due < bestDue) {
+            best = ticks + delay;
+            bestDue = due;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,256 @@
+/// @brief  Tests for the shared refresh scheduler (a hashed timer wheel),
+///         its clients expiring into a test active object within the
+///         cpputest-for-qpc environment.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+/// Copyright (C) 2024 Matthew Eshleman. All rights reserved.
+///
+/// This program is open source software: you can redistribute it and/or
+/// modify it under the terms of the GNU General Public License as published
+/// by the Free Software Foundation, either version 3 of the License, or
+/// (at your option) any later version.
+///
+/// Alternatively, upon written permission from Matthew Eshleman, this program
+/// may be distributed and modified under the terms of a Commercial
+/// License. For further details, see the Contact Information below.
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#include "qpc.h"
+#include "refreshScheduler.h"
+#include "cms_cpputest_qf_ctrl.hpp"
+#include "bspTicks.h"
+#include "pub_sub_signals.h"
+#include <algorithm>
+#include <array>
+#include <map>
+#include <vector>
+
+// the cpputest headers must always be last
+#include "CppUTest/TestHarness.h"
+
+static constexpr size_t MAX_CLIENTS = 16;
+
+namespace {
+
+struct Expiry
+{
+    size_t client;
+    uint32_t tick;
+};
+
+// The ticks elapsed, the clients, and what expired when, shared
+// with the receiver's state handler.
+uint32_t s_tick = 0;
+std::array<RefreshClient, MAX_CLIENTS> s_clients;
+std::vector<Expiry> s_expiries;
+uint32_t s_rearmTicks = 0; // re-arm each client as it expires, when not 0
+
+// The active object the clients' events are posted to.
+struct Receiver
+{
+    QActive super;
+    std::array<const QEvt*, MAX_CLIENTS> queueStorage;
+
+    static QState initial(Receiver* const me, void const* const par)
+    {
+        Q_UNUSED_PAR(par);
+        return Q_TRAN(&active);
+    }
+
+    static QState active(Receiver* const me, QEvt const* const e)
+    {
+        if ((e->sig >= Q_USER_SIG) && (e->sig < Q_USER_SIG + MAX_CLIENTS)) {
+            const size_t client = e->sig - Q_USER_SIG;
+            s_expiries.push_back({client, s_tick});
+            if (s_rearmTicks != 0U) {
+                RefreshClient_arm(&s_clients[client], s_rearmTicks);
+            }
+            return Q_HANDLED();
+        }
+        return Q_SUPER(&QHsm_top);
+    }
+};
+
+} // namespace
+
+TEST_GROUP(RefreshSchedulerTests)
+{
+    Receiver mReceiver;
+
+    void setup() final
+    {
+        using namespace cms::test;
+
+        qf_ctrl::Setup(MAX_PUB_SUB_SIG, BSP_TICKS_PER_SECOND);
+        RefreshScheduler_init();
+
+        s_tick = 0;
+        s_expiries.clear();
+        s_rearmTicks = 0;
+
+        mReceiver.queueStorage.fill(nullptr);
+        QActive_ctor(&mReceiver.super, Q_STATE_CAST(&Receiver::initial));
+        QACTIVE_START(&mReceiver.super, qf_ctrl::UNIT_UNDER_TEST_PRIORITY,
+                      mReceiver.queueStorage.data(), mReceiver.queueStorage.size(),
+                      nullptr, 0, nullptr);
+        qf_ctrl::ProcessEvents();
+
+        for (size_t client = 0; client < MAX_CLIENTS; ++client) {
+            RefreshClient_ctor(&s_clients[client], &mReceiver.super,
+                               static_cast<enum_t>(Q_USER_SIG + client));
+        }
+    }
+
+    void teardown() final
+    {
+        cms::test::qf_ctrl::Teardown();
+    }
+
+    static void tick(uint32_t ticks = 1)
+    {
+        for (uint32_t i = 0; i < ticks; ++i) {
+            ++s_tick;
+            RefreshScheduler_tick();
+            cms::test::qf_ctrl::ProcessEvents();
+        }
+    }
+
+    static void armClients(size_t count, uint32_t ticks)
+    {
+        for (size_t client = 0; client < count; ++client) {
+            RefreshClient_arm(&s_clients[client], ticks);
+        }
+    }
+
+    // expiries per tick
+    static std::map<uint32_t, size_t> load()
+    {
+        std::map<uint32_t, size_t> expiries;
+        for (const Expiry& expiry : s_expiries) {
+            ++expiries[expiry.tick];
+        }
+        return expiries;
+    }
+};
+
+TEST(RefreshSchedulerTests, given_armed_when_its_ticks_elapse_then_its_event_is_posted_once_on_time)
+{
+    RefreshClient_arm(&s_clients[0], 5);
+
+    tick(4);
+    CHECK_TRUE(s_expiries.empty());
+
+    tick();
+    LONGS_EQUAL(1, s_expiries.size());
+    LONGS_EQUAL(0, s_expiries[0].client);
+    LONGS_EQUAL(5, s_expiries[0].tick);
+
+    tick(2 * REFRESH_SCHEDULER_SLOTS);
+    LONGS_EQUAL(1, s_expiries.size());
+}
+
+TEST(RefreshSchedulerTests, given_armed_for_several_turns_of_the_wheel_when_they_elapse_then_its_event_is_posted_on_time)
+{
+    constexpr uint32_t TICKS = 3 * REFRESH_SCHEDULER_SLOTS + 5;
+    RefreshClient_arm(&s_clients[0], TICKS);
+    LONGS_EQUAL(1, RefreshScheduler_dueIn(TICKS));
+    LONGS_EQUAL(0, RefreshScheduler_dueIn(TICKS - REFRESH_SCHEDULER_SLOTS));
+
+    tick(TICKS - 1);
+    CHECK_TRUE(s_expiries.empty());
+    tick();
+    LONGS_EQUAL(1, s_expiries.size());
+    LONGS_EQUAL(TICKS, s_expiries[0].tick);
+}
+
+TEST(RefreshSchedulerTests, given_armed_for_a_whole_turn_of_the_wheel_when_it_elapses_then_its_event_is_posted_on_time)
+{
+    RefreshClient_arm(&s_clients[0], REFRESH_SCHEDULER_SLOTS);
+    tick(REFRESH_SCHEDULER_SLOTS);
+    LONGS_EQUAL(1, s_expiries.size());
+    LONGS_EQUAL(REFRESH_SCHEDULER_SLOTS, s_expiries[0].tick);
+}
+
+TEST(RefreshSchedulerTests, given_armed_when_disarmed_then_nothing_is_posted)
+{
+    RefreshClient_arm(&s_clients[0], 5);
+    RefreshClient_arm(&s_clients[1], 5);
+    tick(2);
+
+    CHECK_TRUE(RefreshClient_disarm(&s_clients[0]));
+    CHECK_FALSE(RefreshClient_disarm(&s_clients[0]));
+    LONGS_EQUAL(1, RefreshScheduler_dueIn(3));
+
+    tick(10);
+    LONGS_EQUAL(1, s_expiries.size());
+    LONGS_EQUAL(1, s_expiries[0].client);
+}
+
+TEST(RefreshSchedulerTests, given_expired_when_disarmed_then_it_was_not_armed)
+{
+    RefreshClient_arm(&s_clients[0], 1);
+    tick();
+    LONGS_EQUAL(1, s_expiries.size());
+    CHECK_FALSE(RefreshClient_disarm(&s_clients[0]));
+}
+
+TEST(RefreshSchedulerTests, given_clients_due_on_the_same_tick_when_armed_then_each_expires_on_its_own_tick)
+{
+    constexpr uint32_t TICKS = 1000;
+    armClients(REFRESH_SCHEDULER_STAGGER_TICKS, TICKS);
+
+    tick(TICKS + REFRESH_SCHEDULER_STAGGER_TICKS);
+    LONGS_EQUAL(REFRESH_SCHEDULER_STAGGER_TICKS, s_expiries.size());
+    const auto expiries = load();
+    LONGS_EQUAL(REFRESH_SCHEDULER_STAGGER_TICKS, expiries.size());
+    LONGS_EQUAL(TICKS, expiries.begin()->first);
+    LONGS_EQUAL(TICKS + REFRESH_SCHEDULER_STAGGER_TICKS - 1, expiries.rbegin()->first);
+}
+
+TEST(RefreshSchedulerTests, given_more_clients_than_the_stagger_window_when_armed_then_they_are_spread_evenly)
+{
+    constexpr uint32_t TICKS = 1000;
+    armClients(2 * REFRESH_SCHEDULER_STAGGER_TICKS, TICKS);
+
+    tick(TICKS + REFRESH_SCHEDULER_STAGGER_TICKS);
+    LONGS_EQUAL(2 * REFRESH_SCHEDULER_STAGGER_TICKS, s_expiries.size());
+    for (const auto& expiries : load()) {
+        LONGS_EQUAL(2, expiries.second);
+    }
+}
+
+TEST(RefreshSchedulerTests, given_a_short_period_when_clients_are_armed_then_they_are_not_staggered)
+{
+    // an eighth of the period, less than a tick
+    armClients(4, 7);
+
+    tick(7);
+    LONGS_EQUAL(4, s_expiries.size());
+    LONGS_EQUAL(1, load().size());
+}
+
+TEST(RefreshSchedulerTests, given_periodic_clients_when_rearmed_on_each_expiry_then_their_refreshes_stay_spread)
+{
+    constexpr uint32_t TICKS = 250;
+    constexpr size_t CLIENTS = 4;
+    s_rearmTicks = TICKS;
+    armClients(CLIENTS, TICKS);
+
+    tick(10 * TICKS);
+    CHECK_TRUE(s_expiries.size() >= 9 * CLIENTS);
+    for (const auto& expiries : load()) {
+        LONGS_EQUAL(1, expiries.second);
+    }
+
+    for (size_t client = 0; client < CLIENTS; ++client) {
+        CHECK_TRUE(RefreshClient_disarm(&s_clients[client]));
+    }
+}
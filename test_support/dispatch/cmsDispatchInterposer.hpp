@@ -0,0 +1,105 @@
+/// @brief  Interposition on the dispatch operation of QP/C active objects,
+///         shared by the test harnesses which observe a dispatch (e.g. to
+///         count or to trace it) without modifying the active object.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#ifndef CMS_DISPATCH_INTERPOSER_HPP
+#define CMS_DISPATCH_INTERPOSER_HPP
+
+#include "qpc.h"
+#include <array>
+#include <cstddef>
+
+namespace cms {
+namespace test {
+
+/// The dispatch operation of a QAsmVtable.
+using DispatchOperation = void (*)(QAsm* me, QEvt const* e, uint_fast8_t qsId);
+
+/// Interposes Hook on the dispatch of up to Capacity active objects, by
+/// swapping each one's virtual table (QAsmVtable) for a copy whose
+/// dispatch is Hook. Hook dispatches the event itself, with Original().
+/// Each Hook has its own set of active objects.
+template <DispatchOperation Hook, size_t Capacity>
+class DispatchInterposer
+{
+public:
+    /// Interpose on ao. Returns false when Capacity objects are attached.
+    static bool Attach(QActive* ao)
+    {
+        State& state = Instance();
+        if (state.count >= Capacity) {
+            return false;
+        }
+        Interposed& interposed = state.interposed[state.count++];
+        interposed.object = &ao->super;
+        interposed.original = ao->super.vptr;
+        interposed.hooked = *interposed.original;
+        interposed.hooked.dispatch = Hook;
+        ao->super.vptr = &interposed.hooked;
+        return true;
+    }
+
+    /// Restore the virtual table of each attached active object.
+    static void Detach()
+    {
+        State& state = Instance();
+        for (size_t i = 0; i < state.count; ++i) {
+            state.interposed[i].object->vptr = state.interposed[i].original;
+        }
+        state.count = 0;
+    }
+
+    /// Forget the attached active objects without restoring them, when
+    /// they are gone (e.g. a test's active objects, at its end).
+    static void Reset() { Instance().count = 0; }
+
+    /// The dispatch operation of me before Attach(), or nullptr when me
+    /// is not attached.
+    static DispatchOperation Original(QAsm const* me)
+    {
+        const State& state = Instance();
+        for (size_t i = 0; i < state.count; ++i) {
+            if (state.interposed[i].object == me) {
+                return state.interposed[i].original->dispatch;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    struct Interposed
+    {
+        QAsm* object = nullptr;
+        struct QAsmVtable const* original = nullptr;
+        struct QAsmVtable hooked = {};
+    };
+
+    struct State
+    {
+        std::array<Interposed, Capacity> interposed;
+        size_t count = 0;
+    };
+
+    static State& Instance()
+    {
+        static State state;
+        return state;
+    }
+};
+
+} // namespace test
+} // namespace cms
+
+#endif // CMS_DISPATCH_INTERPOSER_HPP
@@ -0,0 +1,109 @@
+/*
+ *   A no-op implementation of the PWM driver, for benchmarking
+ *   and long running simulations of the services using the
+ *   driver. Every operation succeeds, and a read back reports
+ *   the last written state (no drift).
+ */
+#include "pwm.h"
+
+//the last written state, so that a read back reports no drift
+static bool m_enabled[PWM_MAX_CHANNELS];
+static uint16_t m_duty[PWM_MAX_CHANNELS];
+
+bool PwmInit()
+{
+    return true;
+}
+
+bool PwmOff(uint8_t channel)
+{
+    if (channel >= PWM_MAX_CHANNELS) {
+        return false;
+    }
+    m_enabled[channel] = false;
+    return true;
+}
+
+bool PwmOn(uint8_t channel, float percent)
+{
+    return PwmOnDuty(channel, PwmPercentToDuty(percent));
+}
+
+bool PwmOnDuty(uint8_t channel, uint16_t duty)
+{
+    if (channel >= PWM_MAX_CHANNELS) {
+        return false;
+    }
+    m_enabled[channel] = true;
+    m_duty[channel] = duty;
+    return true;
+}
+
+bool PwmOffAsync(uint8_t channel, PwmCompletionCallback done, void* context)
+{
+    if (channel >= PWM_MAX_CHANNELS) {
+        return false;
+    }
+    done(context, PwmOff(channel));
+    return true;
+}
+
+bool PwmOnDutyAsync(uint8_t channel, uint16_t duty, PwmCompletionCallback done, void* context)
+{
+    if (channel >= PWM_MAX_CHANNELS) {
+        return false;
+    }
+    done(context, PwmOnDuty(channel, duty));
+    return true;
+}
+
+bool PwmReadback(uint8_t channel, bool* enabled, uint16_t* duty)
+{
+    if (channel >= PWM_MAX_CHANNELS) {
+        return false;
+    }
+    *enabled = m_enabled[channel];
+    *duty = m_duty[channel];
+    return true;
+}
+
+void PwmForceRefresh(uint8_t channel)
+{
+    (void)channel;
+}
+
+void PwmGetWriteCacheStats(PwmWriteCacheStats* stats)
+{
+    stats->hits = 0;
+    stats->misses = 0;
+}
+
+void PwmResetWriteCacheStats()
+{
+}
+
+uint16_t PwmFactoryTest()
+{
+    return 1;
+}
+
+void PwmFactoryTestBegin(PwmFactoryTestRun* run)
+{
+    run->step = 0;
+    run->device_id = 0xFFFF;
+}
+
+bool PwmFactoryTestStep(PwmFactoryTestRun* run)
+{
+    if (++run->step < PWM_FACTORY_TEST_STEPS) {
+        return false;
+    }
+    run->device_id = PwmFactoryTest();
+    return true;
+}
+
+bool PwmFactoryTestAsync(PwmFactoryTestCallback done, void* context)
+{
+    done(context, PwmFactoryTest());
+    return true;
+}
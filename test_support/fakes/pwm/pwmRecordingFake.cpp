@@ -0,0 +1,199 @@
+/// @brief  A lightweight recording fake of the PWM driver,
+///         see pwmRecordingFake.hpp.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#include "pwmRecordingFake.hpp"
+
+// the cpputest headers must always be last
+#include "CppUTest/TestHarness.h"
+
+namespace cms {
+namespace test {
+
+PwmRecordingFake& PwmRecordingFake::Instance()
+{
+    static PwmRecordingFake fake;
+    return fake;
+}
+
+void PwmRecordingFake::reset()
+{
+    mTotal = 0;
+    for (auto& counts : mCounts) {
+        counts.fill(0);
+    }
+    mEnabled.fill(false);
+    mDuty.fill(0);
+    mFactoryTestDeviceId = 1;
+}
+
+size_t PwmRecordingFake::count(Call call, uint8_t channel) const
+{
+    const auto& counts = mCounts[static_cast<size_t>(call)];
+    if (channel != ANY_CHANNEL) {
+        return (channel < PWM_MAX_CHANNELS) ? counts[channel] : 0;
+    }
+
+    size_t sum = 0;
+    for (auto count : counts) {
+        sum += count;
+    }
+    return sum;
+}
+
+const PwmRecordingFake::Record& PwmRecordingFake::at(size_t index) const
+{
+    //fails the test in any build, unlike assert() with NDEBUG
+    CHECK_TEXT(index < size(), "PwmRecordingFake::at() index beyond the retained log");
+    size_t const oldest = mTotal - size();
+    return mLog[(oldest + index) % LOG_CAPACITY];
+}
+
+void PwmRecordingFake::injectDrift(uint8_t channel, bool enabled, uint16_t duty)
+{
+    CHECK_TEXT(channel < PWM_MAX_CHANNELS, "PwmRecordingFake::injectDrift() invalid channel");
+    mEnabled[channel] = enabled;
+    mDuty[channel] = duty;
+}
+
+void PwmRecordingFake::record(Call call, uint8_t channel, uint16_t duty, float percent)
+{
+    mLog[mTotal % LOG_CAPACITY] = Record{call, channel, duty, percent};
+    ++mTotal;
+    if (channel < PWM_MAX_CHANNELS) {
+        ++mCounts[static_cast<size_t>(call)][channel];
+    }
+}
+
+bool PwmRecordingFake::write(uint8_t channel, bool enabled, uint16_t duty)
+{
+    if (channel >= PWM_MAX_CHANNELS) {
+        return false;
+    }
+    mEnabled[channel] = enabled;
+    mDuty[channel] = enabled ? duty : mDuty[channel];
+    return true;
+}
+
+bool PwmRecordingFake::readback(uint8_t channel, bool* enabled, uint16_t* duty) const
+{
+    if (channel >= PWM_MAX_CHANNELS) {
+        return false;
+    }
+    *enabled = mEnabled[channel];
+    *duty = mDuty[channel];
+    return true;
+}
+
+} // namespace test
+} // namespace cms
+
+using cms::test::PwmRecordingFake;
+using Call = PwmRecordingFake::Call;
+
+bool PwmInit()
+{
+    PwmRecordingFake::Instance().record(Call::INIT, 0);
+    return true;
+}
+
+bool PwmOff(uint8_t channel)
+{
+    auto& fake = PwmRecordingFake::Instance();
+    fake.record(Call::OFF, channel);
+    return fake.write(channel, false, 0);
+}
+
+bool PwmOn(uint8_t channel, float percent)
+{
+    auto& fake = PwmRecordingFake::Instance();
+    uint16_t const duty = PwmPercentToDuty(percent);
+    fake.record(Call::ON, channel, duty, percent);
+    return fake.write(channel, true, duty);
+}
+
+bool PwmOnDuty(uint8_t channel, uint16_t duty)
+{
+    auto& fake = PwmRecordingFake::Instance();
+    fake.record(Call::ON_DUTY, channel, duty);
+    return fake.write(channel, true, duty);
+}
+
+bool PwmOffAsync(uint8_t channel, PwmCompletionCallback done, void* context)
+{
+    if (channel >= PWM_MAX_CHANNELS) {
+        return false;
+    }
+    done(context, PwmOff(channel));
+    return true;
+}
+
+bool PwmOnDutyAsync(uint8_t channel, uint16_t duty, PwmCompletionCallback done, void* context)
+{
+    if (channel >= PWM_MAX_CHANNELS) {
+        return false;
+    }
+    done(context, PwmOnDuty(channel, duty));
+    return true;
+}
+
+bool PwmReadback(uint8_t channel, bool* enabled, uint16_t* duty)
+{
+    auto& fake = PwmRecordingFake::Instance();
+    fake.record(Call::READBACK, channel);
+    return fake.readback(channel, enabled, duty);
+}
+
+void PwmForceRefresh(uint8_t channel)
+{
+    PwmRecordingFake::Instance().record(Call::FORCE_REFRESH, channel);
+}
+
+void PwmGetWriteCacheStats(PwmWriteCacheStats* stats)
+{
+    stats->hits = 0;
+    stats->misses = 0;
+}
+
+void PwmResetWriteCacheStats()
+{
+}
+
+uint16_t PwmFactoryTest()
+{
+    auto& fake = PwmRecordingFake::Instance();
+    fake.record(Call::FACTORY_TEST, 0);
+    return fake.factoryTestDeviceId();
+}
+
+void PwmFactoryTestBegin(PwmFactoryTestRun* run)
+{
+    run->step = 0;
+    run->device_id = 0xFFFF;
+}
+
+bool PwmFactoryTestStep(PwmFactoryTestRun* run)
+{
+    if (++run->step < PWM_FACTORY_TEST_STEPS) {
+        return false;
+    }
+    run->device_id = PwmFactoryTest();
+    return true;
+}
+
+bool PwmFactoryTestAsync(PwmFactoryTestCallback done, void* context)
+{
+    done(context, PwmFactoryTest());
+    return true;
+}
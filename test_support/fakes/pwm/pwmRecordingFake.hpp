@@ -0,0 +1,110 @@
+/// @brief  A lightweight recording fake of the PWM driver (pwm.h), for
+///         long simulations (soak tests) where the string keyed lookups
+///         of the cpputest mock (mocks/pwm/pwm.cpp) would dominate the
+///         run time. Calls are appended to a preallocated, typed call log
+///         and counted, and the fake models the hardware state, so a read
+///         back reports the last written values unless drift is injected.
+///         Link this module instead of the mock, one or the other per
+///         test executable. Asynchronous operations complete immediately.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#ifndef CMS_PWM_RECORDING_FAKE_HPP
+#define CMS_PWM_RECORDING_FAKE_HPP
+
+#include "pwm.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace cms {
+namespace test {
+
+class PwmRecordingFake
+{
+public:
+    enum class Call : uint8_t
+    {
+        INIT,
+        OFF,
+        ON,
+        ON_DUTY,
+        READBACK,
+        FORCE_REFRESH,
+        FACTORY_TEST,
+        COUNT
+    };
+
+    /// Async variants are recorded as their synchronous call.
+    struct Record
+    {
+        Call call;
+        uint8_t channel;  // 0 when not applicable
+        uint16_t duty;    // ON_DUTY, or ON converted to an integer duty
+        float percent;    // ON only
+    };
+
+    /// The log keeps the most recent LOG_CAPACITY calls, counts are exact.
+    static constexpr size_t LOG_CAPACITY = 4096;
+
+    static constexpr uint8_t ANY_CHANNEL = 0xFF;
+
+    static PwmRecordingFake& Instance();
+
+    /// Clear the log, the counts and the injected drift, and
+    /// turn every (modeled) hardware channel off. Call from setup().
+    void reset();
+
+    /// Total number of calls of a kind, for one or any channel.
+    size_t count(Call call, uint8_t channel = ANY_CHANNEL) const;
+
+    /// Total number of calls of every kind.
+    size_t total() const { return mTotal; }
+
+    /// Number of calls retained in the log, at most LOG_CAPACITY.
+    size_t size() const { return (mTotal < LOG_CAPACITY) ? mTotal : LOG_CAPACITY; }
+
+    /// Retained call, 0 is the oldest retained, size()-1 the newest.
+    const Record& at(size_t index) const;
+
+    /// The newest call, the log must not be empty.
+    const Record& last() const { return at(size() - 1); }
+
+    /// The hardware of the channel drifts to the given state,
+    /// until the channel is next written.
+    void injectDrift(uint8_t channel, bool enabled, uint16_t duty);
+
+    /// Device ID reported by the factory test, default 1.
+    void setFactoryTestDeviceId(uint16_t id) { mFactoryTestDeviceId = id; }
+
+    // driver (pwm.h) implementation, called by the C entry points
+    void record(Call call, uint8_t channel, uint16_t duty = 0, float percent = 0.0f);
+    bool write(uint8_t channel, bool enabled, uint16_t duty);
+    bool readback(uint8_t channel, bool* enabled, uint16_t* duty) const;
+    uint16_t factoryTestDeviceId() const { return mFactoryTestDeviceId; }
+
+private:
+    PwmRecordingFake() = default;
+
+    std::array<Record, LOG_CAPACITY> mLog{};
+    size_t mTotal = 0;
+    std::array<std::array<uint32_t, PWM_MAX_CHANNELS>, static_cast<size_t>(Call::COUNT)> mCounts{};
+    std::array<bool, PWM_MAX_CHANNELS> mEnabled{};
+    std::array<uint16_t, PWM_MAX_CHANNELS> mDuty{};
+    uint16_t mFactoryTestDeviceId = 1;
+};
+
+} // namespace test
+} // namespace cms
+
+#endif // CMS_PWM_RECORDING_FAKE_HPP
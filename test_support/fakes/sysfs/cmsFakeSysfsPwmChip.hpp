@@ -0,0 +1,124 @@
+/// @brief  A fake sysfs PWM chip (as found in /sys/class/pwm), built
+///         as a tree of plain files in a temporary directory, for the
+///         tests and benchmark of the Linux sysfs PWM backend
+///         (pwmLinuxSysfs.h). Each exported channel is a pwm<N>
+///         directory holding period, duty_cycle and enable files.
+///         Unlike sysfs, a write to a plain file only overwrites its
+///         first bytes, so a value is read as the file's first line,
+///         as the backend writes each value followed by a newline.
+///         The tree is removed when the fake is destroyed.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#ifndef CMS_FAKE_SYSFS_PWM_CHIP_HPP
+#define CMS_FAKE_SYSFS_PWM_CHIP_HPP
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <ftw.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cms {
+namespace test {
+
+class FakeSysfsPwmChip
+{
+public:
+    /// A chip of npwm PWMs, of which the first exported are exported.
+    FakeSysfsPwmChip(unsigned npwm, unsigned exported)
+    {
+        char pattern[] = "/tmp/cmsFakeSysfsPwmChipXXXXXX";
+        if (mkdtemp(pattern) != nullptr) {
+            mPath = pattern;
+        }
+        write("npwm", std::to_string(npwm) + "\n");
+        write("export", "");
+        write("unexport", "");
+        for (unsigned channel = 0; channel < exported; ++channel) {
+            exportChannel(channel);
+        }
+    }
+
+    ~FakeSysfsPwmChip()
+    {
+        if (!mPath.empty()) {
+            nftw(mPath.c_str(), &RemoveEntry, 8, FTW_DEPTH | FTW_PHYS);
+        }
+    }
+
+    FakeSysfsPwmChip(const FakeSysfsPwmChip&) = delete;
+    FakeSysfsPwmChip& operator=(const FakeSysfsPwmChip&) = delete;
+
+    bool isValid() const { return !mPath.empty(); }
+    const std::string& path() const { return mPath; }
+
+    /// What the kernel does on a write to the chip's export file.
+    void exportChannel(unsigned channel)
+    {
+        const std::string dir = channelFile(channel, "");
+        mkdir(dir.c_str(), 0755);
+        write(channelFile(channel, "period"), "0\n");
+        write(channelFile(channel, "duty_cycle"), "0\n");
+        write(channelFile(channel, "enable"), "0\n");
+    }
+
+    /// The value of a channel's attribute (period, duty_cycle or enable).
+    std::string value(unsigned channel, const char* attribute) const
+    {
+        return firstLine(channelFile(channel, attribute));
+    }
+
+    /// The last channel written to the export file.
+    std::string exported() const { return firstLine(mPath + "/export"); }
+
+    /// Change a channel's attribute behind the backend's back, e.g. drift.
+    void set(unsigned channel, const char* attribute, const std::string& value)
+    {
+        write(channelFile(channel, attribute), value + "\n");
+    }
+
+private:
+    std::string mPath;
+
+    std::string channelFile(unsigned channel, const char* attribute) const
+    {
+        return mPath + "/pwm" + std::to_string(channel) + "/" + attribute;
+    }
+
+    void write(const std::string& file, const std::string& content)
+    {
+        const std::string path = (file[0] == '/') ? file : mPath + "/" + file;
+        std::ofstream(path, std::ios::trunc) << content;
+    }
+
+    static std::string firstLine(const std::string& path)
+    {
+        std::ifstream in(path);
+        std::string line;
+        std::getline(in, line);
+        return line;
+    }
+
+    static int RemoveEntry(const char* path, const struct stat*, int, struct FTW*)
+    {
+        return std::remove(path);
+    }
+};
+
+} // namespace test
+} // namespace cms
+
+#endif // CMS_FAKE_SYSFS_PWM_CHIP_HPP
@@ -0,0 +1,334 @@
+/// @brief  Static RAM/ROM footprint report, from the link map of an image
+///         (GNU ld, -Wl,-Map). The input sections of the objects of each
+///         module are summed by kind (text, rodata, data, bss), and the
+///         RAM of each module is listed by symbol, when the objects are
+///         built with -ffunction-sections -fdata-sections. A module over
+///         its RAM or ROM budget fails the report (exit status 1), so a
+///         build target running the report fails on a size regression.
+///
+///         usage: cmsFootprintReport <link map> <module> ...
+///           module: <name>:<object>[+<object>...]:<max RAM>:<max ROM>
+///           where an object is matched by its file name (e.g. pwm.c.o,
+///           also within an archive) and a budget of 0 is unlimited.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+enum Kind { TEXT, RODATA, DATA, BSS, KIND_COUNT };
+
+struct InputSection
+{
+    std::string name;
+    uint64_t size;
+    std::string object;
+};
+
+struct Symbol
+{
+    std::string name;
+    Kind kind;
+    uint64_t size;
+};
+
+struct Module
+{
+    std::string name;
+    std::vector<std::string> objects;
+    uint64_t maxRam = 0;
+    uint64_t maxRom = 0;
+
+    uint64_t bytes[KIND_COUNT] = {};
+    std::vector<Symbol> ram;
+    size_t sections = 0;
+
+    uint64_t rom() const { return bytes[TEXT] + bytes[RODATA] + bytes[DATA]; }
+    uint64_t ramBytes() const { return bytes[DATA] + bytes[BSS]; }
+};
+
+struct SectionKind
+{
+    const char* prefix;
+    Kind kind;
+};
+
+// Longest prefix first: relocated read only data is ROM on a target.
+const SectionKind SECTION_KINDS[] = {
+  {".data.rel.ro.local", RODATA},
+  {".data.rel.ro", RODATA},
+  {".data.rel.local", DATA},
+  {".data.rel", DATA},
+  {".rodata", RODATA},
+  {".data", DATA},
+  {".bss", BSS},
+  {".text", TEXT},
+  {"COMMON", BSS},
+};
+
+// the kind of an input section, and the symbol it holds (the
+// section name's suffix, empty unless built with -f*-sections)
+bool Classify(const std::string& section, Kind& kind, std::string& symbol)
+{
+    for (const auto& candidate : SECTION_KINDS) {
+        const size_t length = std::strlen(candidate.prefix);
+        if (section.compare(0, length, candidate.prefix) != 0) {
+            continue;
+        }
+        if (section.size() == length) {
+            kind = candidate.kind;
+            symbol.clear();
+            return true;
+        }
+        if (section[length] == '.') {
+            kind = candidate.kind;
+            symbol = section.substr(length + 1U);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string Demangle(const std::string& symbol)
+{
+    if (symbol.empty()) {
+        return "(unnamed)";
+    }
+    int status = 0;
+    std::unique_ptr<char, decltype(&std::free)> demangled(
+      abi::__cxa_demangle(symbol.c_str(), nullptr, nullptr, &status), &std::free);
+    return (status == 0) ? std::string(demangled.get()) : symbol;
+}
+
+bool IsHex(const std::string& token)
+{
+    return (token.size() > 2U) && (token.compare(0, 2, "0x") == 0);
+}
+
+bool Matches(const std::string& path, const std::string& object)
+{
+    if (path == object) {
+        return true;
+    }
+    const auto endsWith = [&path](const std::string& suffix) {
+        return (path.size() >= suffix.size()) &&
+               (path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0);
+    };
+    return endsWith("/" + object) || endsWith("(" + object + ")");
+}
+
+const char* const MEMORY_MAP = "Linker script and memory map";
+
+// The input sections of the memory map of a GNU ld map file. A long
+// section name is on a line of its own, followed by its address, size
+// and object on the next line.
+bool LoadMap(const char* path, std::vector<InputSection>& sections)
+{
+    std::ifstream in(path);
+    if (!in) {
+        std::fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+
+    std::string line;
+    bool inMemoryMap = false;
+    std::string pending;
+    while (std::getline(in, line)) {
+        if (!inMemoryMap) {
+            inMemoryMap = (line.compare(0, std::strlen(MEMORY_MAP), MEMORY_MAP) == 0);
+            continue;
+        }
+        if (line.empty() || (line[0] != ' ')) {
+            pending.clear(); // an output section, or a script statement
+            continue;
+        }
+
+        std::istringstream fields(line);
+        std::vector<std::string> tokens;
+        for (std::string token; fields >> token;) {
+            tokens.push_back(token);
+        }
+        if (tokens.empty() || (tokens[0][0] == '*')) {
+            continue; // *fill*, or an input section description
+        }
+
+        if ((line[1] != ' ') && !IsHex(tokens[0])) {
+            if (tokens.size() == 1U) {
+                pending = tokens[0];
+            }
+            else if ((tokens.size() >= 4U) && IsHex(tokens[1]) && IsHex(tokens[2])) {
+                sections.push_back({tokens[0], std::strtoull(tokens[2].c_str(), nullptr, 16), tokens[3]});
+                pending.clear();
+            }
+            continue;
+        }
+
+        if (!pending.empty() && (tokens.size() >= 3U) && IsHex(tokens[0]) && IsHex(tokens[1])) {
+            sections.push_back({pending, std::strtoull(tokens[1].c_str(), nullptr, 16), tokens[2]});
+        }
+        pending.clear(); // else a symbol, of the previous section
+    }
+
+    if (!inMemoryMap) {
+        std::fprintf(stderr, "%s: not a GNU ld link map\n", path);
+        return false;
+    }
+    return true;
+}
+
+bool ParseModule(const char* spec, Module& module)
+{
+    std::vector<std::string> fields;
+    std::istringstream in(spec);
+    for (std::string field; std::getline(in, field, ':');) {
+        fields.push_back(field);
+    }
+    if ((fields.size() != 4U) || fields[0].empty() || fields[1].empty()) {
+        return false;
+    }
+
+    module.name = fields[0];
+    std::istringstream objects(fields[1]);
+    for (std::string object; std::getline(objects, object, '+');) {
+        module.objects.push_back(object);
+    }
+
+    char* end = nullptr;
+    module.maxRam = std::strtoull(fields[2].c_str(), &end, 0);
+    if ((end == fields[2].c_str()) || (*end != '\0')) {
+        return false;
+    }
+    module.maxRom = std::strtoull(fields[3].c_str(), &end, 0);
+    return (end != fields[3].c_str()) && (*end == '\0');
+}
+
+void Account(const std::vector<InputSection>& sections, Module& module)
+{
+    for (const InputSection& section : sections) {
+        Kind kind;
+        std::string symbol;
+        if ((section.size == 0U) || !Classify(section.name, kind, symbol)) {
+            continue;
+        }
+        const bool ours = std::any_of(module.objects.begin(), module.objects.end(),
+                                      [&section](const std::string& object) {
+                                          return Matches(section.object, object);
+                                      });
+        if (!ours) {
+            continue;
+        }
+
+        ++module.sections;
+        module.bytes[kind] += section.size;
+        if ((kind == DATA) || (kind == BSS)) {
+            module.ram.push_back({Demangle(symbol), kind, section.size});
+        }
+    }
+    std::stable_sort(module.ram.begin(), module.ram.end(),
+                     [](const Symbol& a, const Symbol& b) { return a.size > b.size; });
+}
+
+void PrintBudget(uint64_t budget)
+{
+    if (budget == 0U) {
+        std::printf(" %8s", "-");
+    }
+    else {
+        std::printf(" %8" PRIu64, budget);
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::fprintf(stderr, "usage: %s <link map> <name>:<object>[+<object>...]:<max RAM>:<max ROM> ...\n",
+                     argv[0]);
+        return 2;
+    }
+
+    std::vector<Module> modules(static_cast<size_t>(argc - 2));
+    for (int i = 2; i < argc; ++i) {
+        if (!ParseModule(argv[i], modules[static_cast<size_t>(i - 2)])) {
+            std::fprintf(stderr, "%s: bad module '%s'\n", argv[0], argv[i]);
+            return 2;
+        }
+    }
+
+    std::vector<InputSection> sections;
+    if (!LoadMap(argv[1], sections)) {
+        return 2;
+    }
+
+    for (Module& module : modules) {
+        Account(sections, module);
+        if (module.sections == 0U) {
+            // a renamed object, or a map of another linker: never report zero
+            std::fprintf(stderr, "%s: no sections of module %s in %s\n", argv[0], module.name.c_str(), argv[1]);
+            return 2;
+        }
+    }
+
+    std::printf("footprint of %s (bytes)\n\n", argv[1]);
+    std::printf("%-24s %8s %8s %8s %8s %8s %8s %8s %8s\n", "module", "text", "rodata", "data", "bss",
+                "ROM", "budget", "RAM", "budget");
+    uint64_t totalRom = 0;
+    uint64_t totalRam = 0;
+    for (const Module& module : modules) {
+        std::printf("%-24s %8" PRIu64 " %8" PRIu64 " %8" PRIu64 " %8" PRIu64 " %8" PRIu64, module.name.c_str(),
+                    module.bytes[TEXT], module.bytes[RODATA], module.bytes[DATA], module.bytes[BSS], module.rom());
+        PrintBudget(module.maxRom);
+        std::printf(" %8" PRIu64, module.ramBytes());
+        PrintBudget(module.maxRam);
+        std::printf("\n");
+        totalRom += module.rom();
+        totalRam += module.ramBytes();
+    }
+    std::printf("%-24s %8s %8s %8s %8s %8" PRIu64 " %8s %8" PRIu64 "\n\n", "total", "", "", "", "", totalRom, "",
+                totalRam);
+
+    std::printf("%-24s %-40s %-4s %8s\n", "RAM of module", "symbol", "kind", "bytes");
+    for (const Module& module : modules) {
+        for (const Symbol& symbol : module.ram) {
+            std::printf("%-24s %-40s %-4s %8" PRIu64 "\n", module.name.c_str(), symbol.name.c_str(),
+                        (symbol.kind == DATA) ? "data" : "bss", symbol.size);
+        }
+    }
+
+    int status = 0;
+    for (const Module& module : modules) {
+        if ((module.maxRom != 0U) && (module.rom() > module.maxRom)) {
+            std::printf("\nFAILED: %s ROM of %" PRIu64 " bytes exceeds its budget of %" PRIu64 "\n",
+                        module.name.c_str(), module.rom(), module.maxRom);
+            status = 1;
+        }
+        if ((module.maxRam != 0U) && (module.ramBytes() > module.maxRam)) {
+            std::printf("\nFAILED: %s RAM of %" PRIu64 " bytes exceeds its budget of %" PRIu64 "\n",
+                        module.name.c_str(), module.ramBytes(), module.maxRam);
+            status = 1;
+        }
+    }
+    return status;
+}
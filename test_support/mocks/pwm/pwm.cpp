@@ -23,8 +23,107 @@ Copyright (c) <2019-2024> <Matthew Eshleman - https://covemountainsoftware.com>
 */
 
 #include "pwm.h"
+#include "pwmMockAsync.hpp"
+#include <deque>
+#include <vector>
 #include "CppUTestExt/MockSupport.h"
 
+namespace {
+
+struct PendingCompletion {
+    std::chrono::milliseconds remaining;
+    PwmCompletionCallback done;
+    PwmFactoryTestCallback factoryTestDone;
+    void* context;
+    bool ok;
+    uint16_t deviceId;
+};
+
+std::chrono::milliseconds s_completionDelay{0};
+bool s_completionResult = true;
+std::deque<PendingCompletion> s_pending;
+
+void complete(const PendingCompletion& completion)
+{
+    if (completion.factoryTestDone != nullptr) {
+        completion.factoryTestDone(completion.context, completion.deviceId);
+    }
+    else {
+        completion.done(completion.context, completion.ok);
+    }
+}
+
+void schedule(const PendingCompletion& completion)
+{
+    if (completion.remaining.count() <= 0) {
+        complete(completion);
+    }
+    else {
+        s_pending.push_back(completion);
+    }
+}
+
+} //namespace
+
+namespace cms {
+namespace test {
+namespace pwm_mock {
+
+void SetCompletionDelay(std::chrono::milliseconds delay)
+{
+    s_completionDelay = delay;
+}
+
+void SetCompletionResult(bool ok)
+{
+    s_completionResult = ok;
+}
+
+void AdvanceTime(std::chrono::milliseconds elapsed)
+{
+    //collect first, a callback may start another operation
+    std::vector<PendingCompletion> due;
+    for (auto it = s_pending.begin(); it != s_pending.end();) {
+        it->remaining -= elapsed;
+        if (it->remaining.count() <= 0) {
+            due.push_back(*it);
+            it = s_pending.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    for (const auto& completion : due) {
+        complete(completion);
+    }
+}
+
+void CompleteAll()
+{
+    while (!s_pending.empty()) {
+        PendingCompletion completion = s_pending.front();
+        s_pending.pop_front();
+        complete(completion);
+    }
+}
+
+size_t PendingCount()
+{
+    return s_pending.size();
+}
+
+void Reset()
+{
+    s_pending.clear();
+    s_completionDelay = std::chrono::milliseconds{0};
+    s_completionResult = true;
+}
+
+} //namespace pwm_mock
+} //namespace test
+} //namespace cms
+
 bool PwmInit()
 {
     mock()
@@ -32,24 +131,116 @@ bool PwmInit()
     return mock().returnBoolValueOrDefault(true);
 }
 
-bool PwmOff()
+bool PwmOff(uint8_t channel)
 {
     mock()
-      .actualCall("PwmOff");
+      .actualCall("PwmOff")
+      .withParameter("channel", channel);
     return mock().returnBoolValueOrDefault(true);
 }
 
-bool PwmOn(float percent)
+bool PwmOn(uint8_t channel, float percent)
 {
     mock()
       .actualCall("PwmOn")
+      .withParameter("channel", channel)
       .withParameter("percent", percent);
     return mock().returnBoolValueOrDefault(true);
 }
 
+bool PwmOnDuty(uint8_t channel, uint16_t duty)
+{
+    mock()
+      .actualCall("PwmOnDuty")
+      .withParameter("channel", channel)
+      .withParameter("duty", duty);
+    return mock().returnBoolValueOrDefault(true);
+}
+
+bool PwmOffAsync(uint8_t channel, PwmCompletionCallback done, void* context)
+{
+    mock()
+      .actualCall("PwmOffAsync")
+      .withParameter("channel", channel);
+    bool started = mock().returnBoolValueOrDefault(true);
+    if (started) {
+        schedule({s_completionDelay, done, nullptr, context, s_completionResult, 0});
+    }
+    return started;
+}
+
+bool PwmOnDutyAsync(uint8_t channel, uint16_t duty, PwmCompletionCallback done, void* context)
+{
+    mock()
+      .actualCall("PwmOnDutyAsync")
+      .withParameter("channel", channel)
+      .withParameter("duty", duty);
+    bool started = mock().returnBoolValueOrDefault(true);
+    if (started) {
+        schedule({s_completionDelay, done, nullptr, context, s_completionResult, 0});
+    }
+    return started;
+}
+
+bool PwmReadback(uint8_t channel, bool* enabled, uint16_t* duty)
+{
+    mock()
+      .actualCall("PwmReadback")
+      .withParameter("channel", channel)
+      .withOutputParameter("enabled", enabled)
+      .withOutputParameter("duty", duty);
+    return mock().returnBoolValueOrDefault(true);
+}
+
+void PwmForceRefresh(uint8_t channel)
+{
+    mock()
+      .actualCall("PwmForceRefresh")
+      .withParameter("channel", channel);
+}
+
+void PwmGetWriteCacheStats(PwmWriteCacheStats* stats)
+{
+    mock()
+      .actualCall("PwmGetWriteCacheStats")
+      .withOutputParameter("stats", stats);
+}
+
+void PwmResetWriteCacheStats()
+{
+    mock()
+      .actualCall("PwmResetWriteCacheStats");
+}
+
 uint16_t PwmFactoryTest()
 {
     mock()
       .actualCall("PwmFactoryTest");
     return mock().returnUnsignedIntValueOrDefault(0xFFFF);
 }
+
+void PwmFactoryTestBegin(PwmFactoryTestRun* run)
+{
+    mock()
+      .actualCall("PwmFactoryTestBegin");
+    run->step = 0;
+    run->device_id = 0xFFFF;
+}
+
+bool PwmFactoryTestStep(PwmFactoryTestRun* run)
+{
+    mock()
+      .actualCall("PwmFactoryTestStep")
+      .withOutputParameter("device_id", &run->device_id);
+    ++run->step;
+    return mock().returnBoolValueOrDefault(true);
+}
+
+bool PwmFactoryTestAsync(PwmFactoryTestCallback done, void* context)
+{
+    mock()
+      .actualCall("PwmFactoryTestAsync");
+    auto deviceId = static_cast<uint16_t>(mock().returnUnsignedIntValueOrDefault(0xFFFF));
+    schedule({s_completionDelay, nullptr, done, context, true, deviceId});
+    return true;
+}
@@ -0,0 +1,54 @@
+/// @brief Control of the asynchronous operations of the PWM driver mock.
+///        The mock's *Async() functions record the call with cpputest
+///        mock(), like the synchronous functions, and then complete the
+///        operation after a controllable delay.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#ifndef PWM_MOCK_ASYNC_HPP
+#define PWM_MOCK_ASYNC_HPP
+
+#include <chrono>
+#include <cstddef>
+
+namespace cms {
+namespace test {
+namespace pwm_mock {
+
+/// Delay of operations started after this call. A zero delay (the default)
+/// completes an operation from within the *Async() call itself.
+void SetCompletionDelay(std::chrono::milliseconds delay);
+
+/// Result reported by PwmOffAsync() and PwmOnDutyAsync() completions
+/// started after this call. Default true. The device ID reported by
+/// PwmFactoryTestAsync() is the mock's return value (default 0xFFFF).
+void SetCompletionResult(bool ok);
+
+/// Advance the mock's time, completing (calling back) every pending
+/// operation whose delay has elapsed, in the order they were started.
+void AdvanceTime(std::chrono::milliseconds elapsed);
+
+/// Complete every pending operation, regardless of its delay.
+void CompleteAll();
+
+/// Number of started operations not yet completed.
+size_t PendingCount();
+
+/// Drop pending operations and restore the defaults. Call from teardown().
+void Reset();
+
+} //namespace pwm_mock
+} //namespace test
+} //namespace cms
+
+#endif //PWM_MOCK_ASYNC_HPP
@@ -0,0 +1,191 @@
+/// @brief  Pieces shared by the harnesses of the PwmService (the unit,
+///         soak and fuzz tests, and the stress harness): the event pools
+///         of the tests, a counter of the events dispatched to the
+///         service, and a requester of factory tests.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#ifndef CMS_PWM_SERVICE_HARNESS_HPP
+#define CMS_PWM_SERVICE_HARNESS_HPP
+
+#include "qpc.h"
+#include "pwmService.h"
+#include "pwmServicePools.hpp"
+#include "pub_sub_signals.h"
+#include "cmsDispatchInterposer.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// The stress harness runs on the QP/C POSIX port, without the QF control
+// of cpputest-for-qpc, and defines CMS_PWM_SERVICE_HARNESS_WITHOUT_QF_CTRL.
+#ifndef CMS_PWM_SERVICE_HARNESS_WITHOUT_QF_CTRL
+#include "cms_cpputest_qf_ctrl.hpp"
+#endif
+
+namespace cms {
+namespace test {
+
+/// Events of each pool of PwmServiceTestPools().
+constexpr size_t PWM_SERVICE_TEST_EVENTS_PER_POOL = 20;
+
+#ifndef CMS_PWM_SERVICE_HARNESS_WITHOUT_QF_CTRL
+/// The event pools of the tests, for qf_ctrl::Setup(), laid out for
+/// the service's events (see pwmServicePools.hpp).
+inline qf_ctrl::MemPoolConfigs PwmServiceTestPools()
+{
+    qf_ctrl::MemPoolConfigs pools;
+    for (auto blockSize : PwmServiceEventPools::blockSizes()) {
+        pools.push_back({blockSize, PWM_SERVICE_TEST_EVENTS_PER_POOL});
+    }
+    return pools;
+}
+#endif
+
+/// Allocates every free event of the pool of eventSize (at most max),
+/// and gives them all back. Returns the count allocated.
+inline size_t CountFreeEvents(size_t eventSize, size_t max = 4 * PWM_SERVICE_TEST_EVENTS_PER_POOL)
+{
+    std::array<QEvt*, 4 * PWM_SERVICE_TEST_EVENTS_PER_POOL> events;
+    size_t count = 0;
+    while ((count < max) && (count < events.size())) {
+        QEvt* const e = QF_newX_(static_cast<uint_fast16_t>(eventSize), 0U, Q_USER_SIG);
+        if (e == nullptr) {
+            break;
+        }
+        events[count++] = e;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        QF_gc(events[i]);
+    }
+    return count;
+}
+
+/// Counts the events dispatched to an active object, by interposing on
+/// its dispatch (see DispatchInterposer). One active object at a time.
+/// The count may be read from any thread.
+class DispatchCounter
+{
+public:
+    /// Start counting the events dispatched to ao, from zero.
+    static void Attach(QActive* ao)
+    {
+        Interposer::Reset();
+        Dispatched().store(0U, std::memory_order_relaxed);
+        (void)Interposer::Attach(ao);
+    }
+
+    /// Restore the active object's own virtual table.
+    static void Detach() { Interposer::Detach(); }
+
+    static uint64_t Count() { return Dispatched().load(std::memory_order_relaxed); }
+
+private:
+    static void Dispatch(QAsm* const me, QEvt const* const e, uint_fast8_t const qsId)
+    {
+        Interposer::Original(me)(me, e, qsId);
+        Dispatched().fetch_add(1U, std::memory_order_relaxed);
+    }
+
+    using Interposer = DispatchInterposer<&Dispatch, 1>;
+
+    static std::atomic<uint64_t>& Dispatched()
+    {
+        static std::atomic<uint64_t> dispatched {0};
+        return dispatched;
+    }
+};
+
+constexpr QSignal FACTORY_TEST_RESPONSE_SIG = MAX_PWM_POSTED_SIGNALS;
+constexpr QSignal FACTORY_TEST_PROGRESS_SIG = MAX_PWM_POSTED_SIGNALS + 1;
+
+/// The requester of factory tests, and optionally a subscriber of the
+/// service's status. Counts each kind of event received.
+struct FactoryTestClient
+{
+    QActive super;
+    std::array<const QEvt*, 10> queueStorage;
+    bool subscribeToStatus;
+    uint64_t onStatus;
+    uint64_t offStatus;
+    uint64_t factoryResponses;
+    uint64_t factoryProgress;
+
+    /// Construct and start the client, with its counts at zero.
+    void start(uint_fast8_t priority, bool subscribe)
+    {
+        *this = FactoryTestClient {};
+        subscribeToStatus = subscribe;
+        QActive_ctor(&super, Q_STATE_CAST(&FactoryTestClient::initial));
+        QACTIVE_START(&super, priority, queueStorage.data(), queueStorage.size(), nullptr, 0, nullptr);
+    }
+
+    void resetCounts()
+    {
+        onStatus = 0;
+        offStatus = 0;
+        factoryResponses = 0;
+        factoryProgress = 0;
+    }
+
+    /// A factory test request of this client, to be posted to the service.
+    PwmServiceFactoryTestRequestEvent* newRequest(bool progress)
+    {
+        auto e = Q_NEW(PwmServiceFactoryTestRequestEvent, PWM_REQUEST_FACTORY_TEST_SIG);
+        e->requester = &super;
+        e->response_sig = FACTORY_TEST_RESPONSE_SIG;
+        e->response = nullptr;
+        e->progress_sig = progress ? FACTORY_TEST_PROGRESS_SIG : 0U;
+        return e;
+    }
+
+    static QState initial(FactoryTestClient* const me, void const* const par)
+    {
+        Q_UNUSED_PAR(par);
+        if (me->subscribeToStatus) {
+            QActive_subscribe(&me->super, PWM_IS_ON_SIG);
+            QActive_subscribe(&me->super, PWM_IS_OFF_SIG);
+        }
+        return Q_TRAN(&active);
+    }
+
+    static QState active(FactoryTestClient* const me, QEvt const* const e)
+    {
+        switch (e->sig) {
+            case Q_ENTRY_SIG:
+            case Q_EXIT_SIG:
+                return Q_HANDLED();
+            case PWM_IS_ON_SIG:
+                ++me->onStatus;
+                return Q_HANDLED();
+            case PWM_IS_OFF_SIG:
+                ++me->offStatus;
+                return Q_HANDLED();
+            case FACTORY_TEST_RESPONSE_SIG:
+                ++me->factoryResponses;
+                return Q_HANDLED();
+            case FACTORY_TEST_PROGRESS_SIG:
+                ++me->factoryProgress;
+                return Q_HANDLED();
+            default:
+                break;
+        }
+        return Q_SUPER(&QHsm_top);
+    }
+};
+
+} // namespace test
+} // namespace cms
+
+#endif // CMS_PWM_SERVICE_HARNESS_HPP
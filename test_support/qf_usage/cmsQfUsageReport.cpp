@@ -0,0 +1,161 @@
+/// @brief  See cmsQfUsageReport.hpp
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#include "cmsQfUsageReport.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+namespace cms {
+namespace test {
+
+QfUsageReport& QfUsageReport::Instance()
+{
+    // never destroyed, so that the exit hook may still use it
+    static QfUsageReport* const report = [] {
+        auto* created = new QfUsageReport();
+        std::atexit(&QfUsageReport::WriteAtExit);
+        return created;
+    }();
+    return *report;
+}
+
+void QfUsageReport::WriteAtExit()
+{
+    const QfUsageReport& report = Instance();
+    if (!report.mTests.empty() && !report.write()) {
+        fprintf(stderr, "QfUsageReport: failed to write %s\n", Path().c_str());
+    }
+}
+
+std::string QfUsageReport::Path()
+{
+    const char* const path = std::getenv("CMS_QF_USAGE_REPORT");
+    return ((path != nullptr) && (path[0] != '\0')) ? path : CMS_QF_USAGE_REPORT_FILE;
+}
+
+bool QfUsageReport::write() const
+{
+    FILE* const out = fopen(Path().c_str(), "w");
+    if (out == nullptr) {
+        return false;
+    }
+    print(out);
+    return fclose(out) == 0;
+}
+
+void QfUsageReport::beginTest(const char* group, const char* test,
+                              const std::vector<size_t>& poolBlockSizes)
+{
+    mPoolBlockSizes = poolBlockSizes;
+    mPoolCapacities.clear();
+
+    // nothing has been allocated yet, so the minimum number
+    // of free blocks is the capacity of each pool.
+    for (size_t i = 0; i < mPoolBlockSizes.size(); ++i) {
+        mPoolCapacities.push_back(QF_getPoolMin(static_cast<uint_fast8_t>(i + 1)));
+    }
+
+    mTests.push_back(TestUsage{std::string(group) + "." + test, {}, {}});
+}
+
+void QfUsageReport::recordQueues(const std::map<uint_fast8_t, std::string>& names)
+{
+    if (mTests.empty()) {
+        return;
+    }
+
+    for (uint_fast8_t prio = 1U; prio <= QF_MAX_ACTIVE; ++prio) {
+        const QActive* const ao = QActive_registry_[prio];
+        if (ao == nullptr) {
+            continue;
+        }
+
+        const auto named = names.find(prio);
+        const std::string name = (named != names.end()) ? named->second : "ao" + std::to_string(prio);
+
+        // QEQueue holds one more event than its ring buffer (the front event)
+        const size_t capacity = static_cast<size_t>(ao->eQueue.end) + 1;
+        const size_t minFree  = QEQueue_getNMin(&ao->eQueue);
+        mTests.back().queues.push_back(Usage{name, 0, capacity, capacity - minFree});
+    }
+}
+
+void QfUsageReport::endTest()
+{
+    if (mTests.empty()) {
+        return;
+    }
+
+    for (size_t i = 0; i < mPoolBlockSizes.size(); ++i) {
+        const size_t minFree = QF_getPoolMin(static_cast<uint_fast8_t>(i + 1));
+        mTests.back().pools.push_back(Usage{"pool" + std::to_string(i + 1),
+                                            mPoolBlockSizes[i],
+                                            mPoolCapacities[i],
+                                            mPoolCapacities[i] - minFree});
+    }
+}
+
+static void printUsages(FILE* out, const char* key, const std::vector<QfUsageReport::Usage>& usages)
+{
+    fprintf(out, "\"%s\":[", key);
+    for (size_t i = 0; i < usages.size(); ++i) {
+        const auto& u = usages[i];
+        fprintf(out, "%s{\"name\":\"%s\",\"block_size\":%zu,\"capacity\":%zu,\"peak_used\":%zu}",
+                (i == 0) ? "" : ",", u.name.c_str(), u.blockSize, u.capacity, u.peakUsed);
+    }
+    fprintf(out, "]");
+}
+
+void QfUsageReport::print(FILE* out) const
+{
+    // the peak across all tests is what the firmware must be sized for
+    std::map<std::string, Usage> pools;
+    std::map<std::string, Usage> queues;
+    for (const auto& t : mTests) {
+        for (const auto& u : t.pools) {
+            auto it = pools.emplace(u.name, u).first;
+            it->second.peakUsed = std::max(it->second.peakUsed, u.peakUsed);
+        }
+        for (const auto& u : t.queues) {
+            auto it = queues.emplace(u.name, u).first;
+            it->second.peakUsed = std::max(it->second.peakUsed, u.peakUsed);
+        }
+    }
+
+    std::vector<Usage> peakPools;
+    std::vector<Usage> peakQueues;
+    for (const auto& p : pools) {
+        peakPools.push_back(p.second);
+    }
+    for (const auto& q : queues) {
+        peakQueues.push_back(q.second);
+    }
+
+    fprintf(out, "{\"qf_usage_report\":{\"tests\":[\n");
+    for (size_t i = 0; i < mTests.size(); ++i) {
+        fprintf(out, "%s{\"test\":\"%s\",", (i == 0) ? "" : ",\n", mTests[i].test.c_str());
+        printUsages(out, "pools", mTests[i].pools);
+        fprintf(out, ",");
+        printUsages(out, "queues", mTests[i].queues);
+        fprintf(out, "}");
+    }
+    fprintf(out, "],\n\"peak\":{");
+    printUsages(out, "pools", peakPools);
+    fprintf(out, ",");
+    printUsages(out, "queues", peakQueues);
+    fprintf(out, "}}}\n");
+}
+
+} // namespace test
+} // namespace cms
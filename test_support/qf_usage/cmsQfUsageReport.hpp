@@ -0,0 +1,101 @@
+/// @brief  Collects the peak usage of the QF event pools and active
+///         object event queues for each test, and writes a machine
+///         readable (JSON) report file when the test executable exits,
+///         apart from the test output. The report is intended for
+///         sizing pools and queues of the firmware from measured data.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#ifndef CMS_QF_USAGE_REPORT_HPP
+#define CMS_QF_USAGE_REPORT_HPP
+
+#include "qpc.h"
+#include <cstddef>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+/// The report file, relative to the working directory of the test
+/// executable. Set by the build, and overridden at run time by the
+/// CMS_QF_USAGE_REPORT environment variable.
+#ifndef CMS_QF_USAGE_REPORT_FILE
+#define CMS_QF_USAGE_REPORT_FILE "qf_usage.json"
+#endif
+
+namespace cms {
+namespace test {
+
+class QfUsageReport
+{
+public:
+    struct Usage
+    {
+        std::string name;
+        size_t blockSize;   // 0 for queues
+        size_t capacity;
+        size_t peakUsed;
+    };
+
+    struct TestUsage
+    {
+        std::string test;
+        std::vector<Usage> pools;
+        std::vector<Usage> queues;
+    };
+
+    /// The report, written (see write()) when the test executable exits.
+    static QfUsageReport& Instance();
+
+    /// Call after qf_ctrl::Setup(), before any event is allocated.
+    /// @param poolBlockSizes the block size of each QF event pool,
+    ///        in the order the pools were initialized.
+    void beginTest(const char* group, const char* test,
+                   const std::vector<size_t>& poolBlockSizes);
+
+    /// Record the peak usage of the event queue of every started
+    /// active object. Call after the test, before any active object
+    /// is stopped.
+    /// @param names the name of an active object, by priority. Others
+    ///        are named "ao<priority>".
+    void recordQueues(const std::map<uint_fast8_t, std::string>& names);
+
+    /// Call before qf_ctrl::Teardown(), records the pools peak usage.
+    void endTest();
+
+    void print(FILE* out) const;
+
+    /// Write the report to its file, CMS_QF_USAGE_REPORT_FILE or as
+    /// set by the environment. Called when the test executable exits.
+    /// @return false if the file could not be written.
+    bool write() const;
+
+    /// The report file.
+    static std::string Path();
+
+private:
+    QfUsageReport() = default;
+    QfUsageReport(const QfUsageReport&) = delete;
+    QfUsageReport& operator=(const QfUsageReport&) = delete;
+
+    static void WriteAtExit();
+
+    std::vector<size_t> mPoolBlockSizes;
+    std::vector<size_t> mPoolCapacities;
+    std::vector<TestUsage> mTests;
+};
+
+} // namespace test
+} // namespace cms
+
+#endif // CMS_QF_USAGE_REPORT_HPP
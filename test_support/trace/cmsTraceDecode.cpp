@@ -0,0 +1,251 @@
+/// @brief  Offline decoder of a trace file written by cms::test::TraceFile.
+///         Prints the timeline of the capture, then a per signal summary:
+///         dispatch durations, publishes (and their latency from the start
+///         of the dispatch publishing them), and timer events (arms,
+///         disarms, and the time from arm to the timeout's dispatch).
+///
+///         usage: cmsTraceDecode <trace file> [--summary]
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#include "cmsTraceFormat.hpp"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace cms::test::trace;
+
+namespace {
+
+struct Capture
+{
+    Header header;
+    std::vector<Record> records; // in time order
+};
+
+bool Load(const char* path, Capture& capture)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in.read(reinterpret_cast<char*>(&capture.header), sizeof(capture.header))) {
+        std::fprintf(stderr, "%s: not a trace file (too short)\n", path);
+        return false;
+    }
+    const Header& h = capture.header;
+    if ((std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0) || (h.version != VERSION) ||
+        (h.recordSize != sizeof(Record)) || (h.capacity == 0) ||
+        ((h.capacity & (h.capacity - 1U)) != 0)) {
+        std::fprintf(stderr, "%s: not a version %u trace file\n", path, VERSION);
+        return false;
+    }
+
+    std::vector<Record> ring(h.capacity);
+    if (!in.read(reinterpret_cast<char*>(ring.data()), ring.size() * sizeof(Record))) {
+        std::fprintf(stderr, "%s: truncated\n", path);
+        return false;
+    }
+
+    // oldest first, then in time order: a dispatch is recorded
+    // when it returns, after what it published.
+    const uint64_t held = std::min<uint64_t>(h.written, h.capacity);
+    for (uint64_t i = h.written - held; i < h.written; ++i) {
+        capture.records.push_back(ring[i & (h.capacity - 1U)]);
+    }
+    std::stable_sort(capture.records.begin(), capture.records.end(),
+                     [](const Record& a, const Record& b) { return a.timestampNs < b.timestampNs; });
+    return true;
+}
+
+std::string SignalName(const Header& h, uint16_t signal)
+{
+    if ((signal < MAX_SIGNAL_NAMES) && (h.signalNames[signal][0] != '\0')) {
+        return std::string(h.signalNames[signal], strnlen(h.signalNames[signal], NAME_LENGTH));
+    }
+    return "SIG_" + std::to_string(signal);
+}
+
+const char* KindName(Kind kind)
+{
+    switch (kind) {
+        case Kind::DISPATCH:     return "DISPATCH";
+        case Kind::PUBLISH:      return "PUBLISH";
+        case Kind::TIMER_ARM:    return "TIMER_ARM";
+        case Kind::TIMER_DISARM: return "TIMER_DISARM";
+        default:                 return "?";
+    }
+}
+
+double Micros(uint64_t ns)
+{
+    return static_cast<double>(ns) / 1000.0;
+}
+
+// durations in ns
+struct Samples
+{
+    std::vector<uint64_t> ns;
+
+    void add(uint64_t sample) { ns.push_back(sample); }
+
+    void print() const
+    {
+        if (ns.empty()) {
+            std::printf(" %9s %9s %9s %9s", "-", "-", "-", "-");
+            return;
+        }
+        std::vector<uint64_t> sorted = ns;
+        std::sort(sorted.begin(), sorted.end());
+        uint64_t sum = 0;
+        for (auto sample : sorted) {
+            sum += sample;
+        }
+        const size_t p99 = std::min(sorted.size() - 1, (sorted.size() * 99) / 100);
+        std::printf(" %9.3f %9.3f %9.3f %9.3f", Micros(sorted.front()),
+                    Micros(sum / sorted.size()), Micros(sorted[p99]), Micros(sorted.back()));
+    }
+};
+
+struct SignalSummary
+{
+    Samples dispatch;        // duration
+    Samples publish;         // from the start of the publishing dispatch
+    Samples timer;           // from the arm to the timeout's dispatch
+    uint64_t arms = 0;
+    uint64_t disarms = 0;
+};
+
+void PrintTimeline(const Capture& capture)
+{
+    std::printf("%12s  %-12s  %-32s\n", "time us", "record", "signal");
+    for (const Record& r : capture.records) {
+        std::printf("%12.3f  %-12s  %-32s", Micros(r.timestampNs), KindName(r.kind),
+                    SignalName(capture.header, r.signal).c_str());
+        switch (r.kind) {
+            case Kind::DISPATCH:
+                std::printf("  prio %u, %.3f us\n", r.object, Micros(r.data));
+                break;
+            case Kind::TIMER_ARM:
+                std::printf("  channel %u, %" PRIu32 " ticks\n", r.object, r.data);
+                break;
+            default:
+                std::printf("  channel %u\n", r.object);
+                break;
+        }
+    }
+    std::printf("\n");
+}
+
+void PrintSummary(const Capture& capture)
+{
+    std::map<uint16_t, SignalSummary> summaries;
+    std::map<uint16_t, uint64_t> armedAt; // timers currently armed, by signal
+
+    const Record* dispatch = nullptr; // the latest dispatch
+    for (const Record& r : capture.records) {
+        SignalSummary& s = summaries[r.signal];
+        switch (r.kind) {
+            case Kind::DISPATCH: {
+                s.dispatch.add(r.data);
+                dispatch = &r;
+                auto armed = armedAt.find(r.signal);
+                if (armed != armedAt.end()) {
+                    s.timer.add(r.timestampNs - armed->second);
+                    armedAt.erase(armed);
+                }
+                break;
+            }
+            case Kind::PUBLISH:
+                if ((dispatch != nullptr) &&
+                    (r.timestampNs <= dispatch->timestampNs + dispatch->data)) {
+                    s.publish.add(r.timestampNs - dispatch->timestampNs);
+                }
+                else {
+                    s.publish.add(0); // published outside of a traced dispatch
+                }
+                break;
+            case Kind::TIMER_ARM:
+                ++s.arms;
+                armedAt[r.signal] = r.timestampNs;
+                break;
+            case Kind::TIMER_DISARM:
+                ++s.disarms;
+                armedAt.erase(r.signal);
+                break;
+            default:
+                break;
+        }
+    }
+
+    std::printf("%-32s %8s %9s %9s %9s %9s\n", "dispatches (us)", "count", "min", "mean", "p99", "max");
+    for (const auto& entry : summaries) {
+        if (!entry.second.dispatch.ns.empty()) {
+            std::printf("%-32s %8zu", SignalName(capture.header, entry.first).c_str(),
+                        entry.second.dispatch.ns.size());
+            entry.second.dispatch.print();
+            std::printf("\n");
+        }
+    }
+
+    std::printf("\n%-32s %8s %9s %9s %9s %9s\n", "publishes (us into dispatch)", "count", "min",
+                "mean", "p99", "max");
+    for (const auto& entry : summaries) {
+        if (!entry.second.publish.ns.empty()) {
+            std::printf("%-32s %8zu", SignalName(capture.header, entry.first).c_str(),
+                        entry.second.publish.ns.size());
+            entry.second.publish.print();
+            std::printf("\n");
+        }
+    }
+
+    std::printf("\n%-32s %8s %8s %8s %9s %9s %9s %9s\n", "timers (us arm to timeout)", "arms",
+                "disarms", "fired", "min", "mean", "p99", "max");
+    for (const auto& entry : summaries) {
+        const SignalSummary& s = entry.second;
+        if ((s.arms != 0) || (s.disarms != 0)) {
+            std::printf("%-32s %8" PRIu64 " %8" PRIu64 " %8zu", SignalName(capture.header, entry.first).c_str(),
+                        s.arms, s.disarms, s.timer.ns.size());
+            s.timer.print();
+            std::printf("\n");
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if ((argc < 2) || (argc > 3) || ((argc == 3) && (std::strcmp(argv[2], "--summary") != 0))) {
+        std::fprintf(stderr, "usage: %s <trace file> [--summary]\n", argv[0]);
+        return 2;
+    }
+
+    Capture capture;
+    if (!Load(argv[1], capture)) {
+        return 1;
+    }
+
+    const Header& h = capture.header;
+    std::printf("capture: %.*s\n", static_cast<int>(strnlen(h.label, LABEL_LENGTH)), h.label);
+    std::printf("records: %zu held, %" PRIu64 " overwritten\n\n", capture.records.size(),
+                h.written - capture.records.size());
+
+    if (argc == 2) {
+        PrintTimeline(capture);
+    }
+    PrintSummary(capture);
+    return 0;
+}
@@ -0,0 +1,169 @@
+/// @brief  See cmsTraceFile.hpp
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#include "cmsTraceFile.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+Q_DEFINE_THIS_MODULE("cmsTraceFile")
+
+namespace cms {
+namespace test {
+
+TraceFile& TraceFile::Instance()
+{
+    static TraceFile trace;
+    return trace;
+}
+
+bool TraceFile::open(const std::string& path, uint32_t capacity)
+{
+    close();
+
+    uint32_t roundedCapacity = 1U;
+    while (roundedCapacity < capacity) {
+        roundedCapacity <<= 1U;
+    }
+    const size_t size = sizeof(trace::Header) + roundedCapacity * sizeof(trace::Record);
+
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    void* mapping = MAP_FAILED;
+    if (::ftruncate(fd, static_cast<off_t>(size)) == 0) {
+        mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    // the mapping keeps the file open
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    mMapping = mapping;
+    mMappingSize = size;
+    mHeader = static_cast<trace::Header*>(mapping);
+    mRecords = reinterpret_cast<trace::Record*>(mHeader + 1);
+
+    std::memcpy(mHeader->magic, trace::MAGIC, sizeof(mHeader->magic));
+    mHeader->version = trace::VERSION;
+    mHeader->recordSize = sizeof(trace::Record);
+    mHeader->capacity = roundedCapacity;
+    begin("");
+    return true;
+}
+
+void TraceFile::close()
+{
+    if (mMapping != nullptr) {
+        ::munmap(mMapping, mMappingSize);
+    }
+    mMapping = nullptr;
+    mMappingSize = 0;
+    mHeader = nullptr;
+    mRecords = nullptr;
+}
+
+void TraceFile::begin(const char* label)
+{
+    Interposer::Reset();
+    mBegin = std::chrono::steady_clock::now();
+    if (mHeader == nullptr) {
+        return;
+    }
+
+    mHeader->written = 0;
+    std::strncpy(mHeader->label, label, sizeof(mHeader->label) - 1);
+    mHeader->label[sizeof(mHeader->label) - 1] = '\0';
+    std::memset(mHeader->signalNames, 0, sizeof(mHeader->signalNames));
+}
+
+void TraceFile::nameSignal(uint16_t signal, const char* name)
+{
+    if ((mHeader == nullptr) || (signal >= trace::MAX_SIGNAL_NAMES) || (name == nullptr)) {
+        return;
+    }
+    char* entry = mHeader->signalNames[signal];
+    std::strncpy(entry, name, trace::NAME_LENGTH - 1);
+    entry[trace::NAME_LENGTH - 1] = '\0';
+}
+
+void TraceFile::traceDispatch(QActive* ao)
+{
+    const bool attached = Interposer::Attach(ao);
+    Q_ASSERT_ID(100, attached);
+    (void)attached;
+}
+
+void TraceFile::TracingDispatch(QAsm* me, QEvt const* e, uint_fast8_t qsId)
+{
+    const DispatchOperation original = Interposer::Original(me);
+    Q_ASSERT_ID(200, original != nullptr);
+
+    TraceFile& self = Instance();
+    const uint64_t start = self.now();
+    original(me, e, qsId);
+    const uint64_t duration = self.now() - start;
+    self.record(start, trace::Kind::DISPATCH, e->sig, reinterpret_cast<QActive const*>(me)->prio,
+                static_cast<uint32_t>(duration));
+}
+
+size_t TraceFile::size() const
+{
+    if (mHeader == nullptr) {
+        return 0;
+    }
+    return (mHeader->written < mHeader->capacity) ?
+           static_cast<size_t>(mHeader->written) : mHeader->capacity;
+}
+
+const trace::Record& TraceFile::at(size_t index) const
+{
+    Q_ASSERT_ID(300, index < size());
+    const uint64_t oldest = mHeader->written - size();
+    return mRecords[(oldest + index) & (mHeader->capacity - 1U)];
+}
+
+bool TraceFile::saveAs(const std::string& path) const
+{
+    if (mMapping == nullptr) {
+        return false;
+    }
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    const auto* bytes = static_cast<const char*>(mMapping);
+    size_t remaining = mMappingSize;
+    while (remaining > 0) {
+        const ssize_t n = ::write(fd, bytes, remaining);
+        if (n <= 0) {
+            break;
+        }
+        bytes += n;
+        remaining -= static_cast<size_t>(n);
+    }
+    ::close(fd);
+    return remaining == 0;
+}
+
+TraceFile::~TraceFile()
+{
+    close();
+}
+
+} // namespace test
+} // namespace cms
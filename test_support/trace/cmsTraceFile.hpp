@@ -0,0 +1,116 @@
+/// @brief  Binary software trace of the active objects under test, into a
+///         memory mapped ring file (see cmsTraceFormat.hpp). Writing a
+///         record is a store into the mapping, no system call, so the
+///         trace may stay enabled in every test. The file always holds
+///         the most recent records of the current test, and is readable
+///         (cmsTraceDecode) even when the test executable crashes.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#ifndef CMS_TRACE_FILE_HPP
+#define CMS_TRACE_FILE_HPP
+
+#include "qpc.h"
+#include "cmsDispatchInterposer.hpp"
+#include "cmsTraceFormat.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace cms {
+namespace test {
+
+class TraceFile
+{
+public:
+    static constexpr uint32_t DEFAULT_CAPACITY = 1U << 16;
+
+    static TraceFile& Instance();
+
+    /// Create (or truncate) and map the trace file.
+    /// @param capacity in records, rounded up to a power of two.
+    /// @return false if the file could not be created or mapped,
+    ///         in which case records are discarded.
+    bool open(const std::string& path, uint32_t capacity = DEFAULT_CAPACITY);
+    void close();
+    bool isOpen() const { return mHeader != nullptr; }
+
+    /// Empty the ring and the signal dictionary, and label the capture
+    /// (e.g. with the test's name). Timestamps restart from zero.
+    void begin(const char* label);
+
+    /// Add a signal to the dictionary, names longer than
+    /// trace::NAME_LENGTH - 1 are truncated.
+    void nameSignal(uint16_t signal, const char* name);
+
+    /// Record the dispatches to an active object, by interposing on its
+    /// dispatch (see DispatchInterposer), for up to 8 active objects.
+    /// Call after the active object's ctor, once per begin().
+    void traceDispatch(QActive* ao);
+
+    /// The hot path. Not thread safe, record from one thread only.
+    void record(trace::Kind kind, uint16_t signal, uint8_t object, uint32_t data)
+    {
+        record(now(), kind, signal, object, data);
+    }
+
+    void record(uint64_t timestampNs, trace::Kind kind, uint16_t signal,
+                uint8_t object, uint32_t data)
+    {
+        if (mHeader == nullptr) {
+            return;
+        }
+        trace::Record& r = mRecords[mHeader->written & (mHeader->capacity - 1U)];
+        r.timestampNs = timestampNs;
+        r.signal = signal;
+        r.kind = kind;
+        r.object = object;
+        r.data = data;
+        ++mHeader->written;
+    }
+
+    uint64_t now() const
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                       std::chrono::steady_clock::now() - mBegin)
+                                       .count());
+    }
+
+    /// The records still held, oldest first.
+    size_t size() const;
+    const trace::Record& at(size_t index) const;
+
+    /// Copy the trace file, e.g. to keep the trace of a failed test.
+    bool saveAs(const std::string& path) const;
+
+    ~TraceFile();
+
+private:
+    TraceFile() = default;
+
+    static void TracingDispatch(QAsm* me, QEvt const* e, uint_fast8_t qsId);
+
+    using Interposer = DispatchInterposer<&TracingDispatch, 8>;
+
+    void* mMapping = nullptr;
+    size_t mMappingSize = 0;
+    trace::Header* mHeader = nullptr;
+    trace::Record* mRecords = nullptr;
+    std::chrono::steady_clock::time_point mBegin = std::chrono::steady_clock::now();
+};
+
+} // namespace test
+} // namespace cms
+
+#endif // CMS_TRACE_FILE_HPP
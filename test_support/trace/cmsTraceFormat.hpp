@@ -0,0 +1,67 @@
+/// @brief  The binary layout of a trace file written by cms::test::TraceFile
+///         and read by the offline decoder (cmsTraceDecode). A header,
+///         including a signal dictionary, followed by a ring of fixed
+///         size records. Host only, native byte order.
+/// @ingroup
+/// @cond
+///***************************************************************************
+///
+///  MIT License
+///
+/// Contact Information:
+///   Matthew Eshleman
+///   https://covemountainsoftware.com
+///   info@covemountainsoftware.com
+///***************************************************************************
+/// @endcond
+
+#ifndef CMS_TRACE_FORMAT_HPP
+#define CMS_TRACE_FORMAT_HPP
+
+#include <cstdint>
+
+namespace cms {
+namespace test {
+namespace trace {
+
+constexpr char MAGIC[8] = {'C', 'M', 'S', 'T', 'R', 'A', 'C', 'E'};
+constexpr uint32_t VERSION = 1;
+constexpr uint32_t MAX_SIGNAL_NAMES = 256; // signals [0 .. MAX_SIGNAL_NAMES-1] may be named
+constexpr uint32_t NAME_LENGTH = 32;       // including the terminator
+constexpr uint32_t LABEL_LENGTH = 128;
+
+enum class Kind : uint8_t {
+    DISPATCH,     // timestamp: start, object: AO priority, data: duration ns
+    PUBLISH,      // object: channel
+    TIMER_ARM,    // object: channel, data: ticks
+    TIMER_DISARM, // object: channel
+    KIND_COUNT
+};
+
+struct Record
+{
+    uint64_t timestampNs; // since TraceFile::begin()
+    uint16_t signal;
+    Kind kind;
+    uint8_t object;
+    uint32_t data;
+};
+static_assert(sizeof(Record) == 16, "trace records must stay 16 bytes");
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t capacity;    // records, a power of two
+    uint32_t reserved;
+    uint64_t written;     // records written since begin(), the ring wraps
+    char label[LABEL_LENGTH];
+    char signalNames[MAX_SIGNAL_NAMES][NAME_LENGTH];
+};
+
+} // namespace trace
+} // namespace test
+} // namespace cms
+
+#endif // CMS_TRACE_FORMAT_HPP